@@ -1,14 +1,62 @@
 #version 330 core
 
+// the planets, the variants (Shader_Feature) pick where the texture comes from:
+// TEXTURE_ARRAY: a layer of a texture array, the layer comes from the vertex shader
+// VIRTUAL_TEXTURE: the physical cache of a virtual texture, through its page table
+
 out vec4 FragColor;
 
-uniform vec3 color;
+in vec2 TexCoord;
+
+#if defined(VIRTUAL_TEXTURE)
+
+#include "virtual_texture.glsl"
+
+uniform sampler2D PhysicalCache;
+uniform sampler2D PageTable;	// rgba8: slot x, slot y, level of the resident tile (or of the finest coarser one)
+
+uniform float tileBorder;
+uniform vec2 cacheSize;	// texels of the physical cache
+
+vec4 getTexel() {
+
+	vec2 uv = getVirtualUV(TexCoord);
+	int level = getVirtualLevel(TexCoord);
+
+	// the entry of the tile under the fragment:
+	vec4 entry = texelFetch(PageTable, getVirtualTile(uv, level), level) * 255.0f;
+
+	// where the fragment is in the tile that is there:
+	vec2 residentSize = getLevelSize(int(entry.b + 0.5f));
+	vec2 texel = min(uv * residentSize, residentSize - 0.5f);
+	vec2 inTile = texel - floor(texel / tileSize) * tileSize;
+
+	vec2 physical = floor(entry.rg + 0.5f) * (tileSize + 2.0f * tileBorder) + tileBorder + inTile;
+
+	return texture(PhysicalCache, physical / cacheSize);
+}
+
+#elif defined(TEXTURE_ARRAY)
+
+uniform sampler2DArray Textures;
+
+flat in float Layer;
+
+vec4 getTexel() {
+	return texture(Textures, vec3(TexCoord, Layer));
+}
+
+#else
 
 uniform sampler2D Texture;
 
-in vec2 TexCoord;
+vec4 getTexel() {
+	return texture(Texture, TexCoord);
+}
+
+#endif
 
 void main() {
 
-	FragColor = texture(Texture, TexCoord);
+	FragColor = getTexel();
 }
\ No newline at end of file
@@ -0,0 +1,18 @@
+#version 330 core
+
+// the feedback pass of the virtual texture: which tile of which level every fragment wants (a = 1, 0 where nothing is drawn)
+// the pass is smaller than the screen, lodBias brings the level back to the screen's
+
+layout(location = 0) out uvec4 Feedback;
+
+in vec2 TexCoord;
+
+#include "virtual_texture.glsl"
+
+void main() {
+
+	vec2 uv = getVirtualUV(TexCoord);
+	int level = getVirtualLevel(TexCoord);
+
+	Feedback = uvec4(uvec2(getVirtualTile(uv, level)), uint(level), 1u);
+}
\ No newline at end of file
@@ -0,0 +1,19 @@
+// the uniform blocks of the planet programs, std140 like FrameUniforms & BodyUniforms in UniformBuffers.h
+
+layout(std140) uniform Frame {
+	mat4 view;
+	mat4 projection;
+	mat4 viewProjection;
+	vec4 sunPosition;	// w: seconds since the start
+};
+
+struct Body {
+	mat4 model;
+	vec4 color;
+	vec4 params;	// x: layer in the texture array
+};
+
+// BODIES_PER_BLOCK bodies, the app binds the block with the body of the draw:
+layout(std140) uniform Bodies {
+	Body bodies[128];
+};
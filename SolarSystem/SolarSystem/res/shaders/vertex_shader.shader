@@ -4,12 +4,30 @@ layout(location = 0) in vec3 aPos;
 layout(location = 1) in vec3 aNormal;
 layout(location = 2) in vec2 aTexCoords;
 
-uniform mat4 mvp;
+#if defined(INSTANCED)
+// per instance, from BodyInstances (a mat4 takes 4 locations):
+layout(location = 4) in mat4 aModel;
+layout(location = 8) in vec4 aParams;	// x: layer in the texture array
+#else
+// the body in the Bodies block, the same for the whole draw (glVertexAttribI1ui):
+layout(location = 3) in uint aBody;
+#endif
+
+#include "uniforms.glsl"
 
 out vec2 TexCoord;
+flat out float Layer;
 
 void main() {
 
-	gl_Position = mvp * vec4(aPos, 1.0f);
+#if defined(INSTANCED)
+	mat4 model = aModel;
+	Layer = aParams.x;
+#else
+	mat4 model = bodies[aBody].model;
+	Layer = bodies[aBody].params.x;
+#endif
+
+	gl_Position = viewProjection * model * vec4(aPos, 1.0f);
 	TexCoord = aTexCoords;
 }
\ No newline at end of file
@@ -0,0 +1,49 @@
+#version 330 core
+
+// VERTEX_FORMAT_COMPACT: normalized 16 bit position & texCoord (u halved, COMPACT_TEXCOORD_U_SCALE), octahedral encoded normal
+
+layout(location = 0) in vec3 aPos;
+layout(location = 1) in vec2 aNormal;
+layout(location = 2) in vec2 aTexCoords;
+
+#if defined(INSTANCED)
+// per instance, from BodyInstances (a mat4 takes 4 locations):
+layout(location = 4) in mat4 aModel;
+layout(location = 8) in vec4 aParams;	// x: layer in the texture array
+#else
+// the body in the Bodies block, the same for the whole draw (glVertexAttribI1ui):
+layout(location = 3) in uint aBody;
+#endif
+
+#include "uniforms.glsl"
+
+out vec2 TexCoord;
+flat out float Layer;
+out vec3 Normal;
+
+vec3 octDecode(vec2 e) {
+
+	vec3 n = vec3(e.xy, 1.0f - abs(e.x) - abs(e.y));
+
+	if (n.z < 0.0f) {
+		vec2 signs = vec2(n.x >= 0.0f ? 1.0f : -1.0f, n.y >= 0.0f ? 1.0f : -1.0f);
+		n.xy = (1.0f - abs(n.yx)) * signs;
+	}
+
+	return normalize(n);
+}
+
+void main() {
+
+#if defined(INSTANCED)
+	mat4 model = aModel;
+	Layer = aParams.x;
+#else
+	mat4 model = bodies[aBody].model;
+	Layer = bodies[aBody].params.x;
+#endif
+
+	gl_Position = viewProjection * model * vec4(aPos, 1.0f);
+	TexCoord = aTexCoords * vec2(2.0f, 1.0f);
+	Normal = octDecode(aNormal);
+}
@@ -0,0 +1,32 @@
+// virtual texturing: which level & tile of the virtual texture a fragment needs,
+// shared by the VIRTUAL_TEXTURE variant of fragment_shader & the feedback pass
+
+uniform vec2 virtualSize;	// texels of level 0
+uniform int levelCount;
+uniform float tileSize;	// without the border
+uniform float lodBias;
+
+vec2 getLevelSize(int level) {
+	return max(floor(virtualSize / exp2(float(level))), vec2(1.0f));
+}
+
+int getVirtualLevel(vec2 uv) {
+
+	vec2 texel = uv * virtualSize;
+	vec2 dx = dFdx(texel);
+	vec2 dy = dFdy(texel);
+
+	float lod = 0.5f * log2(max(dot(dx, dx), dot(dy, dy))) + lodBias;
+
+	return int(clamp(floor(lod), 0.0f, float(levelCount - 1)));
+}
+
+// the texture coordinates wrap around the sphere & are clamped at the poles:
+vec2 getVirtualUV(vec2 texCoord) {
+	return vec2(fract(texCoord.x), clamp(texCoord.y, 0.0f, 1.0f));
+}
+
+ivec2 getVirtualTile(vec2 uv, int level) {
+	vec2 levelSize = getLevelSize(level);
+	return ivec2(min(uv * levelSize, levelSize - 0.5f) / tileSize);
+}
\ No newline at end of file
@@ -6,14 +6,50 @@
 #include <GLFW/glfw3.h>
 
 #include <iostream>
+#include <random>
 
 #include "Sphere.h"
+#include "SphereMeshCache.h"
+#include "PlanetLod.h"
+#include "PlanetTerrain.h"
+#include "TextureLoader.h"
+#include "TextureResidency.h"
+#include "VirtualTexture.h"
+#include "TextureArray.h"
+#include "BodyInstances.h"
 #include "Shader.h"
+#include "ShaderManager.h"
+#include "ShaderVariants.h"
+#include "UniformBuffers.h"
 #include "Camera.h"
+#include "Benchmark.h"
 
 const unsigned int SCR_WIDTH = 800;
 const unsigned int SCR_HEIGHT = 800;
 
+// 16 byte vertices instead of 32, see VertexFormat.h:
+const bool USE_COMPACT_VERTICES = true;
+
+// one strip per stack with primitive restart instead of a triangle list:
+const bool USE_TRIANGLE_STRIPS = true;
+
+// close up the planet is drawn from quadtree patches whose cells cover at most this many pixels:
+const float TERRAIN_CELL_PIXELS = 8.0f;
+
+// VRAM the textures may take, the levels the bodies don't need on screen are dropped beyond it:
+const int TEXTURE_BUDGET_MB = 64;
+
+// the planet textures in the texture arrays are at most this wide (rgb8 with all levels, 2.7 MB a layer):
+const int TEXTURE_ARRAY_MAX_WIDTH = 1024;
+
+// there's no sun body yet, the light comes from far along +z:
+const glm::vec3 SUN_POSITION(0.0f, 0.0f, 100.0f);
+
+// the asteroid belt around the earth, drawn instanced with the planet textures:
+const int ASTEROID_COUNT = 20000;
+const float ASTEROID_BELT_INNER = 3.0f;
+const float ASTEROID_BELT_OUTER = 5.0f;
+
 Camera camera(glm::vec3(0.0f, 0.0f, 3.0f));
 
 float lastX = SCR_WIDTH / 2.0f;
@@ -29,8 +65,6 @@ bool firstMouse = true;
 bool previousState = false;
 bool mouseIsVisible = false;
 
-Sphere* sphere1 = new Sphere(1.0f, 44, 30);
-
 void processInput(GLFWwindow* window);
 
 void framebuffer_size_callback(GLFWwindow* window, int width, int height);
@@ -39,7 +73,19 @@ void mouse_callback(GLFWwindow* window, double xposIn, double yposIn);
 
 void scroll_callback(GLFWwindow* window, double xoffset, double yoffset);
 
-int main(void){
+void createAsteroidBelt(std::vector<BodyInstance>& asteroids, int count, const std::vector<TextureArrayLayer>& layers);
+
+int main(int argc, char** argv){
+
+    // offline benchmarks, no window needed:
+    if (argc > 2 && std::string(argv[1]) == "--bench")
+        return runBenchmark(argv[2]) ? 0 : -1;
+
+    // cooks res/textures into the archive the textures are mapped from, no window needed:
+    if (argc > 1 && std::string(argv[1]) == "--cook-textures") {
+        std::vector<std::string> sources(SHIPPED_TEXTURES, SHIPPED_TEXTURES + SHIPPED_TEXTURE_COUNT);
+        return TextureArchive::build(TEXTURE_ARCHIVE_PATH, sources, TextureCache()) ? 0 : -1;
+    }
 
     GLFWwindow* window;
 
@@ -88,38 +134,37 @@ int main(void){
 
 
 
-    Shader shader("res/shaders/vertex_shader.shader", "res/shaders/fragment_shader.shader");
-
-    unsigned int sphereVAO;
-    glGenVertexArrays(1, &sphereVAO);
+    Vertex_Format vertexFormat = USE_COMPACT_VERTICES ? VERTEX_FORMAT_COMPACT : VERTEX_FORMAT_FLOAT;
 
-    unsigned int sphereVBO;
-    glGenBuffers(1, &sphereVBO);
+    const char* vertexShaderPath = USE_COMPACT_VERTICES ? "res/shaders/vertex_shader_compact.shader" : "res/shaders/vertex_shader.shader";
 
-    glBindBuffer(GL_ARRAY_BUFFER, sphereVBO);
-    glBufferData(GL_ARRAY_BUFFER, sphere1->getInterleavedVertexSize(), sphere1->getInterleavedVertices(), GL_STATIC_DRAW);
+    // edits to the shader files (& the files they include) show up without a restart:
+    ShaderManager shaderManager;
 
-    glBindVertexArray(sphereVAO);
+    // one fragment shader for the planets, each feature combination is compiled the first time it's drawn:
+    ShaderVariants planetShaders(vertexShaderPath, "res/shaders/fragment_shader.shader", &shaderManager);
+    Shader& shader = planetShaders.get(0);
 
-    int stride = sphere1->getInterleavedStride();
+    // the earth as a virtual texture, the feedback pass finds the tiles it needs:
+    Shader feedbackShader(vertexShaderPath, "res/shaders/fragment_shader_feedback.shader");
+    shaderManager.add(feedbackShader);
 
-    // position attribute:
-    glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, stride, (void*)0);
-    glEnableVertexAttribArray(0);
+    shaderManager.start();
 
-    // normal attributes:
-    glVertexAttribPointer(1, 3, GL_FLOAT, GL_FALSE, stride, (void*)(3 * sizeof(float)));
-    glEnableVertexAttribArray(1);
+    // the matrices & the bodies go to the shaders as uniform blocks, once per frame:
+    FrameUniformBuffer frameUniforms;
+    BodyUniformBuffer bodyUniforms;
 
-    // texture coordinates:
-    glVertexAttribPointer(2, 2, GL_FLOAT, GL_FALSE, stride, (void*)(6 * sizeof(float)));
-    glEnableVertexAttribArray(2);
+    // every body with the same resolution shares one unit sphere mesh, the bodies pick their level from the chain:
+    SphereMeshCache meshCache;
+    LodChain planetLod(meshCache, vertexFormat, USE_TRIANGLE_STRIPS ? TOPOLOGY_TRIANGLE_STRIP : TOPOLOGY_TRIANGLES);
 
-    unsigned int sphereEBO; // EBO for the sphere itself
-    glGenBuffers(1, &sphereEBO);
+    unsigned int earth_lod = 0;
+    float earth_projected_radius = 0.0f;
+    float max_pixel_error = 0.5f;
 
-    glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, sphereEBO);
-    glBufferData(GL_ELEMENT_ARRAY_BUFFER, sphere1->getIndexSize(), sphere1->getIndices(), GL_STATIC_DRAW);
+    // 16 bit positions can't go as deep as floats:
+    PlanetTerrain earthTerrain(vertexFormat, 1024, USE_COMPACT_VERTICES ? 8 : 12);
 
 
     bool show_demo_window = true;
@@ -131,8 +176,67 @@ int main(void){
     float y_rot = 1.0f;
     float z_rot = 0.0f;
     float speed = 50.0f;
+    float earth_radius = 1.0f;
+
+    // decoded in the background, the earth is grey until its texture is there:
+    TextureLoader textureLoader;
+    TextureCache textureCache;
+
+    TextureArchive textureArchive;
+
+    // block compressed & with their mipmaps, cooked on the first start,
+    // or mapped from the archive when it was cooked with --cook-textures:
+    if (TextureCache::isSupported()) {
+        textureLoader.setCache(&textureCache);
+
+        if (textureArchive.open(TEXTURE_ARCHIVE_PATH))
+            textureLoader.setArchive(&textureArchive);
+    }
+
+    // only the levels the bodies need stay in VRAM, the loader keeps the rest to upload them again:
+    TextureResidency textureResidency(textureLoader, (std::size_t)TEXTURE_BUDGET_MB * 1024 * 1024);
+    int texture_budget_mb = TEXTURE_BUDGET_MB;
+    textureLoader.setKeepLevels(true);
+
+    unsigned int earth_texture = textureLoader.load("res/textures/earth_daymap.jpg", true);
 
-    unsigned int earth_texture = sphere1->loadTexture("res/textures/earth_daymap.jpg", true);
+    // the bodies' textures in one array per size, switching between them binds nothing:
+    const char* planetTexturePaths[] = {
+        "res/textures/sun.jpg", "res/textures/mercury.jpg", "res/textures/venus_surface.jpg", "res/textures/venus_atmosphere.jpg",
+        "res/textures/earth_daymap.jpg", "res/textures/earth_nightmap.jpg", "res/textures/earth_clouds.jpg", "res/textures/earth.jpg",
+        "res/textures/moon.jpg", "res/textures/mars.jpg", "res/textures/jupiter.jpg", "res/textures/saturn.jpg",
+        "res/textures/uranus.jpg", "res/textures/neptune.jpg"
+    };
+
+    TextureArray planetTextures(TEXTURE_ARRAY_MAX_WIDTH);
+    std::vector<TextureArrayLayer> planetLayers;
+
+    for (const char* path : planetTexturePaths) {
+        TextureArrayLayer layer = planetTextures.add(path);
+
+        if (layer.tier >= 0)
+            planetLayers.push_back(layer);
+    }
+
+    bool use_texture_array = false;
+    int planet_texture = 4; // the earth
+
+    // every asteroid shares the earth's LOD chain, one draw per level & tier:
+    std::vector<BodyInstance> asteroids;
+    createAsteroidBelt(asteroids, ASTEROID_COUNT, planetLayers);
+
+    BodyInstances asteroidBelt(planetLod, planetTextures.getTierCount());
+    bool show_asteroids = false;
+    int asteroid_count = 5000;
+
+    // cut into tiles on the first start (or when the map changed) by a worker, the earth keeps its normal texture until then:
+    VirtualTexture virtualEarth;
+    bool use_virtual_texture = false;
+
+    if (!virtualEarth.open(VIRTUAL_EARTH_PATH, "res/textures/earth_daymap.jpg"))
+        virtualEarth.startBuild(VIRTUAL_EARTH_PATH, "res/textures/earth_daymap.jpg");
+
+    bool textures_reported = false;
 
     while (!glfwWindowShouldClose(window))
     {
@@ -144,6 +248,21 @@ int main(void){
         // input:
         processInput(window);
 
+        // shaders whose files changed, swapped in once they linked:
+        shaderManager.update();
+
+        // textures decoded since the last frame:
+        textureLoader.update();
+        planetTextures.update();
+
+        // the virtual earth once its tiles are built:
+        virtualEarth.updateBuild();
+
+        if (!textures_reported && textureLoader.getPendingCount() == 0) {
+            textureLoader.printInfo();
+            textures_reported = true;
+        }
+
         glClearColor(0.1f, 0.1f, 0.1f, 1.0f);
         glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
 
@@ -155,9 +274,6 @@ int main(void){
 
         shader.use();
 
-        unsigned int color_loc = glGetUniformLocation(shader.ID, "color");
-        glUniform3fv(color_loc, 1, glm::value_ptr(color));
-
         // view /& projection transformations:
         glm::mat4 projection = glm::perspective(glm::radians(camera.Zoom), static_cast<float>(SCR_WIDTH) / static_cast<float>(SCR_HEIGHT), 0.1f, 100.0f);
         glm::mat4 view = camera.GetViewMatrix();
@@ -166,25 +282,116 @@ int main(void){
         glm::mat4 model = glm::mat4(1.0f);
 
         model = glm::rotate(model, (float)glfwGetTime() * glm::radians(speed), glm::vec3(x_rot, y_rot, z_rot));
+        model = glm::scale(model, glm::vec3(earth_radius)); // the mesh is a unit sphere
 
         glm::mat4 mvp = projection * view * model;
 
-        unsigned int mvp_loc = glGetUniformLocation(shader.ID, "mvp");
-        glUniformMatrix4fv(mvp_loc, 1, GL_FALSE, glm::value_ptr(mvp));
+        // level of detail from the size on the screen:
+        earth_projected_radius = LodChain::computeProjectedRadius(glm::vec3(0.0f), earth_radius, camera.Position, camera.Zoom, static_cast<float>(SCR_HEIGHT));
+        earth_lod = planetLod.selectLevel(earth_projected_radius, max_pixel_error, earth_lod);
+
+        const SphereMesh& earthMesh = planetLod.getMesh(earth_lod);
+
+        // the terrain starts loading before the planet fills the screen and takes over when it does:
+        bool earth_near = earth_projected_radius > SCR_HEIGHT / 2.0f;
+
+        if (earth_near) {
+            glm::vec3 local_camera = glm::vec3(glm::inverse(model) * glm::vec4(camera.Position, 1.0f));
+            earthTerrain.update(mvp, local_camera, camera.Zoom, static_cast<float>(SCR_HEIGHT), TERRAIN_CELL_PIXELS);
+        }
+
+        bool draw_terrain = earth_near && earth_projected_radius > SCR_HEIGHT && earthTerrain.isReady();
+
+        const TextureArrayLayer* earth_layer = planetLayers.empty() ? NULL : &planetLayers[std::min(planet_texture, (int)planetLayers.size() - 1)];
+
+        FrameUniforms frame;
+        frame.view = view;
+        frame.projection = projection;
+        frame.viewProjection = projection * view;
+        frame.sunPosition = glm::vec4(SUN_POSITION, currentFrame);
+
+        frameUniforms.update(frame);
+
+        BodyUniforms earthBody;
+        earthBody.model = model;
+        earthBody.color = glm::vec4(color, 1.0f);
+        earthBody.params = glm::vec4(earth_layer ? static_cast<float>(earth_layer->layer) : 0.0f, 0.0f, 0.0f, 0.0f);
+
+        bodyUniforms.reset();
+        unsigned int earth_body = bodyUniforms.add(earthBody);
+        bodyUniforms.upload();
+
+        // the same body for the whole draw (no attribute array on location 3):
+        glVertexAttribI1ui(3, bodyUniforms.bind(earth_body));
+
+        auto drawEarth = [&]() {
+            if (draw_terrain) {
+                earthTerrain.draw();
+            }
+            else {
+                glBindVertexArray(earthMesh.VAO);
+                drawIndices(earthMesh.indices);
+                glBindVertexArray(0);
+            }
+        };
+
+        if (show_sphere && use_virtual_texture && virtualEarth.isOpen()) {
 
-        glBindTexture(GL_TEXTURE_2D, earth_texture);
+            int framebuffer_width, framebuffer_height;
+            glfwGetFramebufferSize(window, &framebuffer_width, &framebuffer_height);
 
-        glBindVertexArray(sphereVAO);
+            // which tiles the earth needs, read back next frame:
+            feedbackShader.use();
+            virtualEarth.bind(feedbackShader, 1, 2, VirtualTexture::getFeedbackLodBias());
 
-        glBindBuffer(GL_ARRAY_BUFFER, sphereVBO);
-        glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, sphereEBO);
+            virtualEarth.beginFeedback(framebuffer_width, framebuffer_height);
+            drawEarth();
+            virtualEarth.endFeedback(framebuffer_width, framebuffer_height);
 
-        if(show_sphere)
-            glDrawElements(GL_TRIANGLES, sphere1->getIndexCount(), GL_UNSIGNED_INT, 0);
+            // the tiles of the last frames' feedback:
+            virtualEarth.update();
 
-        glBindBuffer(GL_ARRAY_BUFFER, 0);
-        glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, 0);
-        glBindVertexArray(0);
+            Shader& virtualShader = planetShaders.get(SHADER_FEATURE_VIRTUAL_TEXTURE);
+
+            virtualShader.use();
+            virtualEarth.bind(virtualShader, 1, 2, 0.0f);
+
+            drawEarth();
+        }
+        else if (show_sphere && use_texture_array && planetTextures.isReady() && earth_layer) {
+
+            // any planet texture from the texture arrays, the layer comes with the body:
+            Shader& arrayShader = planetShaders.get(SHADER_FEATURE_TEXTURE_ARRAY);
+
+            arrayShader.use();
+
+            // one bind per tier, the Textures sampler stays on unit 0:
+            planetTextures.bind(earth_layer->tier, 0);
+
+            drawEarth();
+        }
+        else if (show_sphere) {
+            glBindTexture(GL_TEXTURE_2D, earth_texture);
+            textureResidency.request(earth_texture, TextureResidency::getSphereTexelWidth(earth_projected_radius));
+
+            drawEarth();
+        }
+
+        if (show_asteroids && planetTextures.isReady() && !asteroids.empty()) {
+
+            asteroidBelt.build(asteroids.data(), std::min(asteroid_count, (int)asteroids.size()), currentFrame,
+                camera.Position, camera.Zoom, static_cast<float>(SCR_HEIGHT), max_pixel_error);
+
+            Shader& instancedShader = planetShaders.get(SHADER_FEATURE_INSTANCED | SHADER_FEATURE_TEXTURE_ARRAY);
+
+            instancedShader.use();
+            asteroidBelt.draw(&planetTextures);
+        }
+
+        // levels for this frame's requests, within the budget (what the texture arrays take is gone from it):
+        textureResidency.setBudget((std::size_t)texture_budget_mb * 1024 * 1024);
+        textureResidency.setExternalSize(planetTextures.getMemorySize());
+        textureResidency.update();
 
         if (mouseIsVisible && show_demo_window)
             ImGui::ShowDemoWindow(&show_demo_window);
@@ -202,8 +409,36 @@ int main(void){
             ImGui::SliderFloat("y_rot", &y_rot, -1.0f, 1.0f);           
             ImGui::SliderFloat("z_rot", &z_rot, -1.0f, 1.0f);           
             ImGui::SliderFloat("speed", &speed, 50.0f, 200.0f);           
+            ImGui::SliderFloat("radius", &earth_radius, 0.1f, 2.0f);
             ImGui::ColorEdit3("clear color", (float*)&color); // Edit 3 floats representing a color
 
+            ImGui::SliderFloat("max pixel error", &max_pixel_error, 0.1f, 8.0f);
+
+            ImGui::Text("Sphere meshes: %u (%.1f KB gpu, %.1f KB cpu)", meshCache.getMeshCount(), meshCache.getGpuMemorySize() / 1024.0f, meshCache.getCpuMemorySize() / 1024.0f);
+            ImGui::Text("Earth LOD %u: %u triangles, %.1f px radius", earth_lod, planetLod.getMesh(earth_lod).sphere.getTriangleCount(), earth_projected_radius);
+            ImGui::Text("Terrain: %s, %u patches drawn, %u resident, %u building (%.1f KB)", draw_terrain ? "on" : "off",
+                earthTerrain.getDrawCount(), earthTerrain.getResidentCount(), earthTerrain.getPendingCount(), earthTerrain.getMemorySize() / 1024.0f);
+            ImGui::Text("Textures: %u loading, %.1f KB uploaded this frame", textureLoader.getPendingCount(), textureLoader.getStreamer().getLastFrameBytes() / 1024.0f);
+            ImGui::SliderInt("texture budget (MB)", &texture_budget_mb, 1, 256);
+            ImGui::Text("Texture VRAM: %.1f / %.1f MB (%.1f MB textures, %.1f MB with all levels, %.1f MB arrays), %u levels dropped, %u this frame, %.1f KB uploaded again",
+                (textureResidency.getResidentSize() + textureResidency.getExternalSize()) / 1048576.0f, textureResidency.getBudget() / 1048576.0f,
+                textureResidency.getResidentSize() / 1048576.0f, textureResidency.getFullSize() / 1048576.0f, textureResidency.getExternalSize() / 1048576.0f,
+                textureResidency.getDroppedLevelCount(), textureResidency.getLastFrameDrops(), textureResidency.getLastFrameUploadSize() / 1024.0f);
+            ImGui::Checkbox("texture array", &use_texture_array);
+            ImGui::SliderInt("planet texture", &planet_texture, 0, std::max((int)planetLayers.size() - 1, 0));
+            ImGui::Text("Texture arrays: %d tiers, %u layers loading (%.1f MB), %s", planetTextures.getTierCount(), planetTextures.getPendingCount(),
+                planetTextures.getMemorySize() / 1048576.0f, planetLayers.empty() ? "-" : planetTextures.getPath(planetLayers[std::min(planet_texture, (int)planetLayers.size() - 1)]).c_str());
+            ImGui::Checkbox("asteroids", &show_asteroids);
+            ImGui::SliderInt("asteroid count", &asteroid_count, 0, ASTEROID_COUNT);
+            ImGui::Text("Asteroids: %u instances in %u draws, built in %.2f ms (%.1f KB)", asteroidBelt.getInstanceCount(), asteroidBelt.getDrawCount(),
+                asteroidBelt.getLastBuildMs(), asteroidBelt.getMemorySize() / 1024.0f);
+            ImGui::Checkbox("virtual texture", &use_virtual_texture);
+            ImGui::Text("Virtual texture: %u / %u tiles resident, %u loading, %u requested & %u uploaded this frame (%.1f MB)%s",
+                virtualEarth.getResidentCount(), virtualEarth.getTileCount(), virtualEarth.getPendingCount(),
+                virtualEarth.getLastFrameRequests(), virtualEarth.getLastFrameUploads(), virtualEarth.getMemorySize() / 1048576.0f,
+                virtualEarth.isBuilding() ? ", building the tiles" : "");
+            ImGui::Text("Shaders: %u watched (%u planet variants), %u compiling, %u reloaded, %u failed (%s)", shaderManager.getShaderCount(), planetShaders.getVariantCount(), shaderManager.getPendingCount(),
+                shaderManager.getReloadCount(), shaderManager.getFailedCount(), Shader::isParallelCompileSupported() ? "parallel compile" : "blocking compile");
             ImGui::Text("Application average %.3f ms/frame (%.1f FPS)", 1000.0f / ImGui::GetIO().Framerate, ImGui::GetIO().Framerate);
             ImGui::End();
         }
@@ -217,11 +452,17 @@ int main(void){
         glfwPollEvents();
     }
 
-    glDeleteVertexArrays(1, &sphereVAO);
-    glDeleteBuffers(1, &sphereVBO);
-    glDeleteBuffers(1, &sphereEBO);
-
-    sphere1 = NULL;
+    // the gpu buffers have to go before the context:
+    shaderManager.stop();
+    meshCache.clear();
+    earthTerrain.clear();
+    textureResidency.clear();
+    textureLoader.clear();
+    virtualEarth.close();
+    planetTextures.clear();
+    frameUniforms.clear();
+    bodyUniforms.clear();
+    asteroidBelt.clear();
 
     // Cleanup
     ImGui_ImplOpenGL3_Shutdown();
@@ -315,3 +556,32 @@ void scroll_callback(GLFWwindow* window, double xoffset, double yoffset) {
         camera.ProcessMouseScroll(static_cast<float>(yoffset));
     }
 }
+
+void createAsteroidBelt(std::vector<BodyInstance>& asteroids, int count, const std::vector<TextureArrayLayer>& layers) {
+
+    if (layers.empty())
+        return;
+
+    // the same belt every start:
+    std::mt19937 random(1234);
+    std::uniform_real_distribution<float> unit(0.0f, 1.0f);
+
+    asteroids.resize(count);
+
+    for (BodyInstance& asteroid : asteroids) {
+
+        float distance = ASTEROID_BELT_INNER + (ASTEROID_BELT_OUTER - ASTEROID_BELT_INNER) * unit(random);
+        float angle = glm::two_pi<float>() * unit(random);
+
+        asteroid.position = glm::vec3(distance * cosf(angle), 0.3f * (unit(random) - 0.5f), distance * sinf(angle));
+        asteroid.radius = 0.01f + 0.04f * unit(random) * unit(random);
+
+        asteroid.axis = glm::normalize(glm::vec3(unit(random) - 0.5f, 1.0f, unit(random) - 0.5f));
+        asteroid.spin = 2.0f * (unit(random) - 0.5f);
+
+        // the outer ones are slower, like Kepler said:
+        asteroid.orbit = 0.2f * powf(distance / ASTEROID_BELT_INNER, -1.5f);
+
+        asteroid.texture = layers[random() % layers.size()];
+    }
+}
@@ -0,0 +1,1420 @@
+#include "Benchmark.h"
+#include "Sphere.h"
+#include "ThreadPool.h"
+#include "SphereMeshCache.h"
+#include "PlanetLod.h"
+#include "BodyInstances.h"
+#include "Shader.h"
+#include "ShaderPreprocessor.h"
+#include "UniformBuffers.h"
+#include "TextureLoader.h"
+#include "TextureCache.h"
+#include "TextureArchive.h"
+#include "TextureMipmaps.h"
+#include "stb_image.h"
+
+#include <chrono>
+#include <thread>
+#include <iomanip>
+#include <algorithm>
+#include <random>
+
+#ifdef __linux__
+#include <fcntl.h>
+#include <unistd.h>
+#endif
+
+// resolutions we use for the planets, from far away to close-up views:
+static const int SPHERE_RESOLUTIONS[][2] = {
+	{ 44, 30 },
+	{ 128, 64 },
+	{ 512, 256 },
+	{ 1024, 512 },
+	{ 2048, 1024 },
+};
+
+static const int SPHERE_RESOLUTION_COUNT = sizeof(SPHERE_RESOLUTIONS) / sizeof(SPHERE_RESOLUTIONS[0]);
+
+static double elapsedMs(std::chrono::high_resolution_clock::time_point start) {
+	return std::chrono::duration<double, std::milli>(std::chrono::high_resolution_clock::now() - start).count();
+}
+
+// hidden window for the benchmarks that need an OpenGL context, NULL if it failed:
+static GLFWwindow* createBenchmarkContext() {
+
+	if (!glfwInit())
+		return NULL;
+
+	glfwWindowHint(GLFW_CONTEXT_VERSION_MAJOR, 3);
+	glfwWindowHint(GLFW_CONTEXT_VERSION_MINOR, 3);
+	glfwWindowHint(GLFW_OPENGL_PROFILE, GLFW_OPENGL_COMPAT_PROFILE);
+	glfwWindowHint(GLFW_VISIBLE, GLFW_FALSE);
+
+	GLFWwindow* window = glfwCreateWindow(256, 256, "Benchmark", NULL, NULL);
+
+	if (!window) {
+		std::cout << "FAILED TO CREATE GLFW WINDOW!\n";
+		glfwTerminate();
+		return NULL;
+	}
+
+	glfwMakeContextCurrent(window);
+	glfwSwapInterval(0);
+
+	if (glewInit() != GLEW_OK) {
+		std::cout << "FAILED TO INITIALIZE GLEW\n";
+		glfwDestroyWindow(window);
+		glfwTerminate();
+		return NULL;
+	}
+
+	return window;
+}
+
+static void destroyBenchmarkContext(GLFWwindow* window) {
+	glfwDestroyWindow(window);
+	glfwTerminate();
+}
+
+bool runBenchmark(const std::string& name) {
+
+	if (name == "sphere") {
+		benchmarkSphereBuild();
+		return true;
+	}
+
+	if (name == "sphere-kernel") {
+		benchmarkSphereKernels();
+		return true;
+	}
+
+	if (name == "sphere-parallel") {
+		benchmarkSphereParallel();
+		return true;
+	}
+
+	if (name == "indices") {
+		benchmarkIndexFormats();
+		return true;
+	}
+
+	if (name == "vertex-cache") {
+		benchmarkVertexCache();
+		return true;
+	}
+
+	if (name == "tessellation") {
+		return benchmarkTessellations();
+	}
+
+	if (name == "textures") {
+		benchmarkTextureLoading();
+		return true;
+	}
+
+	if (name == "texture-cache") {
+		benchmarkTextureCache();
+		return true;
+	}
+
+	if (name == "texture-startup") {
+		benchmarkTextureStartup();
+		return true;
+	}
+
+	if (name == "mipmaps") {
+		benchmarkMipmaps();
+		return true;
+	}
+
+	if (name == "texture-formats") {
+		return checkTextureFormats();
+	}
+
+	if (name == "uniforms") {
+		return benchmarkUniforms();
+	}
+
+	if (name == "shader-startup") {
+		benchmarkShaderStartup();
+		return true;
+	}
+
+	if (name == "instancing") {
+		return benchmarkInstancing();
+	}
+
+	std::cout << "UNKNOWN BENCHMARK: " << name << "\n";
+	return false;
+}
+
+void benchmarkSphereBuild() {
+
+	const int REBUILDS = 10;
+
+	std::cout << "===== Sphere build =====\n"
+		<< std::setw(8) << "sectors" << std::setw(8) << "stacks"
+		<< std::setw(14) << "first (ms)" << std::setw(8) << "allocs"
+		<< std::setw(14) << "rebuild (ms)" << std::setw(8) << "allocs" << "\n";
+
+	// one sphere goes up and then down in resolution, like the LOD changes do:
+	Sphere sphere(1.0f, SPHERE_RESOLUTIONS[0][0], SPHERE_RESOLUTIONS[0][1]);
+
+	for (int pass = 0; pass < 2; pass++) {
+		for (int n = 0; n < SPHERE_RESOLUTION_COUNT; n++) {
+
+			int r = pass == 0 ? n : SPHERE_RESOLUTION_COUNT - 1 - n;
+			int sectors = SPHERE_RESOLUTIONS[r][0];
+			int stacks = SPHERE_RESOLUTIONS[r][1];
+
+			auto start = std::chrono::high_resolution_clock::now();
+			sphere.setProperties(1.0f, sectors, stacks);
+			double firstMs = elapsedMs(start);
+			unsigned int firstAllocations = sphere.getBuildAllocations();
+
+			unsigned int rebuildAllocations = 0;
+			start = std::chrono::high_resolution_clock::now();
+			for (int k = 0; k < REBUILDS; k++) {
+				sphere.setProperties(1.0f, sectors, stacks);
+				rebuildAllocations += sphere.getBuildAllocations();
+			}
+			double rebuildMs = elapsedMs(start) / REBUILDS;
+
+			std::cout << std::fixed << std::setprecision(3)
+				<< std::setw(8) << sectors << std::setw(8) << stacks
+				<< std::setw(14) << firstMs << std::setw(8) << firstAllocations
+				<< std::setw(14) << rebuildMs << std::setw(8) << rebuildAllocations << "\n";
+		}
+	}
+}
+
+// the vertex loop as it was before the sector ring & kernels, for reference:
+static void buildVerticesLibm(std::vector<float>& out, float radius, int sectorCount, int stackCount) {
+
+	const float PI = acos(-1);
+
+	float sectorStep = 2 * PI / sectorCount;
+	float stackStep = PI / stackCount;
+	float lengthInv = 1.0f / radius;
+
+	out.resize((std::size_t)(stackCount + 1) * (sectorCount + 1) * 8);
+	float* v = out.data();
+
+	for (int i = 0; i <= stackCount; i++) {
+
+		float phi = PI / 2 - i * stackStep;
+		float xz = radius * cosf(phi);
+		float y = -radius * sinf(phi);
+
+		for (int j = 0; j <= sectorCount; j++, v += 8) {
+
+			float theta = j * sectorStep;
+			float x = -xz * cosf(theta);
+			float z = xz * sinf(theta);
+
+			v[0] = x; v[1] = y; v[2] = z;
+			v[3] = x * lengthInv; v[4] = y * lengthInv; v[5] = z * lengthInv;
+			v[6] = (float)j / sectorCount; v[7] = (float)i / stackCount;
+		}
+	}
+}
+
+void benchmarkSphereKernels() {
+
+	const int REPEATS = 5;
+	const Sphere_Kernel kernels[] = { KERNEL_SCALAR, KERNEL_SSE, KERNEL_AVX };
+	const char* kernelNames[] = { "scalar", "sse", "avx" };
+
+	std::cout << "===== Sphere vertex kernels =====\n"
+		<< "best kernel on this cpu: " << kernelNames[Sphere::getBestKernel() - KERNEL_SCALAR] << "\n"
+		<< std::setw(8) << "sectors" << std::setw(8) << "stacks"
+		<< std::setw(12) << "libm (ms)" << std::setw(12) << "scalar" << std::setw(12) << "sse"
+		<< std::setw(12) << "avx" << std::setw(12) << "identical" << "\n";
+
+	std::vector<float> reference;
+
+	for (int r = 0; r < SPHERE_RESOLUTION_COUNT; r++) {
+
+		int sectors = SPHERE_RESOLUTIONS[r][0];
+		int stacks = SPHERE_RESOLUTIONS[r][1];
+
+		auto start = std::chrono::high_resolution_clock::now();
+		for (int k = 0; k < REPEATS; k++)
+			buildVerticesLibm(reference, 1.0f, sectors, stacks);
+		double libmMs = elapsedMs(start) / REPEATS;
+
+		std::cout << std::fixed << std::setprecision(3)
+			<< std::setw(8) << sectors << std::setw(8) << stacks << std::setw(12) << libmMs;
+
+		// a kernel the cpu can't run falls back to the scalar one, the timing shows that
+		Sphere sphere(1.0f, sectors, stacks);
+		bool identical = true;
+
+		for (Sphere_Kernel kernel : kernels) {
+
+			sphere.setKernel(kernel);
+
+			start = std::chrono::high_resolution_clock::now();
+			for (int k = 0; k < REPEATS; k++)
+				sphere.setProperties(1.0f, sectors, stacks);
+			double kernelMs = elapsedMs(start) / REPEATS;
+
+			identical = identical && std::equal(reference.begin(), reference.end(), sphere.getInterleavedVertices());
+
+			std::cout << std::setw(12) << kernelMs;
+		}
+
+		std::cout << std::setw(12) << (identical ? "yes" : "NO") << "\n";
+	}
+}
+
+void benchmarkSphereParallel() {
+
+	const int SECTORS = 4096;
+	const int STACKS = 2048;
+	const int REPEATS = 3;
+
+	std::cout << "===== Sphere parallel build " << SECTORS << " x " << STACKS << " =====\n"
+		<< "hardware threads: " << ThreadPool::getHardwareThreadCount() << "\n"
+		<< std::setw(8) << "threads" << std::setw(12) << "ms" << std::setw(10) << "speedup" << std::setw(12) << "identical" << "\n";
+
+	Sphere serial(1.0f, SECTORS, STACKS);
+
+	// same size as the reference, so the timings don't include the first allocation:
+	Sphere sphere(1.0f, SECTORS, STACKS);
+	double serialMs = 0.0;
+
+	for (unsigned int threads = 1; threads <= 2 * ThreadPool::getHardwareThreadCount(); threads *= 2) {
+
+		sphere.setThreadCount(threads);
+
+		auto start = std::chrono::high_resolution_clock::now();
+		for (int k = 0; k < REPEATS; k++)
+			sphere.setProperties(1.0f, SECTORS, STACKS);
+		double ms = elapsedMs(start) / REPEATS;
+
+		if (threads == 1)
+			serialMs = ms;
+
+		bool identical = std::equal(serial.getInterleavedVertices(), serial.getInterleavedVertices() + serial.getInterleavedVertexSize() / sizeof(float), sphere.getInterleavedVertices())
+			&& std::equal(serial.getIndices(), serial.getIndices() + serial.getIndexCount(), sphere.getIndices())
+			&& std::equal(serial.getLineIndices(), serial.getLineIndices() + serial.getLineIndexCount(), sphere.getLineIndices());
+
+		std::cout << std::fixed << std::setprecision(3)
+			<< std::setw(8) << threads << std::setw(12) << ms << std::setw(10) << serialMs / ms
+			<< std::setw(12) << (identical ? "yes" : "NO") << "\n";
+	}
+}
+
+void benchmarkIndexFormats() {
+
+	const int DRAWS = 200;
+	const Index_Topology topologies[] = { TOPOLOGY_TRIANGLES, TOPOLOGY_TRIANGLE_STRIP };
+	const char* topologyNames[] = { "list", "strip" };
+
+	GLFWwindow* window = createBenchmarkContext();
+
+	if (!window)
+		return;
+
+	Shader shader("res/shaders/vertex_shader.shader", "res/shaders/fragment_shader.shader");
+	shader.use();
+
+	// the spheres untransformed, one body:
+	FrameUniforms frame;
+	frame.view = frame.projection = frame.viewProjection = glm::mat4(1.0f);
+	frame.sunPosition = glm::vec4(0.0f);
+
+	BodyUniforms body;
+	body.model = glm::mat4(1.0f);
+	body.color = glm::vec4(1.0f);
+	body.params = glm::vec4(0.0f);
+
+	FrameUniformBuffer frameUniforms;
+	BodyUniformBuffer bodyUniforms;
+
+	frameUniforms.update(frame);
+	bodyUniforms.add(body);
+	bodyUniforms.upload();
+	glVertexAttribI1ui(3, bodyUniforms.bind(0));
+
+	SphereMeshCache meshCache;
+
+	std::cout << "===== Sphere index formats =====\n"
+		<< std::setw(8) << "sectors" << std::setw(8) << "stacks" << std::setw(8) << "type"
+		<< std::setw(8) << "bits" << std::setw(12) << "indices" << std::setw(12) << "KB"
+		<< std::setw(12) << "ms/draw" << std::setw(14) << "Mtris/s" << "\n";
+
+	for (int r = 0; r < SPHERE_RESOLUTION_COUNT; r++) {
+
+		int sectors = SPHERE_RESOLUTIONS[r][0];
+		int stacks = SPHERE_RESOLUTIONS[r][1];
+
+		for (int t = 0; t < 2; t++) {
+
+			const SphereMesh& mesh = meshCache.get(sectors, stacks, VERTEX_FORMAT_FLOAT, topologies[t]);
+
+			glBindVertexArray(mesh.VAO);
+
+			// warm up, then time the draws until the gpu is done with them:
+			drawIndices(mesh.indices);
+			glFinish();
+
+			auto start = std::chrono::high_resolution_clock::now();
+			for (int k = 0; k < DRAWS; k++)
+				drawIndices(mesh.indices);
+			glFinish();
+			double drawMs = elapsedMs(start) / DRAWS;
+
+			glBindVertexArray(0);
+
+			double triangles = mesh.sphere.getTriangleCount();
+
+			std::cout << std::fixed << std::setprecision(3)
+				<< std::setw(8) << sectors << std::setw(8) << stacks << std::setw(8) << topologyNames[t]
+				<< std::setw(8) << (mesh.indices.type == GL_UNSIGNED_SHORT ? 16 : 32)
+				<< std::setw(12) << mesh.indices.count << std::setw(12) << mesh.indices.getSize() / 1024.0
+				<< std::setw(12) << drawMs << std::setw(14) << triangles / (drawMs * 1000.0) << "\n";
+		}
+	}
+
+	meshCache.clear();
+	frameUniforms.clear();
+	bodyUniforms.clear();
+	glDeleteProgram(shader.ID);
+
+	destroyBenchmarkContext(window);
+}
+
+void benchmarkVertexCache() {
+
+	for (int r = 0; r < SPHERE_RESOLUTION_COUNT; r++) {
+
+		Sphere sphere(1.0f, SPHERE_RESOLUTIONS[r][0], SPHERE_RESOLUTIONS[r][1]);
+		sphere.printInfo();
+
+		auto start = std::chrono::high_resolution_clock::now();
+		sphere.optimizeVertexCache();
+		double optimizeMs = elapsedMs(start);
+
+		sphere.printInfo();
+		std::cout << "optimized in " << optimizeMs << " ms\n\n";
+	}
+}
+
+// closest point of the triangle abc to p (Ericson, Real-Time Collision Detection 5.1.5):
+static glm::vec3 closestPointOnTriangle(glm::vec3 p, glm::vec3 a, glm::vec3 b, glm::vec3 c) {
+
+	glm::vec3 ab = b - a, ac = c - a, ap = p - a;
+	float d1 = glm::dot(ab, ap), d2 = glm::dot(ac, ap);
+	if (d1 <= 0.0f && d2 <= 0.0f) return a;
+
+	glm::vec3 bp = p - b;
+	float d3 = glm::dot(ab, bp), d4 = glm::dot(ac, bp);
+	if (d3 >= 0.0f && d4 <= d3) return b;
+
+	float vc = d1 * d4 - d3 * d2;
+	if (vc <= 0.0f && d1 >= 0.0f && d3 <= 0.0f) return a + ab * (d1 / (d1 - d3));
+
+	glm::vec3 cp = p - c;
+	float d5 = glm::dot(ab, cp), d6 = glm::dot(ac, cp);
+	if (d6 >= 0.0f && d5 <= d6) return c;
+
+	float vb = d5 * d2 - d1 * d6;
+	if (vb <= 0.0f && d2 >= 0.0f && d6 <= 0.0f) return a + ac * (d2 / (d2 - d6));
+
+	float va = d3 * d6 - d5 * d4;
+	if (va <= 0.0f && (d4 - d3) >= 0.0f && (d5 - d6) >= 0.0f) return b + (c - b) * ((d4 - d3) / ((d4 - d3) + (d5 - d6)));
+
+	float denom = 1.0f / (va + vb + vc);
+	return a + ab * (vb * denom) + ac * (vc * denom);
+}
+
+// the deepest point of the mesh below the sphere surface, relative to the radius:
+static float computeMaxGeometricError(const Sphere& sphere) {
+
+	const float* v = sphere.getInterleavedVertices();
+	const unsigned int* indices = sphere.getIndices();
+	float maxError = 0.0f;
+
+	for (unsigned int i = 0; i < sphere.getIndexCount(); i += 3) {
+
+		glm::vec3 a = glm::make_vec3(v + indices[i] * 8);
+		glm::vec3 b = glm::make_vec3(v + indices[i + 1] * 8);
+		glm::vec3 c = glm::make_vec3(v + indices[i + 2] * 8);
+
+		// degenerate pole triangles of the uv sphere don't count:
+		if (glm::length(glm::cross(b - a, c - a)) == 0.0f)
+			continue;
+
+		float error = 1.0f - glm::length(closestPointOnTriangle(glm::vec3(0.0f), a, b, c)) / sphere.getRadius();
+		maxError = std::max(maxError, error);
+	}
+
+	return maxError;
+}
+
+// resolution of a tessellation for a resolution parameter (stacks / subdivisions):
+static void setTessellationResolution(Sphere& sphere, Sphere_Tessellation tessellation, int resolution) {
+
+	if (tessellation == TESSELLATION_UV) {
+		if (sphere.getTessellation() != TESSELLATION_UV)
+			sphere.setTessellation(TESSELLATION_UV, 0);
+
+		sphere.setProperties(1.0f, 2 * resolution, resolution); // square quads at the equator
+	}
+	else
+		sphere.setTessellation(tessellation, resolution);
+}
+
+bool benchmarkTessellations() {
+
+	const Sphere_Tessellation tessellations[] = { TESSELLATION_UV, TESSELLATION_ICOSPHERE, TESSELLATION_CUBE };
+	const char* tessellationNames[] = { "uv", "icosphere", "cube" };
+	const int maxResolutions[] = { 2048, 8, 1024 };
+	const float targetErrors[] = { 1e-2f, 1e-3f, 1e-4f, 1e-5f };
+
+	std::cout << "===== Sphere tessellations =====\n"
+		<< std::setw(12) << "target" << std::setw(12) << "mode" << std::setw(12) << "resolution"
+		<< std::setw(12) << "triangles" << std::setw(14) << "max error" << std::setw(10) << "vs uv" << "\n";
+
+	Sphere sphere(1.0f, 3, 2);
+
+	for (float target : targetErrors) {
+
+		unsigned int uvTriangles = 0;
+
+		for (int t = 0; t < 3; t++) {
+
+			// the error only goes down with the resolution: double it until the target is reached,
+			// then a binary search for the smallest one reaching it
+			int low = t == 0 ? 2 : (t == 1 ? 0 : 1);
+			int high = low;
+
+			setTessellationResolution(sphere, tessellations[t], high);
+
+			while (computeMaxGeometricError(sphere) > target && high < maxResolutions[t]) {
+				low = high + 1;
+				high = std::min(std::max(2 * high, 1), maxResolutions[t]);
+				setTessellationResolution(sphere, tessellations[t], high);
+			}
+
+			if (computeMaxGeometricError(sphere) > target) {
+				std::cout << std::scientific << std::setprecision(1) << std::setw(12) << target
+					<< std::setw(12) << tessellationNames[t] << "  not reachable\n";
+				continue;
+			}
+
+			while (low < high) {
+
+				int middle = (low + high) / 2;
+				setTessellationResolution(sphere, tessellations[t], middle);
+
+				if (computeMaxGeometricError(sphere) <= target)
+					high = middle;
+				else
+					low = middle + 1;
+			}
+
+			setTessellationResolution(sphere, tessellations[t], high);
+			unsigned int triangles = sphere.getTriangleCount();
+
+			if (t == 0)
+				uvTriangles = triangles;
+
+			std::cout << std::scientific << std::setprecision(1) << std::setw(12) << target
+				<< std::setw(12) << tessellationNames[t] << std::setw(12) << high
+				<< std::setw(12) << triangles << std::setprecision(3) << std::setw(14) << computeMaxGeometricError(sphere)
+				<< std::fixed << std::setprecision(2) << std::setw(10) << (uvTriangles ? (double)triangles / uvTriangles : 0.0) << "\n";
+		}
+	}
+
+	// the texCoords after packing, within a step of the 16 bit u:
+	const int resolutions[] = { 64, 3, 16 };
+	const float maxTexCoordError = 1.0f / (65535.0f * COMPACT_TEXCOORD_U_SCALE);
+
+	std::cout << "\n" << std::setw(12) << "mode" << std::setw(12) << "resolution" << std::setw(12) << "max u"
+		<< std::setw(14) << "max error" << std::setw(8) << "same" << "\n";
+
+	int failures = 0;
+
+	for (int t = 0; t < 3; t++) {
+
+		setTessellationResolution(sphere, tessellations[t], resolutions[t]);
+
+		std::vector<CompactVertex> compact(sphere.getVertexCount());
+		packCompactVertices(sphere.getInterleavedVertices(), compact.size(), 1.0f, compact.data());
+
+		const float* interleaved = sphere.getInterleavedVertices();
+		float maxU = 0.0f, maxError = 0.0f;
+
+		for (std::size_t i = 0; i < compact.size(); i++, interleaved += 8) {
+
+			float u = compact[i].texCoord[0] / (65535.0f * COMPACT_TEXCOORD_U_SCALE);
+			float v = compact[i].texCoord[1] / 65535.0f;
+
+			maxU = std::max(maxU, interleaved[6]);
+			maxError = std::max(maxError, std::max(std::fabs(u - interleaved[6]), std::fabs(v - interleaved[7])));
+		}
+
+		bool same = maxError <= maxTexCoordError;
+
+		if (!same)
+			failures++;
+
+		std::cout << std::setw(12) << tessellationNames[t] << std::setw(12) << resolutions[t] << std::fixed << std::setprecision(3)
+			<< std::setw(12) << maxU << std::scientific << std::setprecision(1) << std::setw(14) << maxError
+			<< std::setw(8) << (same ? "yes" : "NO") << "\n";
+	}
+
+	std::cout << (failures ? std::to_string(failures) + " TESSELLATIONS FAILED" : std::string("all texCoords ok")) << "\n" << std::endl;
+
+	return failures == 0;
+}
+
+// loads all textures with the loader like the render loop does, one update() per frame:
+static void loadTexturesPerFrame(std::size_t uploadBudget, const TextureCache* cache = NULL) {
+
+	TextureLoader loader(uploadBudget);
+	loader.setCache(cache);
+
+	auto start = std::chrono::high_resolution_clock::now();
+	for (int t = 0; t < SHIPPED_TEXTURE_COUNT; t++)
+		loader.load(SHIPPED_TEXTURES[t], true);
+	double requestMs = elapsedMs(start);
+
+	int frames = 0;
+	double worstFrameMs = 0.0;
+
+	while (loader.getPendingCount() > 0) {
+
+		auto frameStart = std::chrono::high_resolution_clock::now();
+		loader.update();
+		worstFrameMs = std::max(worstFrameMs, elapsedMs(frameStart));
+
+		frames++;
+
+		// the rest of a frame at 60 fps:
+		std::this_thread::sleep_for(std::chrono::milliseconds(16));
+	}
+
+	glFinish();
+	double totalMs = elapsedMs(start);
+
+	loader.printInfo();
+
+	std::cout << std::fixed << std::setprecision(1)
+		<< "        upload budget: " << (uploadBudget == 0 ? std::string("none, whole images") : std::to_string(uploadBudget / 1024) + " KB per frame")
+		<< (uploadBudget > 0 && loader.getStreamer().isPersistent() ? " (persistently mapped)" : "")
+		<< (cache ? ", compressed from " + cache->getDirectory() : std::string()) << "\n"
+		<< "   first frame (load): " << requestMs << " ms\n"
+		<< "   worst frame (update): " << worstFrameMs << " ms\n"
+		<< "               frames: " << frames << "\n"
+		<< "                total: " << totalMs << " ms\n\n";
+
+	loader.clear();
+}
+
+void benchmarkTextureLoading() {
+
+	GLFWwindow* window = createBenchmarkContext();
+
+	if (!window)
+		return;
+
+	// everything on the render thread, one texture after the other:
+	std::vector<unsigned int> syncTextures;
+
+	auto start = std::chrono::high_resolution_clock::now();
+	for (int t = 0; t < SHIPPED_TEXTURE_COUNT; t++)
+		syncTextures.push_back(Sphere::loadTexture(SHIPPED_TEXTURES[t], true));
+	glFinish();
+	double syncMs = elapsedMs(start);
+
+	glDeleteTextures((GLsizei)syncTextures.size(), syncTextures.data());
+
+	std::cout << "===== Texture loading (" << SHIPPED_TEXTURE_COUNT << " textures, " << ThreadPool::getShared().getThreadCount() << " workers) =====\n"
+		<< std::fixed << std::setprecision(1)
+		<< "  synchronous: " << syncMs << " ms\n\n";
+
+	// decoded on the workers, the render thread only uploads:
+	loadTexturesPerFrame(0);
+	loadTexturesPerFrame(4 * 1024 * 1024);
+	loadTexturesPerFrame(1024 * 1024);
+
+	destroyBenchmarkContext(window);
+}
+
+void benchmarkTextureCache() {
+
+	TextureCache cache;
+
+	// cooking needs no gpu, this part runs on headless machines too:
+	std::cout << "===== Texture cache (" << cache.getDirectory() << ") =====\n"
+		<< std::left << std::setw(40) << "source" << std::right << std::setw(8) << "format" << std::setw(10) << "file KB"
+		<< std::setw(10) << "raw KB" << std::setw(10) << "BC KB" << std::setw(10) << "ms" << std::setw(10) << "PSNR" << "\n";
+
+	std::size_t rawTotal = 0, compressedTotal = 0;
+
+	for (int t = 0; t < SHIPPED_TEXTURE_COUNT; t++) {
+
+		CompressedTexture texture;
+		bool cooked;
+
+		auto start = std::chrono::high_resolution_clock::now();
+		bool loaded = cache.load(SHIPPED_TEXTURES[t], texture, &cooked);
+		double ms = elapsedMs(start);
+
+		TextureImage image;
+
+		if (!loaded || !decodeTextureImage(SHIPPED_TEXTURES[t], image)) {
+			std::cout << std::left << std::setw(40) << SHIPPED_TEXTURES[t] << std::right << "  FAILED\n";
+			continue;
+		}
+
+		// quality of level 0 against the source:
+		std::vector<unsigned char> rgba;
+		decompressImage(texture.data.data(), texture.width, texture.height, texture.format, rgba);
+
+		double squaredError = 0.0;
+		std::size_t pixelCount = (std::size_t)image.width * image.height;
+
+		for (std::size_t p = 0; p < pixelCount; p++) {
+			for (int k = 0; k < image.channels; k++) {
+				int channel = image.channels < 3 ? (k == 0 ? 0 : 3) : k;
+				double difference = (double)image.pixels[p * image.channels + k] - rgba[4 * p + channel];
+				squaredError += difference * difference;
+			}
+		}
+
+		double psnr = 10.0 * log10(255.0 * 255.0 / std::max(squaredError / (pixelCount * image.channels), 1e-10));
+
+		std::size_t fileSize = 0;
+		std::ifstream source(SHIPPED_TEXTURES[t], std::ios::binary | std::ios::ate);
+		if (source)
+			fileSize = (std::size_t)source.tellg();
+
+		// what the uncompressed texture with mipmaps takes:
+		std::size_t rawSize = getTextureMemorySize(image.width, image.height, image.channels);
+
+		rawTotal += rawSize;
+		compressedTotal += texture.data.size();
+
+		std::cout << std::left << std::setw(40) << SHIPPED_TEXTURES[t] << std::right
+			<< std::setw(8) << (texture.format == COMPRESSED_BC1 ? "bc1" : "bc3") << std::setw(10) << fileSize / 1024
+			<< std::setw(10) << rawSize / 1024 << std::setw(10) << texture.data.size() / 1024
+			<< std::setw(10) << std::fixed << std::setprecision(1) << ms << (cooked ? " (cooked)" : "         ")
+			<< std::setw(10) << std::setprecision(2) << psnr << "\n";
+
+		freeTextureImage(image);
+	}
+
+	std::cout << std::left << std::setw(58) << "total" << std::right << std::setw(10) << rawTotal / 1024
+		<< std::setw(10) << compressedTotal / 1024 << "\n\n";
+
+	GLFWwindow* window = createBenchmarkContext();
+
+	if (!window)
+		return;
+
+	if (!TextureCache::isSupported()) {
+		std::cout << "NO S3TC SUPPORT, SKIPPING THE UPLOADS\n";
+		destroyBenchmarkContext(window);
+		return;
+	}
+
+	// startup with the cooked files against decoding the sources:
+	loadTexturesPerFrame(4 * 1024 * 1024);
+	loadTexturesPerFrame(4 * 1024 * 1024, &cache);
+
+	destroyBenchmarkContext(window);
+}
+
+// drops the file from the os page cache so the next read comes from the disk, false where that isn't possible:
+static bool evictFromPageCache(const std::string& path) {
+
+#ifdef __linux__
+	int descriptor = ::open(path.c_str(), O_RDONLY);
+
+	if (descriptor < 0)
+		return false;
+
+	// dirty pages stay in the cache, the file may just have been written:
+	fdatasync(descriptor);
+	bool evicted = posix_fadvise(descriptor, 0, 0, POSIX_FADV_DONTNEED) == 0;
+
+	::close(descriptor);
+
+	return evicted;
+#else
+	return false;
+#endif
+}
+
+// the pages touched without a window end up here, so the loop isn't optimized away:
+static volatile unsigned int pageTouchSink;
+
+void benchmarkTextureStartup() {
+
+	TextureCache cache;
+	TextureArchive archive;
+
+	std::vector<std::string> sources(SHIPPED_TEXTURES, SHIPPED_TEXTURES + SHIPPED_TEXTURE_COUNT);
+
+	// the archive the application maps, built the first time:
+	bool complete = archive.open(TEXTURE_ARCHIVE_PATH);
+
+	for (int t = 0; t < SHIPPED_TEXTURE_COUNT && complete; t++)
+		complete = archive.find(SHIPPED_TEXTURES[t]) != NULL;
+
+	if (!complete) {
+
+		archive.close();
+
+		auto start = std::chrono::high_resolution_clock::now();
+
+		if (!TextureArchive::build(TEXTURE_ARCHIVE_PATH, sources, cache) || !archive.open(TEXTURE_ARCHIVE_PATH))
+			return;
+
+		std::cout << "built " << TEXTURE_ARCHIVE_PATH << " in " << std::fixed << std::setprecision(1) << elapsedMs(start) << " ms\n";
+	}
+
+	GLFWwindow* window = createBenchmarkContext();
+
+	std::cout << "===== Texture startup (" << SHIPPED_TEXTURE_COUNT << " textures" << (window ? "" : ", no window: cpu side only") << ") =====\n";
+
+	// stb_image decode, what Sphere::loadTexture does:
+	auto start = std::chrono::high_resolution_clock::now();
+
+	for (int t = 0; t < SHIPPED_TEXTURE_COUNT; t++) {
+		if (window) {
+			unsigned int texture = Sphere::loadTexture(SHIPPED_TEXTURES[t], true);
+			glDeleteTextures(1, &texture);
+		}
+		else {
+			TextureImage image;
+			decodeTextureImage(SHIPPED_TEXTURES[t], image);
+			freeTextureImage(image);
+		}
+	}
+
+	if (window)
+		glFinish();
+
+	std::cout << std::fixed << std::setprecision(1) << "      stb_image decode: " << elapsedMs(start) << " ms\n";
+
+	// the cooked DDS files, read into the heap:
+	start = std::chrono::high_resolution_clock::now();
+
+	for (int t = 0; t < SHIPPED_TEXTURE_COUNT; t++) {
+
+		CompressedTexture texture;
+		cache.load(SHIPPED_TEXTURES[t], texture);
+
+		if (window) {
+			unsigned int id = createTexture(true);
+			uploadCompressedTexture(id, texture);
+			glDeleteTextures(1, &id);
+		}
+	}
+
+	if (window)
+		glFinish();
+
+	std::cout << "      cooked DDS, read: " << elapsedMs(start) << " ms\n";
+
+	// the mapped archive with all levels, then only the levels at most 1024 wide: only the pages of the uploaded levels
+	// are read, from the disk if the file could be dropped from the page cache first
+	const int maxWidths[] = { 0, 1024 };
+
+	for (int maxWidth : maxWidths) {
+
+		archive.close();
+
+		bool cold = evictFromPageCache(TEXTURE_ARCHIVE_PATH);
+
+		start = std::chrono::high_resolution_clock::now();
+
+		archive.open(TEXTURE_ARCHIVE_PATH);
+
+		unsigned int checksum = 0;
+		std::size_t readSize = 0;
+
+		for (int t = 0; t < SHIPPED_TEXTURE_COUNT; t++) {
+
+			const TextureArchiveEntry* entry = archive.find(SHIPPED_TEXTURES[t]);
+
+			if (!entry)
+				continue;
+
+			int firstLevel = 0;
+
+			while (maxWidth > 0 && (int)(entry->width >> firstLevel) > maxWidth && firstLevel + 1 < (int)entry->levelCount)
+				firstLevel++;
+
+			for (uint32_t level = firstLevel; level < entry->levelCount; level++)
+				readSize += entry->levelSizes[level];
+
+			if (window) {
+				unsigned int id = createTexture(true);
+				uploadArchiveTexture(id, archive, *entry, firstLevel);
+				glDeleteTextures(1, &id);
+			}
+			else {
+				// what the driver would read, a byte per page:
+				for (uint32_t level = firstLevel; level < entry->levelCount; level++)
+					for (std::size_t b = 0; b < entry->levelSizes[level]; b += 4096)
+						checksum += archive.getLevelData(*entry, level)[b];
+			}
+		}
+
+		if (window)
+			glFinish();
+
+		pageTouchSink = checksum;
+
+		std::cout << "  mapped archive, " << (maxWidth ? "<= " + std::to_string(maxWidth) + " wide" : std::string("all levels"))
+			<< (cold ? " (not cached)" : " (page cache not dropped)") << ": " << elapsedMs(start) << " ms, "
+			<< readSize / 1048576.0 << " MB of levels\n";
+	}
+
+	archive.close();
+
+	if (window)
+		destroyBenchmarkContext(window);
+}
+
+// bytes of the texture as the driver reports it, from the bits per texel of each level:
+static std::size_t getUploadedTextureSize(unsigned int texture) {
+
+	glBindTexture(GL_TEXTURE_2D, texture);
+
+	GLint width, height;
+	glGetTexLevelParameteriv(GL_TEXTURE_2D, 0, GL_TEXTURE_WIDTH, &width);
+	glGetTexLevelParameteriv(GL_TEXTURE_2D, 0, GL_TEXTURE_HEIGHT, &height);
+
+	std::size_t size = 0;
+
+	for (int level = 0; level < getMipLevelCount(width, height); level++) {
+
+		const GLenum SIZES[4] = { GL_TEXTURE_RED_SIZE, GL_TEXTURE_GREEN_SIZE, GL_TEXTURE_BLUE_SIZE, GL_TEXTURE_ALPHA_SIZE };
+		GLint levelWidth, levelHeight, bits = 0;
+
+		glGetTexLevelParameteriv(GL_TEXTURE_2D, level, GL_TEXTURE_WIDTH, &levelWidth);
+		glGetTexLevelParameteriv(GL_TEXTURE_2D, level, GL_TEXTURE_HEIGHT, &levelHeight);
+
+		for (int k = 0; k < 4; k++) {
+			GLint channelBits;
+			glGetTexLevelParameteriv(GL_TEXTURE_2D, level, SIZES[k], &channelBits);
+			bits += channelBits;
+		}
+
+		size += (std::size_t)levelWidth * levelHeight * bits / 8;
+	}
+
+	return size;
+}
+
+bool checkTextureFormats() {
+
+	GLFWwindow* window = createBenchmarkContext();
+
+	std::cout << "===== Texture formats" << (window ? "" : " (no window: cpu side only)") << " =====\n"
+		<< std::left << std::setw(40) << "path" << std::right
+		<< std::setw(6) << "file" << std::setw(8) << "packed" << std::setw(10) << "expected" << std::setw(10) << "uploaded"
+		<< std::setw(10) << "KB" << std::setw(12) << "uploaded KB" << std::setw(8) << "wrap" << "\n";
+
+	int failures = 0;
+	std::size_t total = 0, rgbTotal = 0;
+
+	for (int t = 0; t < SHIPPED_TEXTURE_COUNT; t++) {
+
+		const char* path = SHIPPED_TEXTURES[t];
+
+		int width, height, fileChannels;
+		TextureImage image;
+
+		if (!stbi_info(path, &width, &height, &fileChannels) || !decodeTextureImage(path, image)) {
+			std::cout << std::left << std::setw(40) << path << std::right << "  FAILED TO DECODE\n";
+			failures++;
+			continue;
+		}
+
+		GLenum expected = getTextureInternalFormat(image);
+		std::size_t expectedSize = getTextureMemorySize(image.width, image.height, image.channels);
+
+		total += expectedSize;
+		rgbTotal += getTextureMemorySize(image.width, image.height, 3);
+
+		bool ok = image.channels <= fileChannels;
+
+		std::cout << std::left << std::setw(40) << path << std::right
+			<< std::setw(6) << fileChannels << std::setw(8) << image.channels << std::setw(10) << getTextureFormatName(expected);
+
+		// the ring is the only texture that doesn't go around a sphere:
+		bool wrap = std::string(path).find("ring") == std::string::npos;
+
+		if (window) {
+
+			unsigned int texture = createTexture(wrap);
+			uploadTextureImage(texture, image);
+
+			GLint internalFormat, wrapS;
+			glGetTexLevelParameteriv(GL_TEXTURE_2D, 0, GL_TEXTURE_INTERNAL_FORMAT, &internalFormat);
+			glGetTexParameteriv(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, &wrapS);
+
+			std::size_t uploadedSize = getUploadedTextureSize(texture);
+
+			ok = ok && (GLenum)internalFormat == expected && uploadedSize == expectedSize && wrapS == (wrap ? GL_REPEAT : GL_CLAMP_TO_EDGE);
+
+			std::cout << std::setw(10) << getTextureFormatName(internalFormat) << std::setw(10) << expectedSize / 1024
+				<< std::setw(12) << uploadedSize / 1024 << std::setw(8) << (wrapS == GL_REPEAT ? "repeat" : "clamp");
+
+			// the same image as sRGB:
+			if (image.channels >= 3) {
+
+				image.srgb = true;
+				uploadTextureImage(texture, image);
+
+				glGetTexLevelParameteriv(GL_TEXTURE_2D, 0, GL_TEXTURE_INTERNAL_FORMAT, &internalFormat);
+				ok = ok && (GLenum)internalFormat == getTextureInternalFormat(image);
+			}
+
+			glDeleteTextures(1, &texture);
+		}
+		else {
+			std::cout << std::setw(10) << "-" << std::setw(10) << expectedSize / 1024 << std::setw(12) << "-" << std::setw(8) << (wrap ? "repeat" : "clamp");
+		}
+
+		std::cout << (ok ? "" : "  MISMATCH") << "\n";
+
+		if (!ok)
+			failures++;
+
+		freeTextureImage(image);
+	}
+
+	std::cout << std::left << std::setw(64) << "total (as rgb8)" << std::right << std::setw(10) << total / 1024
+		<< " (" << rgbTotal / 1024 << ")\n"
+		<< (failures ? std::to_string(failures) + " TEXTURES FAILED" : std::string("all textures ok")) << "\n" << std::endl;
+
+	if (window)
+		destroyBenchmarkContext(window);
+
+	return failures == 0;
+}
+
+void benchmarkMipmaps() {
+
+	const int REPEATS = 3;
+	const Mip_Kernel kernels[] = { MIP_KERNEL_SCALAR, MIP_KERNEL_SSE, MIP_KERNEL_AVX2 };
+	const char* kernelNames[] = { "scalar", "sse", "avx2" };
+	const Mip_Filter filters[] = { MIP_FILTER_BOX, MIP_FILTER_KAISER };
+	const char* filterNames[] = { "box", "kaiser" };
+
+	std::cout << "===== Mipmaps (ms per texture, all levels) =====\n"
+		<< "best kernel on this cpu: " << kernelNames[getBestMipKernel() - MIP_KERNEL_SCALAR] << "\n"
+		<< std::left << std::setw(40) << "path" << std::right << std::setw(12) << "size";
+
+	for (const char* filter : filterNames)
+		for (const char* kernel : kernelNames)
+			std::cout << std::setw(9) << (std::string(filter).substr(0, 1) + "/" + kernel);
+
+	std::cout << std::setw(12) << "identical" << "\n";
+
+	std::vector<TextureImage> images(SHIPPED_TEXTURE_COUNT);
+	double totals[2][3] = {};
+
+	for (int t = 0; t < SHIPPED_TEXTURE_COUNT; t++) {
+
+		TextureImage& image = images[t];
+
+		if (!decodeTextureImage(SHIPPED_TEXTURES[t], image)) {
+			std::cout << std::left << std::setw(40) << SHIPPED_TEXTURES[t] << std::right << "  FAILED\n";
+			continue;
+		}
+
+		std::cout << std::left << std::setw(40) << SHIPPED_TEXTURES[t] << std::right
+			<< std::setw(12) << std::to_string(image.width) + "x" + std::to_string(image.height) + "x" + std::to_string(image.channels);
+
+		bool identical = true;
+
+		for (int f = 0; f < 2; f++) {
+
+			std::vector<unsigned char> reference;
+
+			// a kernel the cpu can't run falls back to a narrower one, the timing shows that
+			for (int k = 0; k < 3; k++) {
+
+				auto start = std::chrono::high_resolution_clock::now();
+				for (int r = 0; r < REPEATS; r++)
+					generateTextureMipmaps(image, filters[f], true, kernels[k]);
+				double ms = elapsedMs(start) / REPEATS;
+
+				if (k == 0)
+					reference = image.mipmaps;
+				else
+					identical = identical && reference == image.mipmaps;
+
+				totals[f][k] += ms;
+
+				std::cout << std::setw(9) << std::fixed << std::setprecision(2) << ms;
+			}
+		}
+
+		std::cout << std::setw(12) << (identical ? "yes" : "NO") << "\n";
+	}
+
+	std::cout << std::left << std::setw(52) << "total" << std::right;
+
+	for (int f = 0; f < 2; f++)
+		for (int k = 0; k < 3; k++)
+			std::cout << std::setw(9) << totals[f][k];
+
+	std::cout << "\n";
+
+	// what the loader does, every texture on its own worker:
+	auto start = std::chrono::high_resolution_clock::now();
+
+	ThreadPool::getShared().parallelFor(SHIPPED_TEXTURE_COUNT, SHIPPED_TEXTURE_COUNT, [&images](int begin, int end) {
+		for (int t = begin; t < end; t++)
+			if (images[t].pixels)
+				generateTextureMipmaps(images[t], MIP_FILTER_KAISER, true);
+	});
+
+	std::cout << "kaiser, all textures on the " << ThreadPool::getShared().getThreadCount() << " workers: "
+		<< elapsedMs(start) << " ms\n";
+
+	// the render thread: glTexImage2D & glGenerateMipmap against uploading the levels from the workers
+	GLFWwindow* window = createBenchmarkContext();
+
+	if (window) {
+
+		double driverMs = 0.0, uploadMs = 0.0;
+
+		for (TextureImage& image : images) {
+
+			if (!image.pixels)
+				continue;
+
+			std::vector<unsigned char> mipmaps;
+			mipmaps.swap(image.mipmaps);
+
+			for (int pass = 0; pass < 2; pass++) {
+
+				unsigned int texture = createTexture(true);
+
+				start = std::chrono::high_resolution_clock::now();
+				uploadTextureImage(texture, image);
+				glFinish();
+				(pass == 0 ? driverMs : uploadMs) += elapsedMs(start);
+
+				glDeleteTextures(1, &texture);
+
+				mipmaps.swap(image.mipmaps);
+			}
+		}
+
+		std::cout << "render thread, glGenerateMipmap: " << driverMs << " ms, uploading the cpu levels: " << uploadMs << " ms\n";
+
+		destroyBenchmarkContext(window);
+	}
+
+	std::cout << std::endl;
+
+	for (TextureImage& image : images)
+		freeTextureImage(image);
+}
+
+bool benchmarkUniforms() {
+
+	const int LOOKUPS = 100000;
+	const char* fragmentPaths[] = {
+		"res/shaders/fragment_shader.shader", "res/shaders/fragment_shader.shader",
+		"res/shaders/fragment_shader.shader", "res/shaders/fragment_shader_feedback.shader"
+	};
+	const unsigned int features[] = { 0, SHADER_FEATURE_TEXTURE_ARRAY, SHADER_FEATURE_VIRTUAL_TEXTURE, 0 };
+	const char* names[] = { "viewProjection", "Texture", "Textures", "PageTable", "lodBias", "missing" };
+
+	GLFWwindow* window = createBenchmarkContext();
+
+	if (!window)
+		return false;
+
+	std::cout << "===== Uniform locations (" << LOOKUPS << " lookups of Texture & Textures) =====\n"
+		<< std::left << std::setw(48) << "fragment shader" << std::right << std::setw(10) << "features" << std::setw(10) << "uniforms"
+		<< std::setw(16) << "glGet (ns)" << std::setw(14) << "cache (ns)" << std::setw(12) << "same" << "\n";
+
+	int failures = 0;
+
+	for (int f = 0; f < 4; f++) {
+
+		const char* fragmentPath = fragmentPaths[f];
+
+		Shader shader("res/shaders/vertex_shader_compact.shader", fragmentPath, features[f]);
+
+		// the cache has to agree with the driver, unknown names included:
+		bool same = true;
+
+		for (const char* name : names)
+			same = same && shader.getUniformLocation(name) == glGetUniformLocation(shader.ID, name);
+
+		// what the render loop did before, a std::string per call:
+		int sum = 0;
+
+		auto start = std::chrono::high_resolution_clock::now();
+		for (int i = 0; i < LOOKUPS; i++) {
+			sum += glGetUniformLocation(shader.ID, std::string("Texture").c_str());
+			sum += glGetUniformLocation(shader.ID, std::string("Textures").c_str());
+		}
+		double driverNs = elapsedMs(start) * 1e6 / (2.0 * LOOKUPS);
+
+		start = std::chrono::high_resolution_clock::now();
+		for (int i = 0; i < LOOKUPS; i++) {
+			sum -= shader.getUniformLocation(UNIFORM_TEXTURE);
+			sum -= shader.getUniformLocation(UNIFORM_TEXTURES);
+		}
+		double cacheNs = elapsedMs(start) * 1e6 / (2.0 * LOOKUPS);
+
+		same = same && sum == 0;
+
+		std::cout << std::left << std::setw(48) << fragmentPath << std::right << std::setw(10) << features[f] << std::setw(10) << shader.getUniformCount()
+			<< std::fixed << std::setprecision(1) << std::setw(16) << driverNs << std::setw(14) << cacheNs
+			<< std::setw(12) << (same ? "yes" : "NO") << "\n";
+
+		if (!same)
+			failures++;
+
+		glDeleteProgram(shader.ID);
+	}
+
+	std::cout << (failures ? std::to_string(failures) + " SHADERS FAILED" : std::string("all shaders ok")) << "\n" << std::endl;
+
+	destroyBenchmarkContext(window);
+
+	return failures == 0;
+}
+
+void benchmarkShaderStartup() {
+
+	const char* vertexPaths[] = { "res/shaders/vertex_shader.shader", "res/shaders/vertex_shader_compact.shader" };
+	const char* fragmentPaths[] = {
+		"res/shaders/fragment_shader.shader", "res/shaders/fragment_shader.shader",
+		"res/shaders/fragment_shader.shader", "res/shaders/fragment_shader_feedback.shader"
+	};
+	const unsigned int features[] = { 0, SHADER_FEATURE_TEXTURE_ARRAY, SHADER_FEATURE_VIRTUAL_TEXTURE, 0 };
+	const char* runNames[] = { "compiled", "compiled & stored", "binary cache" };
+
+	GLFWwindow* window = createBenchmarkContext();
+
+	if (!window)
+		return;
+
+	std::cout << "===== Shader startup (" << glGetString(GL_RENDERER) << ") =====\n"
+		<< "program binaries: " << (Shader::isProgramBinarySupported() ? "supported" : "NOT SUPPORTED") << "\n"
+		<< std::left << std::setw(24) << "run" << std::right << std::setw(12) << "programs" << std::setw(12) << "cached"
+		<< std::setw(12) << "total ms" << "\n";
+
+	// without the cache, then the first start that stores the binaries, then the next start that loads them:
+	for (int run = 0; run < 3; run++) {
+
+		Shader::setBinaryCacheEnabled(run > 0);
+
+		int programs = 0, cached = 0;
+		double totalMs = 0.0;
+
+		for (const char* vertexPath : vertexPaths) {
+			for (int f = 0; f < 4; f++) {
+
+				Shader shader(vertexPath, fragmentPaths[f], features[f]);
+
+				programs++;
+				cached += shader.isFromBinaryCache() ? 1 : 0;
+				totalMs += shader.getLoadMs();
+
+				glDeleteProgram(shader.ID);
+			}
+		}
+
+		std::cout << std::left << std::setw(24) << runNames[run] << std::right << std::setw(12) << programs << std::setw(12) << cached
+			<< std::fixed << std::setprecision(2) << std::setw(12) << totalMs << "\n";
+	}
+
+	Shader::setBinaryCacheEnabled(true);
+
+	std::cout << std::endl;
+
+	destroyBenchmarkContext(window);
+}
+
+bool benchmarkInstancing() {
+
+	const unsigned int counts[] = { 1000, 10000, 100000 };
+	const int FRAMES = 10;
+	const float FOV = 45.0f;
+	const float SCREEN_HEIGHT = 256.0f; // the hidden window
+	const float MAX_PIXEL_ERROR = 0.5f;
+
+	GLFWwindow* window = createBenchmarkContext();
+
+	if (!window)
+		return false;
+
+	Shader shader("res/shaders/vertex_shader_compact.shader", "res/shaders/fragment_shader.shader");
+	Shader instancedShader("res/shaders/vertex_shader_compact.shader", "res/shaders/fragment_shader.shader", SHADER_FEATURE_INSTANCED);
+
+	SphereMeshCache meshCache;
+	LodChain lodChain(meshCache, VERTEX_FORMAT_COMPACT, TOPOLOGY_TRIANGLE_STRIP);
+
+	// a flat disc of small bodies the camera looks down on, standing still so both paths draw the same:
+	std::vector<BodyInstance> bodies(counts[2]);
+	std::mt19937 random(1);
+	std::uniform_real_distribution<float> unit(0.0f, 1.0f);
+
+	for (BodyInstance& body : bodies) {
+		body.position = glm::vec3(20.0f * unit(random) - 10.0f, 0.5f * unit(random) - 0.25f, 20.0f * unit(random) - 10.0f);
+		body.radius = 0.02f + 0.08f * unit(random);
+		body.axis = glm::vec3(0.0f, 1.0f, 0.0f);
+		body.spin = 0.0f;
+		body.orbit = 0.0f;
+		body.texture.tier = 0;
+		body.texture.layer = 0;
+	}
+
+	glm::vec3 cameraPosition(0.0f, 8.0f, 16.0f);
+
+	FrameUniforms frame;
+	frame.view = glm::lookAt(cameraPosition, glm::vec3(0.0f), glm::vec3(0.0f, 1.0f, 0.0f));
+	frame.projection = glm::perspective(glm::radians(FOV), 1.0f, 0.1f, 100.0f);
+	frame.viewProjection = frame.projection * frame.view;
+	frame.sunPosition = glm::vec4(0.0f);
+
+	FrameUniformBuffer frameUniforms;
+	BodyUniformBuffer bodyUniforms;
+	BodyInstances instances(lodChain, 1);
+
+	frameUniforms.update(frame);
+
+	std::cout << "===== Instancing (" << ThreadPool::getShared().getThreadCount() + 1 << " threads build the instances) =====\n"
+		<< std::setw(10) << "bodies" << std::setw(14) << "draws" << std::setw(14) << "build ms"
+		<< std::setw(16) << "per body ms" << std::setw(16) << "instanced ms" << std::setw(10) << "speedup" << std::setw(8) << "same" << "\n";
+
+	int failures = 0;
+
+	for (unsigned int count : counts) {
+
+		std::vector<unsigned int> levels(count, 0);
+		std::vector<glm::mat4> models(count);
+
+		// one draw per body, like the earth: its level, its entry in the Bodies block, its draw:
+		shader.use();
+		glFinish();
+
+		auto start = std::chrono::high_resolution_clock::now();
+
+		for (int f = 0; f < FRAMES; f++) {
+
+			bodyUniforms.reset();
+
+			for (unsigned int i = 0; i < count; i++) {
+
+				const BodyInstance& instance = bodies[i];
+
+				float projectedRadius = LodChain::computeProjectedRadius(instance.position, instance.radius, cameraPosition, FOV, SCREEN_HEIGHT);
+				levels[i] = lodChain.selectLevel(projectedRadius, MAX_PIXEL_ERROR, levels[i]);
+
+				BodyUniforms body;
+				body.model = glm::scale(glm::translate(glm::mat4(1.0f), instance.position), glm::vec3(instance.radius));
+				body.color = glm::vec4(1.0f);
+				body.params = glm::vec4(0.0f);
+
+				bodyUniforms.add(body);
+				models[i] = body.model;
+			}
+
+			bodyUniforms.upload();
+
+			for (unsigned int i = 0; i < count; i++) {
+
+				const SphereMesh& mesh = lodChain.getMesh(levels[i]);
+
+				glBindVertexArray(mesh.VAO);
+				glVertexAttribI1ui(3, bodyUniforms.bind(i));
+				drawIndices(mesh.indices);
+			}
+
+			glBindVertexArray(0);
+		}
+
+		glFinish();
+		double separateMs = elapsedMs(start) / FRAMES;
+
+		// the instance buffer built on the pool, one draw per level:
+		instancedShader.use();
+		glFinish();
+
+		double buildMs = 0.0;
+		start = std::chrono::high_resolution_clock::now();
+
+		for (int f = 0; f < FRAMES; f++) {
+			instances.build(bodies.data(), count, 0.0f, cameraPosition, FOV, SCREEN_HEIGHT, MAX_PIXEL_ERROR);
+			buildMs += instances.getLastBuildMs();
+			instances.draw(NULL);
+		}
+
+		glFinish();
+		double instancedMs = elapsedMs(start) / FRAMES;
+		buildMs /= FRAMES;
+
+		// the buckets have the bodies of their level in the order of the bodies, with the matrices drawn alone:
+		bool same = instances.getInstanceCount() == count;
+		unsigned int checked = 0;
+
+		for (unsigned int level = 0; level < lodChain.getLevelCount() && same; level++) {
+
+			unsigned int next = instances.getBucketStart(level, 0);
+			unsigned int end = next + instances.getBucketCount(level, 0);
+
+			for (unsigned int i = 0; i < count && same; i++) {
+
+				if (levels[i] != level)
+					continue;
+
+				same = next < end;
+
+				for (int column = 0; column < 4 && same; column++) {
+					glm::vec4 difference = instances.getInstance(next).model[column] - models[i][column];
+					same = glm::dot(difference, difference) < 1e-10f;
+				}
+
+				next++;
+				checked++;
+			}
+
+			same = same && next == end;
+		}
+
+		same = same && checked == count;
+
+		if (!same)
+			failures++;
+
+		std::cout << std::fixed << std::setprecision(3)
+			<< std::setw(10) << count << std::setw(14) << (std::to_string(count) + " / " + std::to_string(instances.getDrawCount()))
+			<< std::setw(14) << buildMs << std::setw(16) << separateMs << std::setw(16) << instancedMs
+			<< std::setw(10) << std::setprecision(1) << separateMs / instancedMs << std::setw(8) << (same ? "yes" : "NO") << "\n";
+	}
+
+	std::cout << (failures ? std::to_string(failures) + " BODY COUNTS FAILED" : std::string("all body counts ok")) << "\n" << std::endl;
+
+	instances.clear();
+	bodyUniforms.clear();
+	frameUniforms.clear();
+	meshCache.clear();
+	glDeleteProgram(shader.ID);
+	glDeleteProgram(instancedShader.ID);
+
+	destroyBenchmarkContext(window);
+
+	return failures == 0;
+}
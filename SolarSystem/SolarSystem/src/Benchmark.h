@@ -0,0 +1,63 @@
+#pragma once
+
+#include <string>
+
+// offline benchmarks, started with: SolarSystem.exe --bench <name>
+// returns false if there is no benchmark with the given name or a check in it failed
+bool runBenchmark(const std::string& name);
+
+// builds spheres with growing and shrinking resolutions and reports build time & allocations:
+void benchmarkSphereBuild();
+
+// compares the vertex kernels against calling cosf / sinf for every vertex:
+void benchmarkSphereKernels();
+
+// builds a 4096 x 2048 sphere with growing thread counts:
+void benchmarkSphereParallel();
+
+// index buffer sizes of triangle lists & strips with 16 / 32 bit indices, and their draw throughput
+// (opens a hidden window for the draws)
+void benchmarkIndexFormats();
+
+// post-transform cache statistics of the sphere triangle lists before & after optimizeVertexCache():
+void benchmarkVertexCache();
+
+// triangle count vs maximum geometric error of the uv, icosphere and cube sphere tessellations, and whether their
+// texCoords (u up to 2 on the seam) survive VERTEX_FORMAT_COMPACT, false if they don't
+bool benchmarkTessellations();
+
+// loads every texture in res/textures with Sphere::loadTexture and with the TextureLoader (whole images & streamed
+// with different budgets), reports the decode & upload time of each texture and the worst frame
+// (opens a hidden window for the uploads)
+void benchmarkTextureLoading();
+
+// cooks every texture in res/textures into the TextureCache (only the first time), reports sizes & quality,
+// then compares loading them cooked & from the sources (the second part needs a window)
+void benchmarkTextureCache();
+
+// startup time of all textures from stb_image, the cooked DDS files and the mapped archive
+// (builds res/cache/textures.pack first if needed, the uploads need a window)
+void benchmarkTextureStartup();
+
+// builds the mipmaps of every texture in res/textures with the box & Kaiser filters and each kernel, then all of them
+// on the workers, and compares the render thread time with glGenerateMipmap (that part needs a window)
+void benchmarkMipmaps();
+
+// loads every texture in res/textures and checks the internal format (the tightest for its channels, and the sRGB
+// variant), the wrap mode and the bytes of all levels the driver reports, false if one doesn't match
+// (without a window only the decoded channels & the expected sizes)
+bool checkTextureFormats();
+
+// compares glGetUniformLocation with a std::string name against the Shader's location cache for the planet shaders,
+// false if a cached location differs from the driver's (opens a hidden window)
+bool benchmarkUniforms();
+
+// builds the programs of every vertex & fragment shader pair without the binary cache, with it the first time (when the
+// binaries are stored) and again (when they are loaded), res/cache/shaders has to be empty for the second run to
+// store them (opens a hidden window)
+void benchmarkShaderStartup();
+
+// draws 1k, 10k & 100k small spheres with one draw per body (the body from the Bodies block) and instanced with
+// BodyInstances (one draw per LOD level), reports the cpu time of the instance build & the frame time of both,
+// false if a body's level or model matrix in the instances differs from the one drawn alone (opens a hidden window)
+bool benchmarkInstancing();
\ No newline at end of file
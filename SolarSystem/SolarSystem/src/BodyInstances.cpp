@@ -0,0 +1,224 @@
+#include "BodyInstances.h"
+#include "ThreadPool.h"
+
+#include <glm/gtc/matrix_transform.hpp>
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+
+
+// fewer bodies than this per chunk aren't worth a worker:
+const unsigned int MIN_BODIES_PER_CHUNK = 1024;
+
+// the orbit around the y axis, at the time:
+static glm::vec3 getOrbitPosition(const BodyInstance& body, float time) {
+
+	float angle = body.orbit * time;
+	float c = std::cos(angle);
+	float s = std::sin(angle);
+
+	return glm::vec3(c * body.position.x + s * body.position.z, body.position.y, c * body.position.z - s * body.position.x);
+}
+
+BodyInstances::BodyInstances(const LodChain& lodChain, int tierCount)
+	: lodChain(lodChain), tierCount(std::max(tierCount, 1)), bodies(NULL), instanceCount(0), chunkCount(0), time(0.0f),
+	cameraPosition(0.0f), fovY(0.0f), screenHeight(0.0f), maxPixelError(0.0f), buffer(0), capacity(0), lastBuildMs(0.0) {
+
+	bucketCount = lodChain.getLevelCount() * this->tierCount;
+	bucketStarts.assign(bucketCount + 1, 0);
+}
+
+void BodyInstances::countChunk(unsigned int chunk) {
+
+	unsigned int begin = (unsigned int)((unsigned long long)instanceCount * chunk / chunkCount);
+	unsigned int end = (unsigned int)((unsigned long long)instanceCount * (chunk + 1) / chunkCount);
+
+	unsigned int* counts = &chunkOffsets[chunk * bucketCount];
+
+	for (unsigned int i = begin; i < end; i++) {
+
+		const BodyInstance& body = bodies[i];
+
+		float projectedRadius = LodChain::computeProjectedRadius(getOrbitPosition(body, time), body.radius, cameraPosition, fovY, screenHeight);
+		levels[i] = lodChain.selectLevel(projectedRadius, maxPixelError, levels[i]);
+
+		int tier = std::min(std::max(body.texture.tier, 0), tierCount - 1);
+
+		bodyBuckets[i] = levels[i] * tierCount + tier;
+		counts[bodyBuckets[i]]++;
+	}
+}
+
+void BodyInstances::writeChunk(unsigned int chunk) {
+
+	unsigned int begin = (unsigned int)((unsigned long long)instanceCount * chunk / chunkCount);
+	unsigned int end = (unsigned int)((unsigned long long)instanceCount * (chunk + 1) / chunkCount);
+
+	unsigned int* offsets = &chunkOffsets[chunk * bucketCount];
+
+	for (unsigned int i = begin; i < end; i++) {
+
+		const BodyInstance& body = bodies[i];
+
+		// the chunks write their bodies one after the other, in the order they came:
+		InstanceAttributes& instance = instances[offsets[bodyBuckets[i]]++];
+
+		instance.model = glm::translate(glm::mat4(1.0f), getOrbitPosition(body, time));
+		instance.model = glm::rotate(instance.model, body.spin * time, body.axis);
+		instance.model = glm::scale(instance.model, glm::vec3(body.radius)); // the meshes are unit spheres
+
+		instance.params = glm::vec4(static_cast<float>(std::max(body.texture.layer, 0)), 0.0f, 0.0f, 0.0f);
+	}
+}
+
+void BodyInstances::build(const BodyInstance* bodies, unsigned int count, float time, glm::vec3 cameraPosition, float fovY, float screenHeight, float maxPixelError) {
+
+	auto start = std::chrono::high_resolution_clock::now();
+
+	this->bodies = bodies;
+	this->time = time;
+	this->cameraPosition = cameraPosition;
+	this->fovY = fovY;
+	this->screenHeight = screenHeight;
+	this->maxPixelError = maxPixelError;
+
+	instanceCount = count;
+
+	// only ever grow, new bodies start at the coarsest level:
+	if (levels.size() < count) {
+		levels.resize(count, 0);
+		bodyBuckets.resize(count);
+		instances.resize(count);
+	}
+
+	unsigned int threads = ThreadPool::getShared().getThreadCount() + 1;
+	chunkCount = std::min(threads, (count + MIN_BODIES_PER_CHUNK - 1) / MIN_BODIES_PER_CHUNK);
+
+	chunkOffsets.assign(chunkCount * bucketCount, 0);
+
+	// the levels & how many bodies of each bucket every chunk has:
+	ThreadPool::getShared().parallelFor((int)chunkCount, chunkCount, [this](int begin, int end) {
+		for (int chunk = begin; chunk < end; chunk++)
+			countChunk(chunk);
+	});
+
+	// where each bucket starts, and each chunk in it:
+	unsigned int offset = 0;
+
+	for (unsigned int bucket = 0; bucket < bucketCount; bucket++) {
+
+		bucketStarts[bucket] = offset;
+
+		for (unsigned int chunk = 0; chunk < chunkCount; chunk++) {
+			unsigned int bodyCount = chunkOffsets[chunk * bucketCount + bucket];
+			chunkOffsets[chunk * bucketCount + bucket] = offset;
+			offset += bodyCount;
+		}
+	}
+
+	bucketStarts[bucketCount] = offset;
+
+	// the matrices, sorted into the buckets:
+	ThreadPool::getShared().parallelFor((int)chunkCount, chunkCount, [this](int begin, int end) {
+		for (int chunk = begin; chunk < end; chunk++)
+			writeChunk(chunk);
+	});
+
+	if (count > 0) {
+
+		if (!buffer)
+			glGenBuffers(1, &buffer);
+
+		std::size_t size = count * sizeof(InstanceAttributes);
+
+		// grows to the largest frame, orphaned every frame after that:
+		capacity = std::max(capacity, size);
+
+		glBindBuffer(GL_ARRAY_BUFFER, buffer);
+		glBufferData(GL_ARRAY_BUFFER, capacity, NULL, GL_STREAM_DRAW);
+		glBufferSubData(GL_ARRAY_BUFFER, 0, size, instances.data());
+		glBindBuffer(GL_ARRAY_BUFFER, 0);
+	}
+
+	lastBuildMs = std::chrono::duration<double, std::milli>(std::chrono::high_resolution_clock::now() - start).count();
+}
+
+void BodyInstances::setupInstanceAttributes(unsigned int firstInstance) const {
+
+	glBindBuffer(GL_ARRAY_BUFFER, buffer);
+
+	GLsizei stride = sizeof(InstanceAttributes);
+	std::size_t offset = firstInstance * sizeof(InstanceAttributes);
+
+	// the 4 columns of the model matrix, then the params:
+	for (unsigned int i = 0; i < 5; i++) {
+
+		unsigned int location = INSTANCE_ATTRIBUTE_LOCATION + i;
+
+		glEnableVertexAttribArray(location);
+		glVertexAttribPointer(location, 4, GL_FLOAT, GL_FALSE, stride, (void*)(offset + i * sizeof(glm::vec4)));
+		glVertexAttribDivisor(location, 1);
+	}
+
+	glBindBuffer(GL_ARRAY_BUFFER, 0);
+}
+
+void BodyInstances::draw(const TextureArray* textures) const {
+
+	if (!instanceCount)
+		return;
+
+	for (unsigned int level = 0; level < lodChain.getLevelCount(); level++) {
+
+		for (int tier = 0; tier < tierCount; tier++) {
+
+			unsigned int bucket = level * tierCount + tier;
+			unsigned int bodyCount = bucketStarts[bucket + 1] - bucketStarts[bucket];
+
+			if (!bodyCount)
+				continue;
+
+			const SphereMesh& mesh = lodChain.getMesh(level);
+
+			// the VAO is the mesh's, the attributes point at the bucket (no base instance in GL 3.3):
+			glBindVertexArray(mesh.VAO);
+			setupInstanceAttributes(bucketStarts[bucket]);
+
+			if (textures)
+				textures->bind(tier, 0);
+
+			drawIndices(mesh.indices, (int)bodyCount);
+
+			// the single body draws use the same VAO:
+			for (unsigned int i = 0; i < 5; i++)
+				glDisableVertexAttribArray(INSTANCE_ATTRIBUTE_LOCATION + i);
+
+			glBindVertexArray(0);
+		}
+	}
+}
+
+unsigned int BodyInstances::getDrawCount() const {
+
+	unsigned int drawCount = 0;
+
+	for (unsigned int bucket = 0; bucket < bucketCount; bucket++) {
+		if (bucketStarts[bucket + 1] > bucketStarts[bucket])
+			drawCount++;
+	}
+
+	return drawCount;
+}
+
+void BodyInstances::clear() {
+
+	if (buffer) {
+		glDeleteBuffers(1, &buffer);
+		buffer = 0;
+	}
+
+	capacity = 0;
+	instanceCount = 0;
+	bucketStarts.assign(bucketCount + 1, 0);
+}
@@ -0,0 +1,98 @@
+#pragma once
+
+#include "PlanetLod.h"
+#include "TextureArray.h"
+
+#include <GL/glew.h>
+#include <glm/glm.hpp>
+
+#include <vector>
+#include <cstddef>
+
+
+// the per instance attributes of the INSTANCED shaders: the model matrix in 4 - 7, the params in 8
+const unsigned int INSTANCE_ATTRIBUTE_LOCATION = 4;
+
+// a body of the instanced path, constant from frame to frame (build() turns it with the time):
+struct BodyInstance {
+	glm::vec3 position;	// at time 0
+	float radius;
+	glm::vec3 axis;		// of its spin, unit length
+	float spin;			// radians per second around axis
+	float orbit;		// radians per second around the y axis through the origin
+	TextureArrayLayer texture;
+};
+
+// an instance in the instance buffer, the same layout as the attributes:
+struct InstanceAttributes {
+	glm::mat4 model;
+	glm::vec4 params;	// x: layer in the texture array, yzw: unused
+};
+
+// draws lots of bodies that share the LodChain's meshes with one glDrawElementsInstanced per bucket (a LOD level & a
+// texture array tier): build() picks the level of every body, sorts the bodies into their buckets & writes their
+// matrices on the shared ThreadPool, then uploads them as one instance buffer for draw()
+// the arrays only grow, a frame with no more bodies than the largest one so far allocates nothing
+// needs a current OpenGL context
+class BodyInstances {
+
+public:
+
+	// the tiers of the texture array the bodies use, the layers are in the instances:
+	BodyInstances(const LodChain& lodChain, int tierCount);
+	~BodyInstances() { clear(); }
+
+	BodyInstances(const BodyInstances&) = delete;
+	BodyInstances& operator=(const BodyInstances&) = delete;
+
+	// the bodies of this frame, once per frame (the level of body i is kept for the next frame's hysteresis,
+	// so the bodies have to stay in the same order):
+	void build(const BodyInstance* bodies, unsigned int count, float time, glm::vec3 cameraPosition, float fovY, float screenHeight, float maxPixelError);
+
+	// one instanced draw per bucket with bodies, the program has to be an INSTANCED variant
+	// (binds the tier of each bucket to unit 0, NULL: the texture is bound already):
+	void draw(const TextureArray* textures) const;
+
+	unsigned int getInstanceCount() const { return instanceCount; }
+
+	// the instances of a bucket are getInstance(start) ... getInstance(start + count - 1), in the order of the bodies:
+	unsigned int getBucketStart(unsigned int level, int tier) const { return bucketStarts[level * tierCount + tier]; }
+	unsigned int getBucketCount(unsigned int level, int tier) const { return bucketStarts[level * tierCount + tier + 1] - getBucketStart(level, tier); }
+	const InstanceAttributes& getInstance(unsigned int index) const { return instances[index]; }
+	unsigned int getDrawCount() const;
+	double getLastBuildMs() const { return lastBuildMs; }
+	std::size_t getMemorySize() const { return capacity; }
+
+	// deletes the buffer, before the context goes:
+	void clear();
+
+private:
+
+	const LodChain& lodChain;
+	int tierCount;
+	unsigned int bucketCount;	// levels * tiers, bucket = level * tierCount + tier
+
+	const BodyInstance* bodies;	// of the build() running
+	unsigned int instanceCount;
+	unsigned int chunkCount;
+	float time;
+	glm::vec3 cameraPosition;
+	float fovY, screenHeight, maxPixelError;
+
+	std::vector<unsigned int> levels;			// per body, from the last frame
+	std::vector<unsigned int> bodyBuckets;		// per body
+	std::vector<unsigned int> chunkOffsets;		// per chunk & bucket: the count, then where the chunk writes next
+	std::vector<unsigned int> bucketStarts;		// per bucket + the end
+	std::vector<InstanceAttributes> instances;	// sorted by bucket
+
+	unsigned int buffer;
+	std::size_t capacity;	// # of bytes of the buffer's store
+
+	double lastBuildMs;
+
+	// the two passes over the bodies of a chunk:
+	void countChunk(unsigned int chunk);
+	void writeChunk(unsigned int chunk);
+
+	void setupInstanceAttributes(unsigned int firstInstance) const;
+};
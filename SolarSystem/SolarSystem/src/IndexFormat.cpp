@@ -0,0 +1,48 @@
+#include "IndexFormat.h"
+
+#include <cstdint>
+#include <cstring>
+
+
+void packIndices(const unsigned int* indices, std::size_t count, unsigned int vertexCount, Index_Topology topology, MeshIndices& out) {
+
+	out.topology = topology;
+	out.count = (unsigned int)count;
+
+	// 0xFFFF is reserved for the restart index:
+	if (vertexCount < 0xFFFF) {
+
+		out.type = GL_UNSIGNED_SHORT;
+		out.data.resize(count * sizeof(uint16_t));
+
+		uint16_t* narrow = (uint16_t*)out.data.data();
+
+		for (std::size_t i = 0; i < count; i++) {
+			narrow[i] = indices[i] == PRIMITIVE_RESTART_INDEX ? (uint16_t)0xFFFF : (uint16_t)indices[i];
+		}
+	}
+	else {
+
+		out.type = GL_UNSIGNED_INT;
+		out.data.resize(count * sizeof(unsigned int));
+
+		std::memcpy(out.data.data(), indices, out.data.size());
+	}
+}
+
+void drawIndices(const MeshIndices& indices, int instanceCount) {
+
+	if (indices.topology == TOPOLOGY_TRIANGLE_STRIP) {
+		glEnable(GL_PRIMITIVE_RESTART);
+		glPrimitiveRestartIndex(indices.getRestartIndex());
+	}
+
+	if (instanceCount == 1)
+		glDrawElements(indices.getMode(), indices.count, indices.type, 0);
+	else
+		glDrawElementsInstanced(indices.getMode(), indices.count, indices.type, 0, instanceCount);
+
+	if (indices.topology == TOPOLOGY_TRIANGLE_STRIP) {
+		glDisable(GL_PRIMITIVE_RESTART);
+	}
+}
@@ -0,0 +1,37 @@
+#pragma once
+
+#include <GL/glew.h>
+
+#include <cstddef>
+#include <vector>
+
+
+// how the indices of a mesh form triangles:
+enum Index_Topology {
+	TOPOLOGY_TRIANGLES,			// GL_TRIANGLES list
+	TOPOLOGY_TRIANGLE_STRIP		// GL_TRIANGLE_STRIP, the strips separated by the primitive restart index
+};
+
+// restart index of the 32 bit index arrays, becomes 0xFFFF when the indices are narrowed to 16 bit
+const unsigned int PRIMITIVE_RESTART_INDEX = 0xFFFFFFFF;
+
+
+// index data as it goes into the element buffer, 16 bit wide when every vertex fits
+struct MeshIndices {
+
+	Index_Topology topology;
+	GLenum type;			// GL_UNSIGNED_SHORT or GL_UNSIGNED_INT
+	unsigned int count;
+	std::vector<unsigned char> data;
+
+	GLenum getMode() const { return topology == TOPOLOGY_TRIANGLE_STRIP ? GL_TRIANGLE_STRIP : GL_TRIANGLES; }
+	unsigned int getSize() const { return (unsigned int)data.size(); } // # of bytes
+	unsigned int getRestartIndex() const { return type == GL_UNSIGNED_SHORT ? 0xFFFF : PRIMITIVE_RESTART_INDEX; }
+};
+
+// copies the indices with the tightest type for vertexCount vertices (the restart index can't be a vertex)
+void packIndices(const unsigned int* indices, std::size_t count, unsigned int vertexCount, Index_Topology topology, MeshIndices& out);
+
+// glDrawElements with the mode, type and primitive restart of the indices, the element buffer has to be bound
+// (glDrawElementsInstanced for more than one instance)
+void drawIndices(const MeshIndices& indices, int instanceCount = 1);
@@ -0,0 +1,269 @@
+#include "MeshOptimizer.h"
+
+#include <cmath>
+#include <cstring>
+
+
+VertexCacheStats analyzeVertexCache(const unsigned int* indices, std::size_t indexCount, std::size_t vertexCount, unsigned int cacheSize) {
+
+	VertexCacheStats stats = { 0.0f, 0.0f };
+
+	if (indexCount < 3 || vertexCount == 0) {
+		return stats;
+	}
+
+	// a vertex is in the FIFO as long as less than cacheSize misses happened since it went in:
+	std::vector<std::size_t> insertedAt(vertexCount, 0);
+	std::size_t misses = 0;
+
+	for (std::size_t i = 0; i < indexCount; i++) {
+
+		unsigned int vertex = indices[i];
+
+		if (insertedAt[vertex] == 0 || misses - insertedAt[vertex] >= cacheSize) {
+			misses++;
+			insertedAt[vertex] = misses;
+		}
+	}
+
+	stats.acmr = (float)misses / (indexCount / 3);
+	stats.atvr = (float)misses / vertexCount;
+
+	return stats;
+}
+
+
+// Forsyth's vertex scoring:
+static const int FORSYTH_CACHE_SIZE = 32;
+static const float FORSYTH_CACHE_DECAY_POWER = 1.5f;
+static const float FORSYTH_LAST_TRIANGLE_SCORE = 0.75f;
+static const float FORSYTH_VALENCE_BOOST_SCALE = 2.0f;
+static const float FORSYTH_VALENCE_BOOST_POWER = 0.5f;
+
+static const int FORSYTH_VALENCE_TABLE_SIZE = 32;
+
+// the scores only depend on small integers, so they are looked up instead of calling powf:
+struct ForsythScoreTables {
+
+	float cachePosition[FORSYTH_CACHE_SIZE];
+	float valence[FORSYTH_VALENCE_TABLE_SIZE];
+
+	ForsythScoreTables() {
+
+		for (int i = 0; i < FORSYTH_CACHE_SIZE; i++) {
+			// the vertices of the last triangle get a fixed score, so the next triangle doesn't just reuse all of them:
+			if (i < 3) {
+				cachePosition[i] = FORSYTH_LAST_TRIANGLE_SCORE;
+			}
+			else {
+				float scaler = 1.0f / (FORSYTH_CACHE_SIZE - 3);
+				cachePosition[i] = powf(1.0f - (i - 3) * scaler, FORSYTH_CACHE_DECAY_POWER);
+			}
+		}
+
+		// vertices with few triangles left are worth finishing:
+		valence[0] = 0.0f;
+		for (int i = 1; i < FORSYTH_VALENCE_TABLE_SIZE; i++) {
+			valence[i] = FORSYTH_VALENCE_BOOST_SCALE * powf((float)i, -FORSYTH_VALENCE_BOOST_POWER);
+		}
+	}
+};
+
+static float forsythVertexScore(const ForsythScoreTables& tables, int cachePosition, unsigned int remainingTriangles) {
+
+	if (remainingTriangles == 0) {
+		return -1.0f;
+	}
+
+	float score = cachePosition >= 0 ? tables.cachePosition[cachePosition] : 0.0f;
+
+	if (remainingTriangles < (unsigned int)FORSYTH_VALENCE_TABLE_SIZE) {
+		score += tables.valence[remainingTriangles];
+	}
+	else {
+		score += FORSYTH_VALENCE_BOOST_SCALE * powf((float)remainingTriangles, -FORSYTH_VALENCE_BOOST_POWER);
+	}
+
+	return score;
+}
+
+void optimizeVertexCache(unsigned int* indices, std::size_t indexCount, std::size_t vertexCount) {
+
+	const std::size_t NO_TRIANGLE = (std::size_t)-1;
+
+	static const ForsythScoreTables tables;
+
+	std::size_t triangleCount = indexCount / 3;
+
+	if (triangleCount == 0) {
+		return;
+	}
+
+	// triangles of every vertex, the not yet emitted ones at the front of each list:
+	std::vector<unsigned int> remaining(vertexCount, 0);
+	std::vector<std::size_t> adjacencyOffset(vertexCount + 1, 0);
+	std::vector<std::size_t> adjacency(triangleCount * 3);
+
+	for (std::size_t i = 0; i < triangleCount * 3; i++) {
+		remaining[indices[i]]++;
+	}
+
+	for (std::size_t v = 0; v < vertexCount; v++) {
+		adjacencyOffset[v + 1] = adjacencyOffset[v] + remaining[v];
+	}
+
+	std::vector<std::size_t> fill(adjacencyOffset.begin(), adjacencyOffset.end() - 1);
+
+	for (std::size_t i = 0; i < triangleCount * 3; i++) {
+		adjacency[fill[indices[i]]++] = i / 3;
+	}
+
+	std::vector<int> cachePosition(vertexCount, -1);
+	std::vector<float> vertexScore(vertexCount);
+	std::vector<float> triangleScore(triangleCount, 0.0f);
+	std::vector<char> emitted(triangleCount, 0);
+
+	for (std::size_t v = 0; v < vertexCount; v++) {
+		vertexScore[v] = forsythVertexScore(tables, -1, remaining[v]);
+	}
+
+	std::size_t bestTriangle = 0;
+
+	for (std::size_t t = 0; t < triangleCount; t++) {
+
+		triangleScore[t] = vertexScore[indices[t * 3]] + vertexScore[indices[t * 3 + 1]] + vertexScore[indices[t * 3 + 2]];
+
+		if (triangleScore[t] > triangleScore[bestTriangle]) {
+			bestTriangle = t;
+		}
+	}
+
+	std::vector<unsigned int> output(triangleCount * 3);
+	std::size_t outputCount = 0;
+
+	// LRU cache, + 3 for the vertices pushed out by the last triangle:
+	unsigned int cache[FORSYTH_CACHE_SIZE + 3];
+	unsigned int newCache[FORSYTH_CACHE_SIZE + 3];
+	int cacheCount = 0;
+
+	std::size_t scanPosition = 0;
+
+	for (std::size_t n = 0; n < triangleCount; n++) {
+
+		// nothing in the cache has triangles left, take the next triangle in the original order:
+		if (bestTriangle == NO_TRIANGLE) {
+			while (emitted[scanPosition]) {
+				scanPosition++;
+			}
+			bestTriangle = scanPosition;
+		}
+
+		const unsigned int* triangle = indices + bestTriangle * 3;
+
+		emitted[bestTriangle] = 1;
+		output[outputCount++] = triangle[0];
+		output[outputCount++] = triangle[1];
+		output[outputCount++] = triangle[2];
+
+		// the triangle moves to the end of the lists of its vertices:
+		for (int k = 0; k < 3; k++) {
+
+			unsigned int v = triangle[k];
+			std::size_t* list = adjacency.data() + adjacencyOffset[v];
+
+			for (unsigned int a = 0; a < remaining[v]; a++) {
+				if (list[a] == bestTriangle) {
+					list[a] = list[remaining[v] - 1];
+					list[remaining[v] - 1] = bestTriangle;
+					break;
+				}
+			}
+
+			remaining[v]--;
+		}
+
+		// the triangle's vertices go to the front of the cache:
+		int newCacheCount = 0;
+
+		for (int k = 0; k < 3; k++) {
+			newCache[newCacheCount++] = triangle[k];
+		}
+
+		for (int c = 0; c < cacheCount; c++) {
+
+			unsigned int v = cache[c];
+
+			if (v != triangle[0] && v != triangle[1] && v != triangle[2]) {
+				newCache[newCacheCount++] = v;
+			}
+		}
+
+		for (int c = 0; c < newCacheCount; c++) {
+
+			unsigned int v = newCache[c];
+
+			cachePosition[v] = c < FORSYTH_CACHE_SIZE ? c : -1;
+			vertexScore[v] = forsythVertexScore(tables, cachePosition[v], remaining[v]);
+		}
+
+		// only the triangles around the cache changed their score:
+		bestTriangle = NO_TRIANGLE;
+		float bestScore = -1.0f;
+
+		for (int c = 0; c < newCacheCount; c++) {
+
+			unsigned int v = newCache[c];
+			const std::size_t* list = adjacency.data() + adjacencyOffset[v];
+
+			for (unsigned int a = 0; a < remaining[v]; a++) {
+
+				std::size_t t = list[a];
+				triangleScore[t] = vertexScore[indices[t * 3]] + vertexScore[indices[t * 3 + 1]] + vertexScore[indices[t * 3 + 2]];
+
+				if (triangleScore[t] > bestScore) {
+					bestScore = triangleScore[t];
+					bestTriangle = t;
+				}
+			}
+		}
+
+		cacheCount = newCacheCount < FORSYTH_CACHE_SIZE ? newCacheCount : FORSYTH_CACHE_SIZE;
+		std::memcpy(cache, newCache, cacheCount * sizeof(unsigned int));
+	}
+
+	std::memcpy(indices, output.data(), output.size() * sizeof(unsigned int));
+}
+
+void optimizeVertexFetch(float* vertices, std::size_t vertexCount, int floatsPerVertex,
+						 unsigned int* indices, std::size_t indexCount, std::vector<unsigned int>& remap) {
+
+	const unsigned int UNUSED = 0xFFFFFFFF;
+
+	remap.assign(vertexCount, UNUSED);
+	unsigned int next = 0;
+
+	for (std::size_t i = 0; i < indexCount; i++) {
+
+		unsigned int& target = remap[indices[i]];
+
+		if (target == UNUSED) {
+			target = next++;
+		}
+
+		indices[i] = target;
+	}
+
+	for (std::size_t v = 0; v < vertexCount; v++) {
+		if (remap[v] == UNUSED) {
+			remap[v] = next++;
+		}
+	}
+
+	std::vector<float> reordered(vertexCount * floatsPerVertex);
+
+	for (std::size_t v = 0; v < vertexCount; v++) {
+		std::memcpy(reordered.data() + (std::size_t)remap[v] * floatsPerVertex, vertices + v * floatsPerVertex, floatsPerVertex * sizeof(float));
+	}
+
+	std::memcpy(vertices, reordered.data(), reordered.size() * sizeof(float));
+}
@@ -0,0 +1,23 @@
+#pragma once
+
+#include <cstddef>
+#include <vector>
+
+
+// post-transform vertex cache behaviour of a triangle list:
+struct VertexCacheStats {
+	float acmr; // average cache miss ratio, transformed vertices per triangle (0.5 is the best possible)
+	float atvr; // average transformed vertex ratio, transformed vertices per vertex (1.0 is the best possible)
+};
+
+// simulates a FIFO cache of cacheSize vertices over the triangle list:
+VertexCacheStats analyzeVertexCache(const unsigned int* indices, std::size_t indexCount, std::size_t vertexCount, unsigned int cacheSize = 16);
+
+// reorders the triangles of a triangle list for post-transform cache reuse (Tom Forsyth's linear-speed algorithm),
+// works on any mesh, the triangles and their winding stay the same
+void optimizeVertexCache(unsigned int* indices, std::size_t indexCount, std::size_t vertexCount);
+
+// reorders the vertices in the order the indices first use them and updates the indices,
+// remap[old vertex] = new vertex (unused vertices go to the end)
+void optimizeVertexFetch(float* vertices, std::size_t vertexCount, int floatsPerVertex,
+						 unsigned int* indices, std::size_t indexCount, std::vector<unsigned int>& remap);
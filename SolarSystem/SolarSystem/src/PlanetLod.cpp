@@ -0,0 +1,60 @@
+#include "PlanetLod.h"
+
+
+// a coarser level has to be under this part of the error limit before switching back to it:
+const float LOD_HYSTERESIS = 0.6f;
+
+
+LodChain::LodChain(SphereMeshCache& meshCache, Vertex_Format format, Index_Topology topology, int coarsestStacks, unsigned int levelCount) {
+
+	const float PI = acos(-1);
+
+	int stacks = coarsestStacks;
+
+	for (unsigned int i = 0; i < levelCount; i++, stacks *= 2) {
+
+		// twice as many sectors as stacks keeps the quads square at the equator:
+		int sectors = 2 * stacks;
+
+		Level level;
+		level.mesh = &meshCache.get(sectors, stacks, format, topology);
+
+		// the deepest point is the middle of an equator quad:
+		level.relativeError = 1.0f - cosf(PI / sectors) * cosf(PI / (2 * stacks));
+
+		levels.push_back(level);
+	}
+}
+
+unsigned int LodChain::selectLevel(float projectedRadius, float maxPixelError, unsigned int currentLevel) const {
+
+	unsigned int level = currentLevel < levels.size() ? currentLevel : (unsigned int)levels.size() - 1;
+
+	// refine while the error is visible:
+	while (level + 1 < levels.size() && levels[level].relativeError * projectedRadius > maxPixelError) {
+		level++;
+	}
+
+	// coarsen only with a margin:
+	while (level > 0 && levels[level - 1].relativeError * projectedRadius < maxPixelError * LOD_HYSTERESIS) {
+		level--;
+	}
+
+	return level;
+}
+
+float LodChain::computeProjectedRadius(glm::vec3 center, float radius, glm::vec3 cameraPosition, float fovY, float screenHeight) {
+
+	float distance = glm::length(center - cameraPosition);
+
+	// inside the sphere it covers the whole screen:
+	if (distance <= radius) {
+		return screenHeight;
+	}
+
+	// the silhouette is the tangent cone, not the radius at the center's distance:
+	float tangentDistance = sqrtf(distance * distance - radius * radius);
+	float pixelsPerUnit = screenHeight / (2.0f * tanf(glm::radians(fovY) / 2.0f));
+
+	return radius / tangentDistance * pixelsPerUnit;
+}
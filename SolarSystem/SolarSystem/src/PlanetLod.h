@@ -0,0 +1,38 @@
+#pragma once
+
+#include "SphereMeshCache.h"
+
+#include <glm/glm.hpp>
+
+
+// sphere meshes of growing resolution, shared by every body drawn with them
+// each body only keeps its current level and picks the next one from its size on the screen
+class LodChain {
+
+public:
+
+	// builds & uploads all levels up front, level 0 has coarsestStacks stacks and every level doubles it
+	LodChain(SphereMeshCache& meshCache, Vertex_Format format, Index_Topology topology, int coarsestStacks = 4, unsigned int levelCount = 7);
+
+	unsigned int getLevelCount() const { return (unsigned int)levels.size(); }
+	const SphereMesh& getMesh(unsigned int level) const { return *levels[level].mesh; }
+
+	// largest distance between the mesh and the sphere, relative to the radius:
+	float getRelativeError(unsigned int level) const { return levels[level].relativeError; }
+
+	// the coarsest level whose error stays under maxPixelError pixels for a sphere of projectedRadius pixels,
+	// going back to a coarser level only when it's well under the limit, so the level doesn't flicker at the boundary
+	unsigned int selectLevel(float projectedRadius, float maxPixelError, unsigned int currentLevel) const;
+
+	// radius of the sphere's silhouette in pixels (fovY in degrees like Camera::Zoom):
+	static float computeProjectedRadius(glm::vec3 center, float radius, glm::vec3 cameraPosition, float fovY, float screenHeight);
+
+private:
+
+	struct Level {
+		const SphereMesh* mesh;
+		float relativeError;
+	};
+
+	std::vector<Level> levels;
+};
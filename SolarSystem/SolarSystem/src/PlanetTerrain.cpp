@@ -0,0 +1,453 @@
+#include "PlanetTerrain.h"
+#include "ThreadPool.h"
+#include "MeshOptimizer.h"
+
+#include <cstring>
+
+
+// cells along the edge of a patch:
+const int PATCH_RESOLUTION = 16;
+
+// the grid and a skirt hanging down from every edge, it hides the cracks next to coarser patches:
+const int PATCH_GRID_VERTEX_COUNT = (PATCH_RESOLUTION + 1) * (PATCH_RESOLUTION + 1);
+const int PATCH_VERTEX_COUNT = PATCH_GRID_VERTEX_COUNT + 4 * (PATCH_RESOLUTION + 1);
+
+// patches building at the same time & uploads per frame, so refinement never stalls a frame:
+const unsigned int MAX_PATCH_REQUESTS = 32;
+const unsigned int MAX_PATCH_UPLOADS = 16;
+
+const unsigned int NO_SLOT = 0xFFFFFFFF;
+
+
+PlanetTerrain::PlanetTerrain(Vertex_Format format, unsigned int slotCount, int maxLevel) {
+	this->format = format;
+	this->slotCount = slotCount;
+	this->maxLevel = maxLevel;
+	this->frame = 0;
+	this->ready = false;
+	this->building = 0;
+	this->VAO = 0;
+	this->VBO = 0;
+	this->EBO = 0;
+}
+
+PlanetTerrain::~PlanetTerrain() {
+
+	// the workers write into this object:
+	std::unique_lock<std::mutex> lock(finishedMutex);
+	finishedCondition.wait(lock, [this] { return building == 0; });
+	lock.unlock();
+
+	clear();
+}
+
+void PlanetTerrain::createBuffers() {
+
+	const int R = PATCH_RESOLUTION;
+
+	std::vector<unsigned int> indices;
+	indices.reserve((std::size_t)6 * R * R + (std::size_t)4 * 6 * R);
+
+	for (int i = 0; i < R; i++) {
+		for (int j = 0; j < R; j++) {
+
+			unsigned int k1 = i * (R + 1) + j;
+			unsigned int k2 = k1 + R + 1;
+
+			// the same winding as the cube sphere:
+			unsigned int quad[6] = { k1, k2, k1 + 1, k1 + 1, k2, k2 + 1 };
+			indices.insert(indices.end(), quad, quad + 6);
+		}
+	}
+
+	// skirts, edge by edge in the order buildPatch adds them:
+	for (int e = 0; e < 4; e++) {
+		for (int k = 0; k < R; k++) {
+
+			unsigned int a, b;
+
+			switch (e) {
+			case 0: a = k; b = k + 1; break;											// v = 0
+			case 1: a = R * (R + 1) + k; b = a + 1; break;								// v = 1
+			case 2: a = k * (R + 1); b = a + R + 1; break;								// u = 0
+			default: a = k * (R + 1) + R; b = a + R + 1; break;							// u = 1
+			}
+
+			unsigned int skirtA = PATCH_GRID_VERTEX_COUNT + e * (R + 1) + k;
+			unsigned int skirtB = skirtA + 1;
+
+			unsigned int quad[6] = { a, skirtA, b, b, skirtA, skirtB };
+			indices.insert(indices.end(), quad, quad + 6);
+		}
+	}
+
+	optimizeVertexCache(indices.data(), indices.size(), PATCH_VERTEX_COUNT);
+	packIndices(indices.data(), indices.size(), PATCH_VERTEX_COUNT, TOPOLOGY_TRIANGLES, patchIndices);
+
+	glGenVertexArrays(1, &VAO);
+	glBindVertexArray(VAO);
+
+	// every slot holds one patch, they are filled with glBufferSubData:
+	glGenBuffers(1, &VBO);
+	glBindBuffer(GL_ARRAY_BUFFER, VBO);
+	glBufferData(GL_ARRAY_BUFFER, (GLsizeiptr)slotCount * PATCH_VERTEX_COUNT * getVertexFormatStride(format), NULL, GL_DYNAMIC_DRAW);
+
+	setupVertexAttributes(format);
+
+	glGenBuffers(1, &EBO);
+	glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, EBO);
+	glBufferData(GL_ELEMENT_ARRAY_BUFFER, patchIndices.getSize(), patchIndices.data.data(), GL_STATIC_DRAW);
+
+	glBindVertexArray(0);
+	glBindBuffer(GL_ARRAY_BUFFER, 0);
+	glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, 0);
+
+	Slot empty = { { 0, 0, 0, 0 }, 0 };
+	slots.assign(slotCount, empty);
+
+	freeSlots.clear();
+
+	for (unsigned int s = slotCount; s > 0; s--) {
+		freeSlots.push_back(s - 1);
+	}
+}
+
+void PlanetTerrain::update(const glm::mat4& mvp, glm::vec3 cameraPosition, float fovY, float screenHeight, float maxCellPixels) {
+
+	if (VAO == 0) {
+		createBuffers();
+	}
+
+	// the planes are sums & differences of the rows of the matrix (Gribb & Hartmann):
+	glm::mat4 rows = glm::transpose(mvp);
+
+	for (int p = 0; p < 6; p++) {
+		glm::vec4 plane = rows[3] + (p % 2 == 0 ? 1.0f : -1.0f) * rows[p / 2];
+		frustum[p] = plane / glm::length(glm::vec3(plane));
+	}
+
+	frame++;
+
+	drawCounts.clear();
+	drawOffsets.clear();
+	drawBaseVertices.clear();
+
+	float pixelsPerUnit = screenHeight / (2.0f * tanf(glm::radians(fovY) / 2.0f));
+	int rootCount = 0;
+
+	for (int f = 0; f < 6; f++) {
+		for (int y = 0; y < 2; y++) {
+			for (int x = 0; x < 2; x++) {
+
+				TerrainPatchKey key = { f, 1, x, y };
+				auto it = resident.find(key);
+
+				if (it == resident.end()) {
+					request(key);
+					continue;
+				}
+
+				// the roots stay even when they are behind the horizon:
+				slots[it->second].lastUsedFrame = frame;
+				rootCount++;
+
+				select(key, cameraPosition, pixelsPerUnit, maxCellPixels);
+			}
+		}
+	}
+
+	ready = rootCount == 24;
+
+	uploadFinished();
+}
+
+void PlanetTerrain::select(const TerrainPatchKey& key, glm::vec3 cameraPosition, float pixelsPerUnit, float maxCellPixels) {
+
+	float size = 2.0f / (1 << key.level);
+	float u0 = -1.0f + key.x * size;
+	float v0 = -1.0f + key.y * size;
+
+	glm::vec3 center = Sphere::spherifyCubePoint(Sphere::getCubeFacePoint(key.face, u0 + size / 2, v0 + size / 2));
+
+	// bounding sphere around the center:
+	float radius = 0.0f;
+
+	for (int c = 0; c < 4; c++) {
+		glm::vec3 corner = Sphere::spherifyCubePoint(Sphere::getCubeFacePoint(key.face, u0 + size * (c & 1), v0 + size * (c >> 1)));
+		radius = std::max(radius, glm::length(corner - center));
+	}
+
+	float distance = glm::length(cameraPosition);
+
+	// everything further around the sphere than the horizon is hidden by the sphere itself:
+	if (distance > 1.0f) {
+
+		float horizon = acosf(1.0f / distance);
+		float angle = acosf(glm::clamp(glm::dot(center, cameraPosition) / distance, -1.0f, 1.0f));
+		float angularRadius = 2.0f * asinf(std::min(radius / 2.0f, 1.0f));
+
+		if (angle - angularRadius > horizon)
+			return;
+	}
+
+	unsigned int slot = resident[key];
+	slots[slot].lastUsedFrame = frame;
+
+	// the parents stay resident for when the camera turns, only what is drawn is culled:
+	for (int p = 0; p < 6; p++) {
+		if (glm::dot(glm::vec3(frustum[p]), center) + frustum[p].w < -radius)
+			return;
+	}
+
+	float nearest = std::max(glm::length(cameraPosition - center) - radius, 1e-5f);
+	float cellPixels = 2.0f * radius / nearest * pixelsPerUnit / PATCH_RESOLUTION;
+
+	if (key.level < maxLevel && cellPixels > maxCellPixels) {
+
+		TerrainPatchKey children[4];
+		bool childrenReady = true;
+
+		for (int c = 0; c < 4; c++) {
+
+			children[c] = { key.face, key.level + 1, 2 * key.x + (c & 1), 2 * key.y + (c >> 1) };
+
+			auto child = resident.find(children[c]);
+
+			if (child == resident.end()) {
+				request(children[c]);
+				childrenReady = false;
+			}
+			else {
+				// kept while its siblings are still building:
+				slots[child->second].lastUsedFrame = frame;
+			}
+		}
+
+		// until all 4 are there this patch stands in for them:
+		if (childrenReady) {
+			for (int c = 0; c < 4; c++) {
+				select(children[c], cameraPosition, pixelsPerUnit, maxCellPixels);
+			}
+			return;
+		}
+	}
+
+	drawCounts.push_back(patchIndices.count);
+	drawOffsets.push_back(NULL);
+	drawBaseVertices.push_back((GLint)(slot * PATCH_VERTEX_COUNT));
+}
+
+void PlanetTerrain::request(const TerrainPatchKey& key) {
+
+	if (requested.size() >= MAX_PATCH_REQUESTS || !requested.insert(key).second)
+		return;
+
+	{
+		std::lock_guard<std::mutex> lock(finishedMutex);
+		building++;
+	}
+
+	Vertex_Format format = this->format;
+
+	ThreadPool::getShared().enqueue([this, key, format]() {
+
+		PatchData patch;
+		patch.key = key;
+		buildPatch(key, format, patch.vertices);
+
+		std::lock_guard<std::mutex> lock(finishedMutex);
+		finished.push_back(std::move(patch));
+		building--;
+		finishedCondition.notify_all();
+	});
+}
+
+void PlanetTerrain::uploadFinished() {
+
+	std::vector<PatchData> uploads;
+
+	{
+		std::lock_guard<std::mutex> lock(finishedMutex);
+
+		while (!finished.empty() && uploads.size() < MAX_PATCH_UPLOADS) {
+			uploads.push_back(std::move(finished.front()));
+			finished.pop_front();
+		}
+	}
+
+	if (uploads.empty())
+		return;
+
+	glBindBuffer(GL_ARRAY_BUFFER, VBO);
+
+	for (PatchData& patch : uploads) {
+
+		requested.erase(patch.key);
+
+		// a patch requested before clear():
+		if (resident.find(patch.key) != resident.end())
+			continue;
+
+		unsigned int slot = allocateSlot();
+
+		// every slot is on the screen, it's requested again when it still matters:
+		if (slot == NO_SLOT)
+			continue;
+
+		glBufferSubData(GL_ARRAY_BUFFER, (GLintptr)slot * patch.vertices.size(), patch.vertices.size(), patch.vertices.data());
+
+		slots[slot].key = patch.key;
+		slots[slot].lastUsedFrame = frame;
+		resident[patch.key] = slot;
+	}
+
+	glBindBuffer(GL_ARRAY_BUFFER, 0);
+}
+
+unsigned int PlanetTerrain::allocateSlot() {
+
+	if (!freeSlots.empty()) {
+		unsigned int slot = freeSlots.back();
+		freeSlots.pop_back();
+		return slot;
+	}
+
+	// the least recently used patch, but none of this frame:
+	unsigned int oldest = NO_SLOT;
+
+	for (unsigned int s = 0; s < slots.size(); s++) {
+		if (slots[s].lastUsedFrame < frame && (oldest == NO_SLOT || slots[s].lastUsedFrame < slots[oldest].lastUsedFrame)) {
+			oldest = s;
+		}
+	}
+
+	if (oldest != NO_SLOT) {
+		resident.erase(slots[oldest].key);
+	}
+
+	return oldest;
+}
+
+void PlanetTerrain::draw() const {
+
+	if (drawBaseVertices.empty())
+		return;
+
+	glBindVertexArray(VAO);
+	// one call for all patches (glew's prototype takes non-const arrays):
+	glMultiDrawElementsBaseVertex(GL_TRIANGLES, const_cast<GLsizei*>(drawCounts.data()), patchIndices.type, const_cast<void**>(drawOffsets.data()),
+								  (GLsizei)drawCounts.size(), const_cast<GLint*>(drawBaseVertices.data()));
+	glBindVertexArray(0);
+}
+
+std::size_t PlanetTerrain::getMemorySize() const {
+
+	if (VAO == 0)
+		return 0;
+
+	return (std::size_t)slotCount * PATCH_VERTEX_COUNT * getVertexFormatStride(format) + patchIndices.getSize();
+}
+
+void PlanetTerrain::clear() {
+
+	if (VAO != 0) {
+		glDeleteVertexArrays(1, &VAO);
+		glDeleteBuffers(1, &VBO);
+		glDeleteBuffers(1, &EBO);
+	}
+
+	VAO = 0;
+	VBO = 0;
+	EBO = 0;
+
+	slots.clear();
+	freeSlots.clear();
+	resident.clear();
+	requested.clear();
+	ready = false;
+
+	drawCounts.clear();
+	drawOffsets.clear();
+	drawBaseVertices.clear();
+}
+
+void PlanetTerrain::buildPatch(const TerrainPatchKey& key, Vertex_Format format, std::vector<unsigned char>& vertices) {
+
+	const float PI = acos(-1);
+	const float POLE_EPSILON = 1e-6f;
+	const int R = PATCH_RESOLUTION;
+
+	float size = 2.0f / (1 << key.level);
+	float u0 = -1.0f + key.x * size;
+	float v0 = -1.0f + key.y * size;
+
+	// the same texture mapping as the spheres, the seam runs along patch edges from level 1 on,
+	// so the seam & pole vertices just take the s closest to the center of the patch:
+	glm::vec3 center = Sphere::spherifyCubePoint(Sphere::getCubeFacePoint(key.face, u0 + size / 2, v0 + size / 2));
+
+	float centerS = atan2f(center.z, -center.x) / (2 * PI);
+	centerS = centerS < 0.0f ? centerS + 1.0f : centerS;
+
+	// a quarter of a cell down, more than the gap to the coarser neighbor:
+	float skirtScale = 1.0f - 0.25f * (PI / 2) / (1 << key.level) / R;
+
+	std::vector<float> interleaved((std::size_t)PATCH_VERTEX_COUNT * 8);
+	float* out = interleaved.data();
+
+	for (int i = 0; i <= R; i++) {
+		for (int j = 0; j <= R; j++) {
+
+			glm::vec3 point = Sphere::spherifyCubePoint(Sphere::getCubeFacePoint(key.face, u0 + size * j / R, v0 + size * i / R));
+
+			float s = centerS;
+
+			if (fabsf(point.x) > POLE_EPSILON || fabsf(point.z) > POLE_EPSILON) {
+
+				s = atan2f(point.z, -point.x) / (2 * PI);
+
+				if (s - centerS > 0.5f) s -= 1.0f;
+				if (s - centerS < -0.5f) s += 1.0f;
+			}
+
+			// position, normal (the same on the unit sphere), texCoord:
+			*out++ = point.x;
+			*out++ = point.y;
+			*out++ = point.z;
+			*out++ = point.x;
+			*out++ = point.y;
+			*out++ = point.z;
+			*out++ = glm::clamp(s, 0.0f, 1.0f);
+			*out++ = acosf(glm::clamp(-point.y, -1.0f, 1.0f)) / PI;
+		}
+	}
+
+	// skirts, copies of the edge vertices moved inwards (v = 0, v = 1, u = 0, u = 1):
+	for (int e = 0; e < 4; e++) {
+		for (int k = 0; k <= R; k++) {
+
+			int edge;
+
+			switch (e) {
+			case 0: edge = k; break;
+			case 1: edge = R * (R + 1) + k; break;
+			case 2: edge = k * (R + 1); break;
+			default: edge = k * (R + 1) + R; break;
+			}
+
+			const float* source = &interleaved[(std::size_t)edge * 8];
+
+			for (int c = 0; c < 8; c++) {
+				*out++ = c < 3 ? source[c] * skirtScale : source[c];
+			}
+		}
+	}
+
+	if (format == VERTEX_FORMAT_COMPACT) {
+		vertices.resize((std::size_t)PATCH_VERTEX_COUNT * sizeof(CompactVertex));
+		packCompactVertices(interleaved.data(), PATCH_VERTEX_COUNT, 1.0f, (CompactVertex*)vertices.data());
+	}
+	else {
+		vertices.resize(interleaved.size() * sizeof(float));
+		memcpy(vertices.data(), interleaved.data(), vertices.size());
+	}
+}
@@ -0,0 +1,120 @@
+#pragma once
+
+#include "Sphere.h"
+#include "VertexFormat.h"
+#include "IndexFormat.h"
+
+#include <glm/glm.hpp>
+
+#include <map>
+#include <set>
+#include <deque>
+#include <mutex>
+#include <condition_variable>
+
+
+// one node of the quadtree of a cube face, level 0 covers the whole face:
+struct TerrainPatchKey {
+
+	int face;	// 0..5 like Sphere::getCubeFacePoint
+	int level;
+	int x;		// 0 .. 2^level - 1 along u
+	int y;		// 0 .. 2^level - 1 along v
+
+	bool operator<(const TerrainPatchKey& other) const {
+		if (face != other.face) return face < other.face;
+		if (level != other.level) return level < other.level;
+		if (x != other.x) return x < other.x;
+		return y < other.y;
+	}
+};
+
+
+// the surface of the unit sphere as 6 quadtrees of patches (one per cube face), refined only near the camera
+// the patches are built on the workers of ThreadPool::getShared() and go into the slots of one shared vertex buffer,
+// when it's full the least recently drawn patches make room
+// needs a current OpenGL context
+class PlanetTerrain {
+
+public:
+
+	// maxLevel limits the refinement, 16 bit positions run out of precision around level 8
+	PlanetTerrain(Vertex_Format format, unsigned int slotCount = 1024, int maxLevel = 10);
+	~PlanetTerrain();
+
+	PlanetTerrain(const PlanetTerrain&) = delete;
+	PlanetTerrain& operator=(const PlanetTerrain&) = delete;
+
+	// picks the patches of this frame, requests the missing ones and uploads the finished ones
+	// cameraPosition is in the space of the unit sphere (inverse model matrix), fovY in degrees like Camera::Zoom,
+	// a patch is split while its cells are bigger than maxCellPixels on the screen
+	void update(const glm::mat4& mvp, glm::vec3 cameraPosition, float fovY, float screenHeight, float maxCellPixels);
+
+	// the whole surface can be drawn once the patches of level 1 are there
+	// (level 0 isn't drawn, its patches cross the texture seam)
+	bool isReady() const { return ready; }
+
+	// draws the patches picked by the last update(), the shader has to be in use:
+	void draw() const;
+
+	// for debugging:
+	unsigned int getResidentCount() const { return (unsigned int)resident.size(); }
+	unsigned int getDrawCount() const { return (unsigned int)drawBaseVertices.size(); }
+	unsigned int getPendingCount() const { return (unsigned int)requested.size(); }
+	std::size_t getMemorySize() const; // # of bytes of the gpu buffers
+
+	// deletes the gpu buffers and forgets every patch:
+	void clear();
+
+private:
+
+	struct Slot {
+		TerrainPatchKey key;
+		unsigned int lastUsedFrame;
+	};
+
+	// a patch built by a worker, waiting for the render thread:
+	struct PatchData {
+		TerrainPatchKey key;
+		std::vector<unsigned char> vertices;
+	};
+
+	Vertex_Format format;
+	unsigned int slotCount;
+	int maxLevel;
+
+	// render thread only:
+	std::vector<Slot> slots;
+	std::vector<unsigned int> freeSlots;
+	std::map<TerrainPatchKey, unsigned int> resident;	// patch -> slot
+	std::set<TerrainPatchKey> requested;				// building or waiting for the upload
+	unsigned int frame;
+	bool ready;
+
+	// what draw() submits, one entry per patch:
+	std::vector<GLsizei> drawCounts;
+	std::vector<const void*> drawOffsets;
+	std::vector<GLint> drawBaseVertices;
+
+	// shared with the workers:
+	std::deque<PatchData> finished;
+	unsigned int building;
+	std::mutex finishedMutex;
+	std::condition_variable finishedCondition;
+
+	MeshIndices patchIndices; // every patch has the same grid
+	unsigned int VAO;
+	unsigned int VBO;
+	unsigned int EBO;
+
+	void createBuffers();
+	// planes of the view frustum in the space of the unit sphere:
+	glm::vec4 frustum[6];
+
+	void select(const TerrainPatchKey& key, glm::vec3 cameraPosition, float pixelsPerUnit, float maxCellPixels);
+	void request(const TerrainPatchKey& key);
+	void uploadFinished();
+	unsigned int allocateSlot();
+
+	static void buildPatch(const TerrainPatchKey& key, Vertex_Format format, std::vector<unsigned char>& vertices);
+};
@@ -1,86 +1,360 @@
 #include "Shader.h"
+#include "ShaderPreprocessor.h"
+#include "UniformBuffers.h"
 #include <glm/gtc/type_ptr.hpp>
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstring>
+#include <fstream>
 
-Shader::Shader(const char* vertexPath, const char* fragmentPath)
+#ifdef _WIN32
+#include <direct.h>
+#else
+#include <sys/stat.h>
+#endif
+
+// bump when the layout of the cache files changes:
+const uint32_t PROGRAM_BINARY_VERSION = 1;
+
+// the cache files: the header, then the binary glGetProgramBinary returned
+struct ProgramBinaryHeader {
+	char magic[4];	// "STPB"
+	uint32_t version;
+	uint32_t format;	// for glProgramBinary
+	uint32_t length;	// # of bytes of the binary
+	uint64_t key;	// of the sources & the driver, also the name of the file
+};
+
+bool Shader::binaryCacheEnabled = true;
+
+Shader::Shader(const char* vertexPath, const char* fragmentPath, unsigned int features) : ID(0), features(features), fromBinaryCache(false), loadMs(0.0), reloadKey(0)
 {
+	reload.program = 0;
+	reload.vertex = 0;
+	reload.fragment = 0;
+
+	this->vertexPath = vertexPath;
+	this->fragmentPath = fragmentPath;
+
 	// get the source cod of the vertex and fragment shader:
 	std::string vertexCode;
 	std::string fragmentCode;
-	std::ifstream vShaderFile;
-	std::ifstream fShaderFile;
-
-	// make sure ifstream can throw exceptions:
-	vShaderFile.exceptions(std::ifstream::failbit | std::ifstream::badbit);
-	fShaderFile.exceptions(std::ifstream::failbit | std::ifstream::badbit);
-
-	try {
-		// open files:
-		vShaderFile.open(vertexPath);
-		fShaderFile.open(fragmentPath);
-		std::stringstream vShaderStream, fShaderStream;
-
-		// read file's buffer contetnts into streams:
-		vShaderStream << vShaderFile.rdbuf();
-		fShaderStream << fShaderFile.rdbuf();
-
-		//close:
-		vShaderFile.close();
-		fShaderFile.close();
-
-		// convert stream into strings:
-		vertexCode = vShaderStream.str();
-		fragmentCode = fShaderStream.str();
-	}
-	catch (std::ifstream::failure e) {
-		std::cout << "ERROR::SHADER::FILE_NOT_SUCCESSFULLY_READ" << "\n";
+
+	readSources(vertexCode, fragmentCode);
+
+	auto start = std::chrono::high_resolution_clock::now();
+
+	// a binary of the same sources from the same driver skips the compiler:
+	uint64_t key = getProgramBinaryKey(vertexCode, fragmentCode);
+	std::string binaryPath = getProgramBinaryPath(key);
+
+	fromBinaryCache = binaryCacheEnabled && loadProgramBinary(binaryPath, key);
+
+	if (!fromBinaryCache && compileProgram(vertexCode, fragmentCode) && binaryCacheEnabled)
+		saveProgramBinary(binaryPath, key);
+
+	if (ID) {
+		cacheUniformLocations();
+		bindUniformBlocks();
 	}
+
+	loadMs = std::chrono::duration<double, std::milli>(std::chrono::high_resolution_clock::now() - start).count();
+
+	std::cout << "SHADER: " << vertexPath << " + " << fragmentPath << " (features " << features << "): " << loadMs << " ms"
+		<< (fromBinaryCache ? " (binary cache)" : " (compiled)") << "\n";
+}
+
+bool Shader::readSources(std::string& vertexCode, std::string& fragmentCode)
+{
+	// the includes expanded & the defines of the features injected, cached for the other variants:
+	ShaderPreprocessor& preprocessor = ShaderPreprocessor::getShared();
+
+	const ShaderSource* vertexSource = preprocessor.get(vertexPath, features);
+	const ShaderSource* fragmentSource = preprocessor.get(fragmentPath, features);
+
+	if (!vertexSource || !fragmentSource)
+		return false;
+
+	vertexCode = vertexSource->text;
+	fragmentCode = fragmentSource->text;
+
+	files = vertexSource->files;
+	files.insert(files.end(), fragmentSource->files.begin(), fragmentSource->files.end());
+
+	return true;
+}
+
+void Shader::startProgram(const std::string& vertexCode, const std::string& fragmentCode, PendingProgram& pending)
+{
 	const char* vShaderCode = vertexCode.c_str();
 	const char* fShaderCode = fragmentCode.c_str();
 
-	// compile shaders:
-	unsigned int vertex, fragment;
+	// compile shaders, nothing here waits for the compiler (the status queries do):
+	pending.vertex = glCreateShader(GL_VERTEX_SHADER);
+	glShaderSource(pending.vertex, 1, &vShaderCode, NULL);
+	glCompileShader(pending.vertex);
+
+	pending.fragment = glCreateShader(GL_FRAGMENT_SHADER);
+	glShaderSource(pending.fragment, 1, &fShaderCode, NULL);
+	glCompileShader(pending.fragment);
+
+	pending.program = glCreateProgram();
+	glAttachShader(pending.program, pending.vertex);
+	glAttachShader(pending.program, pending.fragment);
+
+	// the driver keeps the binary around for saveProgramBinary():
+	if (binaryCacheEnabled && isProgramBinarySupported())
+		glProgramParameteri(pending.program, GL_PROGRAM_BINARY_RETRIEVABLE_HINT, GL_TRUE);
+
+	glLinkProgram(pending.program);
+}
+
+bool Shader::finishProgram(PendingProgram& pending)
+{
 	int success;
 	char infoLog[512];
 
-	// vertexShader
-	vertex = glCreateShader(GL_VERTEX_SHADER);
-	glShaderSource(vertex, 1, &vShaderCode, NULL);
-	glCompileShader(vertex);
-
 	// compile errors:
-	glGetShaderiv(vertex, GL_COMPILE_STATUS, &success);
+	glGetShaderiv(pending.vertex, GL_COMPILE_STATUS, &success);
 
 	if (!success) {
-		glGetShaderInfoLog(vertex, 512, NULL, infoLog);
+		glGetShaderInfoLog(pending.vertex, 512, NULL, infoLog);
 		std::cout << "ERROR::SHADER::VERTEX::COMPILATION\n" << infoLog << "\n";
 	}
 
-	fragment = glCreateShader(GL_FRAGMENT_SHADER);
-	glShaderSource(fragment, 1, &fShaderCode, NULL);
-	glCompileShader(fragment);
-
-	glGetShaderiv(fragment, GL_COMPILE_STATUS, &success);
+	glGetShaderiv(pending.fragment, GL_COMPILE_STATUS, &success);
 
 	if (!success) {
-		glGetShaderInfoLog(vertex, 512, NULL, infoLog);
+		glGetShaderInfoLog(pending.fragment, 512, NULL, infoLog);
 		std::cout << "ERROR::SHADER::FRAGMENT::COMPILATION\n" << infoLog << "\n";
 	}
 
-	this->ID = glCreateProgram();
-	glAttachShader(ID, vertex);
-	glAttachShader(ID, fragment);
-	glLinkProgram(ID);
-
-	glGetShaderiv(fragment, GL_LINK_STATUS, &success);
+	glGetProgramiv(pending.program, GL_LINK_STATUS, &success);
 	if (!success) {
-		glGetShaderInfoLog(vertex, 512, NULL, infoLog);
+		glGetProgramInfoLog(pending.program, 512, NULL, infoLog);
 		std::cout << "ERROR::SHADER::PROGRAM::LINKING_FAILED\n" << infoLog << "\n";
 	}
 
 	// delete Shaders:
-	glDeleteShader(vertex);
-	glDeleteShader(fragment);
+	glDetachShader(pending.program, pending.vertex);
+	glDetachShader(pending.program, pending.fragment);
+	glDeleteShader(pending.vertex);
+	glDeleteShader(pending.fragment);
+
+	pending.vertex = 0;
+	pending.fragment = 0;
+
+	return success != 0;
+}
+
+bool Shader::compileProgram(const std::string& vertexCode, const std::string& fragmentCode)
+{
+	PendingProgram pending;
+	startProgram(vertexCode, fragmentCode, pending);
+
+	ID = pending.program;
+
+	return finishProgram(pending);
+}
+
+bool Shader::isParallelCompileSupported()
+{
+	return GLEW_KHR_parallel_shader_compile || GLEW_ARB_parallel_shader_compile;
+}
+
+bool Shader::beginReload()
+{
+	// a reload that is still compiling makes way for the newer sources:
+	if (reload.program) {
+		finishProgram(reload);
+		glDeleteProgram(reload.program);
+		reload.program = 0;
+	}
+
+	std::string vertexCode, fragmentCode;
+
+	if (!readSources(vertexCode, fragmentCode))
+		return false;
+
+	reloadKey = getProgramBinaryKey(vertexCode, fragmentCode);
+	startProgram(vertexCode, fragmentCode, reload);
+
+	return true;
+}
+
+Shader_Reload Shader::pollReload()
+{
+	if (!reload.program)
+		return SHADER_RELOAD_IDLE;
+
+	// without the extension the status queries below wait for the compiler:
+	if (isParallelCompileSupported()) {
+
+		int done = GL_FALSE;
+		glGetProgramiv(reload.program, GL_COMPLETION_STATUS_KHR, &done);
+
+		if (!done)
+			return SHADER_RELOAD_PENDING;
+	}
+
+	unsigned int program = reload.program;
+	reload.program = 0;
+
+	if (!finishProgram(reload)) {
+		glDeleteProgram(program);
+		return SHADER_RELOAD_FAILED;
+	}
+
+	// the old program goes only now, a failed edit keeps it running:
+	glDeleteProgram(ID);
+	ID = program;
+
+	cacheUniformLocations();
+	bindUniformBlocks();
+
+	if (binaryCacheEnabled)
+		saveProgramBinary(getProgramBinaryPath(reloadKey), reloadKey);
+
+	return SHADER_RELOAD_SWAPPED;
+}
+
+bool Shader::isProgramBinarySupported()
+{
+	if (!GLEW_ARB_get_program_binary && !GLEW_VERSION_4_1)
+		return false;
+
+	// some drivers have the extension without a single format:
+	int formatCount = 0;
+	glGetIntegerv(GL_NUM_PROGRAM_BINARY_FORMATS, &formatCount);
+
+	return formatCount > 0;
+}
+
+// FNV-1a, 64 bits:
+static uint64_t hashBytes(const std::string& bytes, uint64_t hash)
+{
+	for (unsigned char c : bytes)
+		hash = (hash ^ c) * 1099511628211ull;
 
+	return hash;
+}
+
+uint64_t Shader::getProgramBinaryKey(const std::string& vertexCode, const std::string& fragmentCode)
+{
+	// the binaries only work with the driver that made them:
+	std::string driver;
+
+	for (GLenum name : { GL_VENDOR, GL_RENDERER, GL_VERSION }) {
+		const GLubyte* value = glGetString(name);
+		driver += value ? (const char*)value : "";
+		driver += '\n';
+	}
+
+	uint64_t hash = 14695981039346656037ull;
+	hash = hashBytes(driver, hash);
+	hash = hashBytes(vertexCode, hash);
+	hash = hashBytes(std::string(1, '\0'), hash); // "ab" + "c" isn't "a" + "bc"
+	hash = hashBytes(fragmentCode, hash);
+
+	return hash;
+}
+
+std::string Shader::getProgramBinaryPath(uint64_t key)
+{
+	char name[32];
+	snprintf(name, sizeof(name), "%016llx.bin", (unsigned long long)key);
+
+	return std::string(SHADER_CACHE_DIRECTORY) + "/" + name;
+}
+
+bool Shader::loadProgramBinary(const std::string& path, uint64_t key)
+{
+	if (!isProgramBinarySupported())
+		return false;
+
+	std::ifstream in(path, std::ios::binary);
+
+	if (!in)
+		return false;
+
+	ProgramBinaryHeader header;
+	in.read((char*)&header, sizeof(header));
+
+	if (!in || memcmp(header.magic, "STPB", 4) != 0 || header.version != PROGRAM_BINARY_VERSION || header.key != key)
+		return false;
+
+	std::vector<char> binary(header.length);
+	in.read(binary.data(), binary.size());
+
+	if (!in)
+		return false;
+
+	ID = glCreateProgram();
+	glProgramBinary(ID, header.format, binary.data(), (GLsizei)binary.size());
+
+	// a driver update can refuse it, then it is compiled like the first time:
+	int success;
+	glGetProgramiv(ID, GL_LINK_STATUS, &success);
+
+	if (!success) {
+		glDeleteProgram(ID);
+		ID = 0;
+		return false;
+	}
+
+	return true;
+}
+
+void Shader::saveProgramBinary(const std::string& path, uint64_t key) const
+{
+	if (!isProgramBinarySupported())
+		return;
+
+	int length = 0;
+	glGetProgramiv(ID, GL_PROGRAM_BINARY_LENGTH, &length);
+
+	if (length <= 0)
+		return;
+
+	std::vector<char> binary(length);
+	GLenum format;
+	glGetProgramBinary(ID, length, &length, &format, binary.data());
+
+	ProgramBinaryHeader header;
+	memcpy(header.magic, "STPB", 4);
+	header.version = PROGRAM_BINARY_VERSION;
+	header.format = format;
+	header.length = (uint32_t)length;
+	header.key = key;
+
+#ifdef _WIN32
+	_mkdir("res/cache");
+	_mkdir(SHADER_CACHE_DIRECTORY);
+#else
+	mkdir("res/cache", 0755);
+	mkdir(SHADER_CACHE_DIRECTORY, 0755);
+#endif
+
+	std::string temporaryPath = path + ".tmp";
+
+	{
+		std::ofstream out(temporaryPath, std::ios::binary);
+		out.write((const char*)&header, sizeof(header));
+		out.write(binary.data(), length);
+
+		if (!out) {
+			std::cout << "ERROR::SHADER::FAILED_TO_WRITE_PROGRAM_BINARY: " << path << "\n";
+			return;
+		}
+	}
+
+	std::remove(path.c_str());
+
+	if (std::rename(temporaryPath.c_str(), path.c_str()) != 0) {
+		std::cout << "ERROR::SHADER::FAILED_TO_WRITE_PROGRAM_BINARY: " << path << "\n";
+		std::remove(temporaryPath.c_str());
+	}
 }
 
 void Shader::use()
@@ -88,17 +362,97 @@ void Shader::use()
 	glUseProgram(ID);
 }
 
-void Shader::setBool(const std::string& name, bool value) const
+void Shader::cacheUniformLocations()
+{
+	int count = 0, maxLength = 0;
+	glGetProgramiv(ID, GL_ACTIVE_UNIFORMS, &count);
+	glGetProgramiv(ID, GL_ACTIVE_UNIFORM_MAX_LENGTH, &maxLength);
+
+	std::vector<char> name(std::max(maxLength, 1));
+	uniforms.clear();
+
+	for (int i = 0; i < count; i++) {
+
+		int size;
+		GLenum type;
+		glGetActiveUniform(ID, i, (GLsizei)name.size(), NULL, &size, &type, name.data());
+
+		// uniforms of a block have no location:
+		int location = glGetUniformLocation(ID, name.data());
+
+		if (location < 0)
+			continue;
+
+		// arrays are listed as "name[0]", the setters use the name:
+		std::string uniformName = name.data();
+		std::size_t bracket = uniformName.find('[');
+
+		if (bracket != std::string::npos)
+			uniformName.erase(bracket);
+
+		UniformLocation uniform;
+		uniform.hash = hashUniformName(uniformName.c_str());
+		uniform.location = location;
+		uniforms.push_back(uniform);
+	}
+
+	std::sort(uniforms.begin(), uniforms.end(), [](const UniformLocation& a, const UniformLocation& b) { return a.hash < b.hash; });
+
+	for (std::size_t i = 1; i < uniforms.size(); i++) {
+		if (uniforms[i].hash == uniforms[i - 1].hash)
+			std::cout << "ERROR::SHADER::UNIFORM_NAME_HASH_COLLISION\n";
+	}
+}
+
+void Shader::bindUniformBlocks()
+{
+	// a program without one of the blocks (or where the compiler dropped it) skips it:
+	unsigned int frameBlock = glGetUniformBlockIndex(ID, "Frame");
+	unsigned int bodiesBlock = glGetUniformBlockIndex(ID, "Bodies");
+
+	if (frameBlock != GL_INVALID_INDEX)
+		glUniformBlockBinding(ID, frameBlock, FRAME_UNIFORMS_BINDING);
+
+	if (bodiesBlock != GL_INVALID_INDEX)
+		glUniformBlockBinding(ID, bodiesBlock, BODY_UNIFORMS_BINDING);
+}
+
+int Shader::getUniformLocation(UniformName name) const
+{
+	auto found = std::lower_bound(uniforms.begin(), uniforms.end(), name.hash, [](const UniformLocation& uniform, uint32_t hash) { return uniform.hash < hash; });
+
+	if (found == uniforms.end() || found->hash != name.hash)
+		return -1;
+
+	return found->location;
+}
+
+void Shader::setBool(UniformName name, bool value) const
+{
+	glUniform1i(getUniformLocation(name), (int)value);
+}
+
+void Shader::setInt(UniformName name, int value) const
+{
+	glUniform1i(getUniformLocation(name), value);
+}
+
+void Shader::setFloat(UniformName name, float value) const
+{
+	glUniform1f(getUniformLocation(name), value);
+}
+
+void Shader::setVec2(UniformName name, const glm::vec2& value) const
 {
-	glUniform1i(glGetUniformLocation(ID, name.c_str()), (int)value);
+	glUniform2fv(getUniformLocation(name), 1, glm::value_ptr(value));
 }
 
-void Shader::setInt(const std::string& name, int value) const
+void Shader::setVec3(UniformName name, const glm::vec3& value) const
 {
-	glUniform1i(glGetUniformLocation(ID, name.c_str()), value);
+	glUniform3fv(getUniformLocation(name), 1, glm::value_ptr(value));
 }
 
-void Shader::setFloat(const std::string& name, float value) const
+void Shader::setMat4(UniformName name, const glm::mat4& value) const
 {
-	glUniform1f(glGetUniformLocation(ID, name.c_str()), value);
+	glUniformMatrix4fv(getUniformLocation(name), 1, GL_FALSE, glm::value_ptr(value));
 }
@@ -1,25 +1,143 @@
 #pragma once
 
 #include <GL/glew.h>
+#include <glm/glm.hpp>
+#include <cstdint>
 #include <string>
-#include <fstream>
-#include <sstream>
+#include <vector>
 #include <iostream>
 
+// FNV-1a of a uniform name, constexpr so the names the renderer uses are hashed by the compiler:
+constexpr uint32_t hashUniformName(const char* name) {
+
+	uint32_t hash = 2166136261u;
+
+	for (; *name; name++)
+		hash = (hash ^ (uint32_t)(unsigned char)*name) * 16777619u;
+
+	return hash;
+}
+
+// a uniform name & its hash, the setters look the location up by the hash:
+struct UniformName {
+
+	uint32_t hash;
+	const char* name;
+
+	constexpr UniformName(const char* name) : hash(hashUniformName(name)), name(name) {}
+	UniformName(const std::string& name) : hash(hashUniformName(name.c_str())), name(name.c_str()) {}
+};
+
+// the uniforms of the planet shaders, hashed at compile time:
+constexpr UniformName UNIFORM_TEXTURE("Texture");
+constexpr UniformName UNIFORM_TEXTURES("Textures");
+
+// the state of a Shader::beginReload():
+enum Shader_Reload {
+	SHADER_RELOAD_IDLE,		// no reload started
+	SHADER_RELOAD_PENDING,	// the driver still compiles it
+	SHADER_RELOAD_SWAPPED,	// linked, ID is the new program
+	SHADER_RELOAD_FAILED	// the errors are printed, ID is still the old program
+};
+
+// linked programs from glGetProgramBinary, one file per pair of sources & driver:
+const char* const SHADER_CACHE_DIRECTORY = "res/cache/shaders";
+
 class Shader {
 
 public:
 	// the program ID:
 	unsigned int ID;
 
-	// constructor:
-	Shader(const char* vertexPath, const char* fragmentPath);
+	// constructor, features: the Shader_Feature permutation key (see ShaderPreprocessor.h)
+	// loads the program from the binary cache when the sources & the driver match, or compiles it & stores the binary
+	// for the next start:
+	Shader(const char* vertexPath, const char* fragmentPath, unsigned int features = 0);
+
+	// off: every shader is compiled & nothing is stored (for the startup benchmark):
+	static void setBinaryCacheEnabled(bool enabled) { binaryCacheEnabled = enabled; }
+
+	// the driver can load & hand out program binaries (GL_ARB_get_program_binary with at least one format):
+	static bool isProgramBinarySupported();
+
+	bool isFromBinaryCache() const { return fromBinaryCache; }
+	double getLoadMs() const { return loadMs; } // reading, compiling or loading the binary & linking
+
+	const std::string& getVertexPath() const { return vertexPath; }
+	const std::string& getFragmentPath() const { return fragmentPath; }
+	unsigned int getFeatures() const { return features; }
+
+	// the two files & every file they include, from the last time they were read:
+	const std::vector<std::string>& getFiles() const { return files; }
+
+	// reads the files again (invalidate the changed ones in the ShaderPreprocessor first) & starts compiling them into
+	// a new program, pollReload() swaps it in once it linked (the frame doesn't wait for the compiler where
+	// GL_KHR_parallel_shader_compile is there), false if a file is missing or includes itself (the old program stays):
+	bool beginReload();
+	Shader_Reload pollReload();
+
+	// the driver compiles in the background & tells when it's done (GL_COMPLETION_STATUS_KHR):
+	static bool isParallelCompileSupported();
 
 	// use / activate the shader:
 	void use();
-	//utility unfirm functions:
-	void setBool(const std::string& name, bool value) const;
-	void setInt(const std::string& name, int value) const;
-	void setFloat(const std::string& name, float value) const;
 
+	// location of an active uniform from the cache filled at link time, -1 if the program has none with that name
+	// (glUniform* ignores -1 like an inactive uniform):
+	int getUniformLocation(UniformName name) const;
+
+	// # of active uniforms in the cache:
+	unsigned int getUniformCount() const { return (unsigned int)uniforms.size(); }
+
+	//utility unfirm functions, the program has to be in use:
+	void setBool(UniformName name, bool value) const;
+	void setInt(UniformName name, int value) const;
+	void setFloat(UniformName name, float value) const;
+	void setVec2(UniformName name, const glm::vec2& value) const;
+	void setVec3(UniformName name, const glm::vec3& value) const;
+	void setMat4(UniformName name, const glm::mat4& value) const;
+
+private:
+
+	struct UniformLocation {
+		uint32_t hash;
+		int location;
+	};
+
+	// a program whose shaders may still be compiling:
+	struct PendingProgram {
+		unsigned int program;	// 0: none
+		unsigned int vertex;
+		unsigned int fragment;
+	};
+
+	std::string vertexPath;
+	std::string fragmentPath;
+	unsigned int features;
+	std::vector<std::string> files;
+
+	std::vector<UniformLocation> uniforms;	// sorted by hash
+
+	bool fromBinaryCache;
+	double loadMs;
+
+	static bool binaryCacheEnabled;
+
+	PendingProgram reload;
+	uint64_t reloadKey;	// of the sources of the reload, for the binary cache
+
+	bool readSources(std::string& vertexCode, std::string& fragmentCode);
+	static void startProgram(const std::string& vertexCode, const std::string& fragmentCode, PendingProgram& pending);
+	static bool finishProgram(PendingProgram& pending);	// prints the errors, the program stays
+	bool compileProgram(const std::string& vertexCode, const std::string& fragmentCode);
+
+	static uint64_t getProgramBinaryKey(const std::string& vertexCode, const std::string& fragmentCode);
+	static std::string getProgramBinaryPath(uint64_t key);
+	bool loadProgramBinary(const std::string& path, uint64_t key);
+	void saveProgramBinary(const std::string& path, uint64_t key) const;
+
+	// asks the linked program for its active uniforms:
+	void cacheUniformLocations();
+	// points the Frame & Bodies blocks at their bindings (UniformBuffers.h):
+	void bindUniformBlocks();
 };
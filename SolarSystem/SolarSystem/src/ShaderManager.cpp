@@ -0,0 +1,236 @@
+#include "ShaderManager.h"
+#include "ShaderPreprocessor.h"
+
+#include <algorithm>
+#include <iostream>
+#include <chrono>
+#include <map>
+#include <sys/types.h>
+#include <sys/stat.h>
+
+#ifdef __linux__
+#include <sys/inotify.h>
+#include <poll.h>
+#include <unistd.h>
+#endif
+
+
+// how often the watcher looks at the modification times (or checks it has to stop):
+const int SHADER_WATCH_INTERVAL_MS = 250;
+
+ShaderManager::ShaderManager() : reloadCount(0), failedCount(0), watching(false) {
+}
+
+ShaderManager::~ShaderManager() {
+	stop();
+}
+
+void ShaderManager::add(Shader& shader) {
+
+	WatchedShader watched;
+	watched.shader = &shader;
+	watched.pending = false;
+	shaders.push_back(watched);
+
+	addPaths(shader);
+}
+
+void ShaderManager::addPaths(const Shader& shader) {
+
+	std::lock_guard<std::mutex> lock(pathsMutex);
+
+	for (const std::string& path : shader.getFiles()) {
+		if (std::find(paths.begin(), paths.end(), path) == paths.end())
+			paths.push_back(path);
+	}
+}
+
+bool ShaderManager::isWatched(const std::string& path) {
+	std::lock_guard<std::mutex> lock(pathsMutex);
+	return std::find(paths.begin(), paths.end(), path) != paths.end();
+}
+
+void ShaderManager::start() {
+
+	if (watching)
+		return;
+
+	// the driver may use all its threads for the reloads:
+	if (GLEW_KHR_parallel_shader_compile)
+		glMaxShaderCompilerThreadsKHR(0xFFFFFFFF);
+
+	watching = true;
+	watcher = std::thread(&ShaderManager::watch, this);
+}
+
+void ShaderManager::stop() {
+
+	watching = false;
+
+	if (watcher.joinable())
+		watcher.join();
+}
+
+void ShaderManager::notifyChanged(const std::string& path) {
+	std::lock_guard<std::mutex> lock(changedMutex);
+	changed.insert(path);
+}
+
+void ShaderManager::watch() {
+
+#ifdef __linux__
+	// inotify wakes the thread when a file in one of the directories is written or replaced:
+	int fd = inotify_init1(IN_NONBLOCK | IN_CLOEXEC);
+
+	if (fd >= 0) {
+
+		std::map<int, std::string> directories; // watch -> directory
+		std::size_t watchedPaths = 0;
+
+		alignas(inotify_event) char buffer[4096];
+
+		while (watching) {
+
+			// the directories of the files added since the last look (inotify_add_watch returns the same watch
+			// for a directory it has):
+			{
+				std::lock_guard<std::mutex> lock(pathsMutex);
+
+				for (; watchedPaths < paths.size(); watchedPaths++) {
+
+					const std::string& path = paths[watchedPaths];
+
+					std::size_t slash = path.find_last_of('/');
+					std::string directory = slash == std::string::npos ? "." : path.substr(0, slash);
+
+					int wd = inotify_add_watch(fd, directory.c_str(), IN_CLOSE_WRITE | IN_MOVED_TO | IN_CREATE);
+
+					if (wd >= 0)
+						directories[wd] = directory;
+				}
+			}
+
+			pollfd request = { fd, POLLIN, 0 };
+
+			if (poll(&request, 1, SHADER_WATCH_INTERVAL_MS) <= 0)
+				continue;
+
+			ssize_t length = read(fd, buffer, sizeof(buffer));
+
+			for (ssize_t offset = 0; offset < length; ) {
+
+				const inotify_event* event = (const inotify_event*)(buffer + offset);
+				offset += sizeof(inotify_event) + event->len;
+
+				auto directory = directories.find(event->wd);
+
+				if (event->len == 0 || directory == directories.end())
+					continue;
+
+				std::string path = directory->second == "." ? std::string(event->name) : directory->second + "/" + event->name;
+
+				if (isWatched(path))
+					notifyChanged(path);
+			}
+		}
+
+		close(fd);
+		return;
+	}
+#endif
+
+	// everywhere else (or without inotify) the modification times are compared:
+	std::map<std::string, std::pair<long long, long long> > stamps;
+
+	while (watching) {
+
+		std::vector<std::string> files;
+
+		{
+			std::lock_guard<std::mutex> lock(pathsMutex);
+			files = paths;
+		}
+
+		for (const std::string& path : files) {
+
+			struct stat status;
+
+			if (stat(path.c_str(), &status) != 0)
+				continue;
+
+			std::pair<long long, long long> stamp((long long)status.st_mtime, (long long)status.st_size);
+
+			// the first look at a file only remembers it:
+			auto found = stamps.find(path);
+
+			if (found != stamps.end() && found->second != stamp)
+				notifyChanged(path);
+
+			stamps[path] = stamp;
+		}
+
+		std::this_thread::sleep_for(std::chrono::milliseconds(SHADER_WATCH_INTERVAL_MS));
+	}
+}
+
+void ShaderManager::update() {
+
+	std::set<std::string> files;
+
+	{
+		std::lock_guard<std::mutex> lock(changedMutex);
+		files.swap(changed);
+	}
+
+	// the expanded sources with the changed files are read again:
+	for (const std::string& path : files)
+		ShaderPreprocessor::getShared().invalidate(path);
+
+	for (WatchedShader& watched : shaders) {
+
+		Shader& shader = *watched.shader;
+
+		bool changedFile = false;
+
+		for (const std::string& path : shader.getFiles())
+			changedFile = changedFile || files.count(path) > 0;
+
+		Shader_Reload status;
+
+		// a change while it compiles starts over with the newer sources, sources that can't be read fail right away:
+		if (changedFile && !shader.beginReload()) {
+			status = SHADER_RELOAD_FAILED;
+		}
+		else {
+
+			if (changedFile)
+				watched.pending = true;
+
+			if (!watched.pending)
+				continue;
+
+			status = shader.pollReload();
+
+			if (status == SHADER_RELOAD_PENDING)
+				continue;
+		}
+
+		watched.pending = false;
+
+		// the edit may include other files now:
+		addPaths(shader);
+
+		if (status == SHADER_RELOAD_SWAPPED) {
+			reloadCount++;
+			std::cout << "SHADER RELOADED: " << shader.getVertexPath() << " + " << shader.getFragmentPath() << "\n";
+		}
+		else if (status == SHADER_RELOAD_FAILED) {
+			failedCount++;
+			std::cout << "FAILED TO RELOAD SHADER, KEEPING THE OLD PROGRAM: " << shader.getVertexPath() << " + " << shader.getFragmentPath() << "\n";
+		}
+	}
+}
+
+unsigned int ShaderManager::getPendingCount() const {
+	return (unsigned int)std::count_if(shaders.begin(), shaders.end(), [](const WatchedShader& watched) { return watched.pending; });
+}
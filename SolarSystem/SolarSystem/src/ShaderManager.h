@@ -0,0 +1,68 @@
+#pragma once
+
+#include "Shader.h"
+
+#include <string>
+#include <vector>
+#include <set>
+#include <thread>
+#include <mutex>
+#include <atomic>
+
+
+// reloads the shaders whose files (or the files they include) change while the app runs: a background thread watches
+// the directories of the files (inotify on Linux, the modification times elsewhere), update() starts the reloads &
+// swaps the programs in once they linked, a shader that fails to compile keeps its old program
+// the shaders have to outlive every update() call (the destructor doesn't touch them), needs a current OpenGL context
+// (except for the watcher)
+class ShaderManager {
+
+public:
+
+	ShaderManager();
+	~ShaderManager();
+
+	ShaderManager(const ShaderManager&) = delete;
+	ShaderManager& operator=(const ShaderManager&) = delete;
+
+	// also after start(), the variants come in when the renderer first needs them:
+	void add(Shader& shader);
+
+	// starts watching the files of the shaders:
+	void start();
+	void stop();
+
+	// reloads the shaders with changed files, once per frame (never waits for the compiler where the driver
+	// compiles in the background):
+	void update();
+
+	unsigned int getShaderCount() const { return (unsigned int)shaders.size(); }
+	unsigned int getPendingCount() const;
+	unsigned int getReloadCount() const { return reloadCount; }
+	unsigned int getFailedCount() const { return failedCount; }
+
+private:
+
+	struct WatchedShader {
+		Shader* shader;
+		bool pending;	// beginReload() was called, pollReload() hasn't finished
+	};
+
+	std::vector<WatchedShader> shaders;
+
+	unsigned int reloadCount;
+	unsigned int failedCount;
+
+	// shared with the watcher:
+	std::thread watcher;
+	std::atomic<bool> watching;
+	std::mutex pathsMutex;
+	std::vector<std::string> paths;	// every file of the shaders
+	std::mutex changedMutex;
+	std::set<std::string> changed;
+
+	void watch();
+	void addPaths(const Shader& shader);
+	bool isWatched(const std::string& path);
+	void notifyChanged(const std::string& path);
+};
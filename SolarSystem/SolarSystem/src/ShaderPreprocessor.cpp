@@ -0,0 +1,157 @@
+#include "ShaderPreprocessor.h"
+
+#include <algorithm>
+#include <fstream>
+#include <sstream>
+#include <iostream>
+
+
+std::vector<std::string> getShaderFeatureDefines(unsigned int features) {
+
+	static const char* const names[] = { "TEXTURE_ARRAY", "VIRTUAL_TEXTURE", "INSTANCED" };
+
+	std::vector<std::string> defines;
+
+	for (unsigned int bit = 0; bit < sizeof(names) / sizeof(names[0]); bit++) {
+		if (features & (1u << bit))
+			defines.push_back(names[bit]);
+	}
+
+	return defines;
+}
+
+ShaderPreprocessor& ShaderPreprocessor::getShared() {
+	static ShaderPreprocessor preprocessor;
+	return preprocessor;
+}
+
+const std::string* ShaderPreprocessor::readFile(const std::string& path) {
+
+	auto found = files.find(path);
+
+	if (found != files.end())
+		return &found->second;
+
+	std::ifstream file(path, std::ios::binary);
+
+	if (!file) {
+		std::cout << "ERROR::SHADER::FILE_NOT_SUCCESSFULLY_READ: " << path << "\n";
+		return NULL;
+	}
+
+	std::stringstream text;
+	text << file.rdbuf();
+
+	return &(files[path] = text.str());
+}
+
+bool ShaderPreprocessor::expand(const std::string& path, ShaderSource& source, std::vector<std::string>& stack) {
+
+	if (std::find(stack.begin(), stack.end(), path) != stack.end()) {
+		std::cout << "ERROR::SHADER::INCLUDE_CYCLE: " << path << "\n";
+		return false;
+	}
+
+	// every file once, like #pragma once:
+	if (std::find(source.files.begin(), source.files.end(), path) != source.files.end())
+		return true;
+
+	const std::string* text = readFile(path);
+
+	if (!text)
+		return false;
+
+	int index = (int)source.files.size();
+	source.files.push_back(path);
+	stack.push_back(path);
+
+	if (index > 0)
+		source.text += "#line 1 " + std::to_string(index) + "\n";
+
+	std::size_t slash = path.find_last_of('/');
+	std::string directory = slash == std::string::npos ? "" : path.substr(0, slash + 1);
+
+	std::istringstream lines(*text);
+	std::string line;
+
+	for (int number = 1; std::getline(lines, line); number++) {
+
+		if (!line.empty() && line.back() == '\r')
+			line.pop_back();
+
+		std::size_t first = line.find_first_not_of(" \t");
+
+		if (first == std::string::npos || line.compare(first, 8, "#include") != 0) {
+			source.text += line;
+			source.text += '\n';
+			continue;
+		}
+
+		std::size_t open = line.find('"', first);
+		std::size_t close = open == std::string::npos ? std::string::npos : line.find('"', open + 1);
+
+		if (close == std::string::npos) {
+			std::cout << "ERROR::SHADER::BAD_INCLUDE: " << path << "(" << number << ")\n";
+			stack.pop_back();
+			return false;
+		}
+
+		if (!expand(directory + line.substr(open + 1, close - open - 1), source, stack)) {
+			stack.pop_back();
+			return false;
+		}
+
+		// back in this file, after the #include:
+		source.text += "#line " + std::to_string(number + 1) + " " + std::to_string(index) + "\n";
+	}
+
+	stack.pop_back();
+
+	return true;
+}
+
+const ShaderSource* ShaderPreprocessor::get(const std::string& path, unsigned int features) {
+
+	std::pair<std::string, unsigned int> key(path, features);
+	auto found = sources.find(key);
+
+	if (found != sources.end())
+		return &found->second;
+
+	ShaderSource source;
+	std::vector<std::string> stack;
+
+	if (!expand(path, source, stack))
+		return NULL;
+
+	// the defines go after #version, it has to be the first line:
+	std::string defines;
+
+	for (const std::string& define : getShaderFeatureDefines(features))
+		defines += "#define " + define + "\n";
+
+	if (source.text.compare(0, 8, "#version") == 0) {
+		std::size_t end = source.text.find('\n') + 1;
+		source.text.insert(end, defines + "#line 2 0\n");
+	}
+	else {
+		source.text.insert(0, defines + "#line 1 0\n");
+	}
+
+	return &(sources[key] = std::move(source));
+}
+
+void ShaderPreprocessor::invalidate(const std::string& path) {
+
+	files.erase(path);
+
+	for (auto source = sources.begin(); source != sources.end(); ) {
+
+		const std::vector<std::string>& sourceFiles = source->second.files;
+
+		if (std::find(sourceFiles.begin(), sourceFiles.end(), path) != sourceFiles.end())
+			source = sources.erase(source);
+		else
+			++source;
+	}
+}
@@ -0,0 +1,51 @@
+#pragma once
+
+#include <string>
+#include <vector>
+#include <map>
+
+
+// the feature toggles of the planet shaders, a permutation key is any combination of them: every key is its own
+// program with the #defines below, so the fragment shaders pick their path at compile time instead of branching
+enum Shader_Feature {
+	SHADER_FEATURE_TEXTURE_ARRAY = 1 << 0,		// TEXTURE_ARRAY: the texture comes from a layer of a texture array
+	SHADER_FEATURE_VIRTUAL_TEXTURE = 1 << 1,	// VIRTUAL_TEXTURE: the texture is a virtual texture
+	SHADER_FEATURE_INSTANCED = 1 << 2			// INSTANCED: the model matrix & the layer are per instance attributes (BodyInstances)
+};
+
+// the #define names of the features in the key, in the order of the bits:
+std::vector<std::string> getShaderFeatureDefines(unsigned int features);
+
+// a shader file with its includes expanded & the defines of its key after the #version line
+struct ShaderSource {
+	std::string text;
+	std::vector<std::string> files;	// the file & every file it includes, for the hot reload
+};
+
+// expands #include "file" (relative to the including file, every file once, also in #if blocks the defines switch
+// off) and injects the #defines of a permutation key, #line directives keep the compiler errors pointing at the right
+// line (the second number is the index in ShaderSource::files)
+// the expanded sources & the files they come from are cached until invalidate(), render thread only
+class ShaderPreprocessor {
+
+public:
+
+	// the source for the permutation key, NULL if a file is missing or includes itself:
+	const ShaderSource* get(const std::string& path, unsigned int features);
+
+	// the file changed, drops it & every source that includes it:
+	void invalidate(const std::string& path);
+
+	unsigned int getSourceCount() const { return (unsigned int)sources.size(); }
+
+	// the one the Shaders use:
+	static ShaderPreprocessor& getShared();
+
+private:
+
+	std::map<std::pair<std::string, unsigned int>, ShaderSource> sources;	// (path, features) -> source
+	std::map<std::string, std::string> files;	// path -> text
+
+	const std::string* readFile(const std::string& path);
+	bool expand(const std::string& path, ShaderSource& source, std::vector<std::string>& stack);
+};
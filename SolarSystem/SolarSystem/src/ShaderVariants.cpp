@@ -0,0 +1,24 @@
+#include "ShaderVariants.h"
+
+
+ShaderVariants::ShaderVariants(const std::string& vertexPath, const std::string& fragmentPath, ShaderManager* manager)
+	: vertexPath(vertexPath), fragmentPath(fragmentPath), manager(manager) {
+}
+
+Shader& ShaderVariants::get(unsigned int features) {
+
+	auto found = variants.find(features);
+
+	if (found != variants.end())
+		return *found->second;
+
+	std::unique_ptr<Shader> shader(new Shader(vertexPath.c_str(), fragmentPath.c_str(), features));
+	Shader& variant = *shader;
+
+	variants[features] = std::move(shader);
+
+	if (manager)
+		manager->add(variant);
+
+	return variant;
+}
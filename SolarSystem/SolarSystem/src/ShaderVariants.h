@@ -0,0 +1,36 @@
+#pragma once
+
+#include "Shader.h"
+#include "ShaderManager.h"
+#include "ShaderPreprocessor.h"
+
+#include <map>
+#include <memory>
+#include <string>
+
+
+// the permutations of one vertex & fragment shader pair, each Shader_Feature key is compiled the first time it's
+// asked for (or loaded from the binary cache) & handed out from then on, the references stay valid
+class ShaderVariants {
+
+public:
+
+	// the new variants are added to the manager for the hot reload, if there is one:
+	ShaderVariants(const std::string& vertexPath, const std::string& fragmentPath, ShaderManager* manager = NULL);
+
+	ShaderVariants(const ShaderVariants&) = delete;
+	ShaderVariants& operator=(const ShaderVariants&) = delete;
+
+	// needs a current OpenGL context the first time for each key:
+	Shader& get(unsigned int features);
+
+	unsigned int getVariantCount() const { return (unsigned int)variants.size(); }
+
+private:
+
+	std::string vertexPath;
+	std::string fragmentPath;
+	ShaderManager* manager;
+
+	std::map<unsigned int, std::unique_ptr<Shader>> variants;
+};
@@ -1,7 +1,20 @@
 #include "Sphere.h"
+#include "ThreadPool.h"
+#include "MeshOptimizer.h"
+#include "Texture.h"
+#include "TextureMipmaps.h"
 
-#define STB_IMAGE_IMPLEMENTATION
-#include "stb_image.h"
+#if defined(_M_X64) || defined(__x86_64__) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2) || defined(__SSE2__)
+#define SPHERE_SSE
+#include <immintrin.h>
+#endif
+
+#if defined(_MSC_VER)
+#include <intrin.h>
+#define SPHERE_TARGET_AVX
+#else
+#define SPHERE_TARGET_AVX __attribute__((target("avx")))
+#endif
 
 
 const int MIN_SECTOR_COUNT = 3;
@@ -9,6 +22,11 @@ const int MIN_STACK_COUNT = 2;
 const float MIN_SPHERE_RADIUS = 4;
 
 Sphere::Sphere(float radius, int sectorCount, int stackCount){
+	this->buildAllocations = 0;
+	this->kernel = KERNEL_AUTO;
+	this->threadCount = 1;
+	this->tessellation = TESSELLATION_UV;
+	this->subdivisions = 0;
 	setProperties(radius, sectorCount, stackCount);
 	this->interleavedStride = 32;
 }
@@ -17,13 +35,47 @@ Sphere::Sphere(float radius, int sectorCount, int stackCount){
 void Sphere::printInfo(){
 	std::cout << "===== Sphere =====\n"
 		<< "        Radius: " << radius << "\n"
+		<< "  Tessellation: " << (tessellation == TESSELLATION_ICOSPHERE ? "icosphere" : tessellation == TESSELLATION_CUBE ? "cube" : "uv") << "\n"
+		<< "  Subdivisions: " << subdivisions << "\n"
 		<< "  Sector Count: " << sectorCount << "\n"
 		<< "   Stack Count: " << stackCount << "\n"
 		<< "Triangle Count: " << getTriangleCount() << "\n"
 		<< "   Index Count: " << getIndexCount() << "\n"
 		<< "  Vertex Count: " << getVertexCount() << "\n"
 		<< "  Normal Count: " << getNormalCount() << "\n"
-		<< "TexCoord Count: " << getTexCoordCount() << std::endl;
+		<< "TexCoord Count: " << getTexCoordCount() << "\n";
+
+	// post-transform cache of the triangle list, for checking optimizeVertexCache() without a gpu:
+	VertexCacheStats fifo16 = analyzeVertexCache(indices.data(), indices.size(), getVertexCount(), 16);
+	VertexCacheStats fifo32 = analyzeVertexCache(indices.data(), indices.size(), getVertexCount(), 32);
+
+	std::cout << "     Optimized: " << (isVertexCacheOptimized() ? "yes" : "no") << "\n"
+		<< " ACMR (FIFO16): " << fifo16.acmr << "\n"
+		<< " ATVR (FIFO16): " << fifo16.atvr << "\n"
+		<< " ACMR (FIFO32): " << fifo32.acmr << "\n"
+		<< " ATVR (FIFO32): " << fifo32.atvr << std::endl;
+}
+
+void Sphere::optimizeVertexCache() {
+
+	::optimizeVertexCache(indices.data(), indices.size(), getVertexCount());
+
+	std::vector<unsigned int> remap;
+	optimizeVertexFetch(interleavedVertices.data(), getVertexCount(), 8, indices.data(), indices.size(), remap);
+
+	for (unsigned int& index : lineIndices) {
+		index = remap[index];
+	}
+
+	// the strips are built from the grid positions, they need the remap too (optimizing twice chains it):
+	if (vertexRemap.empty()) {
+		vertexRemap.swap(remap);
+	}
+	else {
+		for (unsigned int& vertex : vertexRemap) {
+			vertex = remap[vertex];
+		}
+	}
 }
 
 // setters:
@@ -56,92 +108,268 @@ void Sphere::setStackCount(int stackCount){
 }
 
 
-// builders:
+// vertex kernels:
+// every kernel writes the vertices [begin, end) of one stack and does exactly the same
+// float operations in the same order, so they all produce bit-identical vertices
 
+static void buildVertexRowScalar(float* vertex, const float* sectorCos, const float* sectorSin,
+								 int begin, int end, int sectorCount, float xz, float y, float t, float lengthInv) {
 
-void Sphere::buildInterleavedVertices(){
+	float x, z;
 
-	std::vector<float>().swap(interleavedVertices);
+	for (int j = begin; j < end; j++) {
 
-	std::size_t i, j;
-	std::size_t count = vertices.size();
+		x = -xz * sectorCos[j]; // r * cos(phi) * cos(theta)
+		z = xz * sectorSin[j]; // r * cos(phi) * sin(theta)
 
-	for (i = 0, j = 0; i < count; i += 3, j += 2) {
+		float* v = vertex + (std::size_t)j * 8;
 
 		// vertex positions:
-		this->interleavedVertices.push_back(vertices[i]);
-		this->interleavedVertices.push_back(vertices[i + 1]);
-		this->interleavedVertices.push_back(vertices[i + 2]);
+		v[0] = x;
+		v[1] = y;
+		v[2] = z;
+
+		// normalized normals:
+		v[3] = x * lengthInv;
+		v[4] = y * lengthInv;
+		v[5] = z * lengthInv;
+
+		// vertex texture coordintes:
+		v[6] = (float)j / sectorCount;
+		v[7] = t;
+	}
+}
 
-		// normals:
-		this->interleavedVertices.push_back(normals[i]);
-		this->interleavedVertices.push_back(normals[i + 1]);
-		this->interleavedVertices.push_back(normals[i + 2]);
+#ifdef SPHERE_SSE
+
+static void buildVertexRowSSE(float* vertex, const float* sectorCos, const float* sectorSin,
+							  int begin, int end, int sectorCount, float xz, float y, float t, float lengthInv) {
+
+	const __m128 negXz4 = _mm_set1_ps(-xz);
+	const __m128 xz4 = _mm_set1_ps(xz);
+	const __m128 lengthInv4 = _mm_set1_ps(lengthInv);
+	const __m128 sectors4 = _mm_set1_ps((float)sectorCount);
+	const __m128 y4 = _mm_set1_ps(y);
+	const __m128 ny4 = _mm_set1_ps(y * lengthInv);
+	const __m128 t4 = _mm_set1_ps(t);
+
+	int j = begin;
+
+	for (; j + 4 <= end; j += 4) {
+
+		__m128 x = _mm_mul_ps(negXz4, _mm_loadu_ps(sectorCos + j));
+		__m128 yy = y4;
+		__m128 z = _mm_mul_ps(xz4, _mm_loadu_ps(sectorSin + j));
+		__m128 nx = _mm_mul_ps(x, lengthInv4);
+		__m128 ny = ny4;
+		__m128 nz = _mm_mul_ps(z, lengthInv4);
+		__m128 s = _mm_div_ps(_mm_cvtepi32_ps(_mm_setr_epi32(j, j + 1, j + 2, j + 3)), sectors4);
+		__m128 tt = t4;
+
+		// 8 arrays of 4 -> 4 interleaved vertices:
+		_MM_TRANSPOSE4_PS(x, yy, z, nx);
+		_MM_TRANSPOSE4_PS(ny, nz, s, tt);
+
+		float* v = vertex + (std::size_t)j * 8;
+		_mm_storeu_ps(v, x);		_mm_storeu_ps(v + 4, ny);
+		_mm_storeu_ps(v + 8, yy);	_mm_storeu_ps(v + 12, nz);
+		_mm_storeu_ps(v + 16, z);	_mm_storeu_ps(v + 20, s);
+		_mm_storeu_ps(v + 24, nx);	_mm_storeu_ps(v + 28, tt);
+	}
 
-		// texCoords:
-		this->interleavedVertices.push_back(texCoords[j]);
-		this->interleavedVertices.push_back(texCoords[j + 1]);
+	buildVertexRowScalar(vertex, sectorCos, sectorSin, j, end, sectorCount, xz, y, t, lengthInv);
+}
+
+SPHERE_TARGET_AVX
+static void buildVertexRowAVX(float* vertex, const float* sectorCos, const float* sectorSin,
+							  int begin, int end, int sectorCount, float xz, float y, float t, float lengthInv) {
+
+	const __m256 negXz8 = _mm256_set1_ps(-xz);
+	const __m256 xz8 = _mm256_set1_ps(xz);
+	const __m256 lengthInv8 = _mm256_set1_ps(lengthInv);
+	const __m256 sectors8 = _mm256_set1_ps((float)sectorCount);
+	const __m256 y8 = _mm256_set1_ps(y);
+	const __m256 ny8 = _mm256_set1_ps(y * lengthInv);
+	const __m256 t8 = _mm256_set1_ps(t);
+	const __m256 offsets8 = _mm256_setr_ps(0, 1, 2, 3, 4, 5, 6, 7);
+
+	int j = begin;
+
+	for (; j + 8 <= end; j += 8) {
+
+		__m256 x = _mm256_mul_ps(negXz8, _mm256_loadu_ps(sectorCos + j));
+		__m256 z = _mm256_mul_ps(xz8, _mm256_loadu_ps(sectorSin + j));
+		__m256 nx = _mm256_mul_ps(x, lengthInv8);
+		__m256 nz = _mm256_mul_ps(z, lengthInv8);
+		__m256 s = _mm256_div_ps(_mm256_add_ps(_mm256_set1_ps((float)j), offsets8), sectors8);
+
+		// 8 arrays of 8 -> 8 interleaved vertices:
+		__m256 t0 = _mm256_unpacklo_ps(x, y8);
+		__m256 t1 = _mm256_unpackhi_ps(x, y8);
+		__m256 t2 = _mm256_unpacklo_ps(z, nx);
+		__m256 t3 = _mm256_unpackhi_ps(z, nx);
+		__m256 t4 = _mm256_unpacklo_ps(ny8, nz);
+		__m256 t5 = _mm256_unpackhi_ps(ny8, nz);
+		__m256 t6 = _mm256_unpacklo_ps(s, t8);
+		__m256 t7 = _mm256_unpackhi_ps(s, t8);
+
+		__m256 u0 = _mm256_shuffle_ps(t0, t2, 0x44);
+		__m256 u1 = _mm256_shuffle_ps(t0, t2, 0xEE);
+		__m256 u2 = _mm256_shuffle_ps(t1, t3, 0x44);
+		__m256 u3 = _mm256_shuffle_ps(t1, t3, 0xEE);
+		__m256 u4 = _mm256_shuffle_ps(t4, t6, 0x44);
+		__m256 u5 = _mm256_shuffle_ps(t4, t6, 0xEE);
+		__m256 u6 = _mm256_shuffle_ps(t5, t7, 0x44);
+		__m256 u7 = _mm256_shuffle_ps(t5, t7, 0xEE);
+
+		float* v = vertex + (std::size_t)j * 8;
+		_mm256_storeu_ps(v, _mm256_permute2f128_ps(u0, u4, 0x20));
+		_mm256_storeu_ps(v + 8, _mm256_permute2f128_ps(u1, u5, 0x20));
+		_mm256_storeu_ps(v + 16, _mm256_permute2f128_ps(u2, u6, 0x20));
+		_mm256_storeu_ps(v + 24, _mm256_permute2f128_ps(u3, u7, 0x20));
+		_mm256_storeu_ps(v + 32, _mm256_permute2f128_ps(u0, u4, 0x31));
+		_mm256_storeu_ps(v + 40, _mm256_permute2f128_ps(u1, u5, 0x31));
+		_mm256_storeu_ps(v + 48, _mm256_permute2f128_ps(u2, u6, 0x31));
+		_mm256_storeu_ps(v + 56, _mm256_permute2f128_ps(u3, u7, 0x31));
 	}
 
+	buildVertexRowScalar(vertex, sectorCos, sectorSin, j, end, sectorCount, xz, y, t, lengthInv);
+}
+
+static bool cpuSupportsAVX() {
+#if defined(_MSC_VER)
+	int info[4];
+	__cpuid(info, 1);
+	bool osxsave = (info[2] & (1 << 27)) != 0;
+	bool avx = (info[2] & (1 << 28)) != 0;
+	// the os has to save the ymm registers too:
+	return osxsave && avx && (_xgetbv(0) & 6) == 6;
+#else
+	return __builtin_cpu_supports("avx");
+#endif
+}
+
+#endif
+
+Sphere_Kernel Sphere::getBestKernel() {
+#ifdef SPHERE_SSE
+	static const Sphere_Kernel best = cpuSupportsAVX() ? KERNEL_AVX : KERNEL_SSE;
+	return best;
+#else
+	return KERNEL_SCALAR;
+#endif
+}
+
 
+// builders:
+
+
+std::size_t Sphere::computeVertexCount() const {
+	return (std::size_t)(stackCount + 1) * (sectorCount + 1);
+}
+
+std::size_t Sphere::computeIndexCount() const {
+	// 2 triangles per sector in each stack, except the first and last one:
+	return (std::size_t)6 * sectorCount * (stackCount - 1);
+}
+
+std::size_t Sphere::computeLineIndexCount() const {
+	// a vertical line per sector in each stack + horizontal lines except 1st stack:
+	return (std::size_t)2 * sectorCount * stackCount + (std::size_t)2 * sectorCount * (stackCount - 1);
 }
 
 void Sphere::buildVerticesSmooth() {
 
-	const float PI = acos(-1);
+	// size the arrays exactly, the capacity of the previous build is reused
+	// (every element gets overwritten below, so there is no need to clear them first):
+	buildAllocations = 0;
 
-	// clear memory:
-	clearArrays();
+	// a new build is in grid order again:
+	vertexRemap.clear();
 
-	float x, y, z, xz;									 // vertex position
-	float nx, ny, nz, lenghtInv = 1.0f / (this->radius); // noraml
-	float s, t;											 // texCoords
+	if (tessellation != TESSELLATION_UV) {
+		buildVerticesGeodesic();
+		return;
+	}
 
-	float sectorStep = 2 * PI / sectorCount; // how much do we step in each layer arond the circle (x, y)
-	float stackStep = PI / stackCount; // how much do we stepc in each layer in half a circle (z)
-	float theta, phi;
+	std::size_t oldVertexCapacity = interleavedVertices.capacity();
+	std::size_t oldIndexCapacity = indices.capacity();
+	std::size_t oldLineIndexCapacity = lineIndices.capacity();
 
-	for (int i = 0; i <= stackCount; i++) {
+	interleavedVertices.resize(computeVertexCount() * 8);
+	indices.resize(computeIndexCount());
+	lineIndices.resize(computeLineIndexCount());
 
-		phi = PI / 2 - i * stackStep; // [pi / 2, - pi / 2]
-		xz = radius * cosf(phi);      // a sugar vetulete az x z koordinata rendszerre
-		y = -radius * sinf(phi);       // hol tartunk a felkorben 
+	if (interleavedVertices.capacity() != oldVertexCapacity) buildAllocations++;
+	if (indices.capacity() != oldIndexCapacity) buildAllocations++;
+	if (lineIndices.capacity() != oldLineIndexCapacity) buildAllocations++;
 
-		for (int j = 0; j <= sectorCount; j++) {
+	buildSectorRing();
 
-			theta = j * sectorStep;
+	// every stack writes its own slice of the arrays, so the stacks can be built on several threads:
+	unsigned int chunkCount = threadCount == 0 ? ThreadPool::getHardwareThreadCount() : threadCount;
 
-			x = -xz * cosf(theta); // r * cos(phi) * cos(theta)
-			z = xz * sinf(theta); // r * cos(phi) * sin(theta)
+	if (chunkCount > 1) {
+		ThreadPool::getShared().parallelFor(stackCount + 1, chunkCount, [this](int begin, int end) {
+			buildStacks(begin, end);
+		});
+	}
+	else {
+		buildStacks(0, stackCount + 1);
+	}
 
-			this->vertices.push_back(x);
-			this->vertices.push_back(y);
-			this->vertices.push_back(z);
+}
 
-			// normalized normals:
-			nx = x * lenghtInv;
-			ny = y * lenghtInv;
-			nz = z * lenghtInv;
+void Sphere::buildStacks(int firstStack, int lastStack) {
 
-			this->normals.push_back(nx);
-			this->normals.push_back(ny);
-			this->normals.push_back(nz);
+	const float PI = acos(-1);
+
+	float y, xz;									// vertex position
+	float lenghtInv = 1.0f / (this->radius);		// noraml
+	float t;										// texCoords
 
-			// vertex texture coordintes:
-			s = (float)j / sectorCount;
-			t = (float)i / stackCount;
+	float stackStep = PI / stackCount; // how much do we stepc in each layer in half a circle (z)
+	float phi;
 
-			texCoords.push_back(s);
-			texCoords.push_back(t);
+	Sphere_Kernel rowKernel = kernel == KERNEL_AUTO ? getBestKernel() : kernel;
 
+	for (int i = firstStack; i < lastStack; i++) {
+
+		phi = PI / 2 - i * stackStep; // [pi / 2, - pi / 2]
+		xz = radius * cosf(phi);      // a sugar vetulete az x z koordinata rendszerre
+		y = -radius * sinf(phi);       // hol tartunk a felkorben 
+
+		t = (float)i / stackCount;
+
+		float* row = interleavedVertices.data() + (std::size_t)i * (sectorCount + 1) * 8;
+
+		switch (rowKernel) {
+#ifdef SPHERE_SSE
+		case KERNEL_AVX:
+			buildVertexRowAVX(row, sectorCos.data(), sectorSin.data(), 0, sectorCount + 1, sectorCount, xz, y, t, lenghtInv);
+			break;
+		case KERNEL_SSE:
+			buildVertexRowSSE(row, sectorCos.data(), sectorSin.data(), 0, sectorCount + 1, sectorCount, xz, y, t, lenghtInv);
+			break;
+#endif
+		default:
+			buildVertexRowScalar(row, sectorCos.data(), sectorSin.data(), 0, sectorCount + 1, sectorCount, xz, y, t, lenghtInv);
+			break;
 		}
 
 	}
 
-	// indices:
+	// indices, there is one vertex stack more than index stacks:
 	unsigned int k1, k2;
 
-	for (int i = 0; i < stackCount; i++) {
+	for (int i = firstStack; i < lastStack && i < stackCount; i++) {
+
+		// the first and last stacks only have one triangle per sector:
+		std::size_t indexOffset = i == 0 ? 0 : (std::size_t)3 * sectorCount + (std::size_t)6 * sectorCount * (i - 1);
+		std::size_t lineIndexOffset = i == 0 ? 0 : (std::size_t)2 * sectorCount + (std::size_t)4 * sectorCount * (i - 1);
+
+		unsigned int* index = indices.data() + indexOffset;
+		unsigned int* lineIndex = lineIndices.data() + lineIndexOffset;
 
 		k1 = i * (sectorCount + 1);
 		k2 = k1 + sectorCount + 1;
@@ -149,34 +377,387 @@ void Sphere::buildVerticesSmooth() {
 		for (int j = 0; j < sectorCount; j++, k1++, k2++) {
 
 			if (i != 0) {
-				this->indices.push_back(k1);
-				this->indices.push_back(k2);
-				this->indices.push_back(k1 + 1);
+				*index++ = k1;
+				*index++ = k2;
+				*index++ = k1 + 1;
 			}
 
 			if (i != (stackCount - 1)) {
-				this->indices.push_back(k1 + 1);
-				this->indices.push_back(k2);
-				this->indices.push_back(k2 + 1);
+				*index++ = k1 + 1;
+				*index++ = k2;
+				*index++ = k2 + 1;
 			}
 
 			// vertical lines for all stacks:
-			lineIndices.push_back(k1);
-			lineIndices.push_back(k2);
+			*lineIndex++ = k1;
+			*lineIndex++ = k2;
 
 			if (i != 0) { // horizontal lines except 1st stack
-				lineIndices.push_back(k1);
-				lineIndices.push_back(k1 + 1);
+				*lineIndex++ = k1;
+				*lineIndex++ = k1 + 1;
 			}
 
 		}
 	}
 
-	// generate interleaved vertex array;
-	buildInterleavedVertices();
+}
+
+void Sphere::buildStripIndices(std::vector<unsigned int>& stripIndices) const {
+
+	if (tessellation != TESSELLATION_UV) {
+		stripIndices.clear();
+		return;
+	}
+
+	// 2 indices per sector boundary in every stack + a restart between the stacks:
+	stripIndices.resize((std::size_t)stackCount * (2 * (sectorCount + 1) + 1) - 1);
 
+	unsigned int k1, k2;
+	unsigned int* index = stripIndices.data();
+
+	for (int i = 0; i < stackCount; i++) {
+
+		if (i != 0) {
+			*index++ = PRIMITIVE_RESTART_INDEX;
+		}
+
+		k1 = i * (sectorCount + 1);
+		k2 = k1 + sectorCount + 1;
+
+		// k1, k2, k1 + 1 then k1 + 1, k2, k2 + 1, the same winding as the triangle list:
+		for (int j = 0; j <= sectorCount; j++, k1++, k2++) {
+			*index++ = vertexRemap.empty() ? k1 : vertexRemap[k1];
+			*index++ = vertexRemap.empty() ? k2 : vertexRemap[k2];
+		}
+	}
 }
 
+void Sphere::buildSectorRing() {
+
+	const float PI = acos(-1);
+
+	float sectorStep = 2 * PI / sectorCount; // how much do we step in each layer arond the circle (x, y)
+	float theta;
+
+	std::size_t oldCapacity = sectorCos.capacity();
+
+	sectorCos.resize(sectorCount + 1);
+	sectorSin.resize(sectorCount + 1);
+
+	if (sectorCos.capacity() != oldCapacity) buildAllocations += 2;
+
+	for (int j = 0; j <= sectorCount; j++) {
+		theta = j * sectorStep;
+		sectorCos[j] = cosf(theta);
+		sectorSin[j] = sinf(theta);
+	}
+}
+
+
+void Sphere::setTessellation(Sphere_Tessellation tessellation, int subdivisions) {
+
+	this->tessellation = tessellation;
+	this->subdivisions = subdivisions;
+
+	// at least the plain icosahedron / one quad per cube face:
+	if (tessellation == TESSELLATION_ICOSPHERE && subdivisions < 0) {
+		this->subdivisions = 0;
+	}
+
+	if (tessellation == TESSELLATION_CUBE && subdivisions < 1) {
+		this->subdivisions = 1;
+	}
+
+	buildVerticesSmooth();
+}
+
+void Sphere::buildVerticesGeodesic() {
+
+	std::vector<glm::vec3> points;
+	std::vector<unsigned int> triangles;
+
+	if (tessellation == TESSELLATION_ICOSPHERE) {
+		buildIcosahedron(points, triangles);
+	}
+	else {
+		buildCube(points, triangles);
+	}
+
+	buildFromUnitPoints(points, triangles);
+}
+
+void Sphere::buildIcosahedron(std::vector<glm::vec3>& points, std::vector<unsigned int>& triangles) const {
+
+	// 12 vertices, 2 of them on the poles (y axis) so the texture seam only cuts along the edges:
+	const float PI = acos(-1);
+	const float ringY = 1.0f / sqrtf(5.0f);
+	const float ringXz = 2.0f / sqrtf(5.0f);
+
+	points.clear();
+	points.push_back(glm::vec3(0.0f, 1.0f, 0.0f));
+
+	for (int j = 0; j < 5; j++) {
+		float theta = j * 2 * PI / 5;
+		points.push_back(glm::vec3(-ringXz * cosf(theta), ringY, ringXz * sinf(theta)));
+	}
+
+	for (int j = 0; j < 5; j++) {
+		float theta = (j + 0.5f) * 2 * PI / 5;
+		points.push_back(glm::vec3(-ringXz * cosf(theta), -ringY, ringXz * sinf(theta)));
+	}
+
+	points.push_back(glm::vec3(0.0f, -1.0f, 0.0f));
+
+	triangles.clear();
+
+	for (unsigned int j = 0; j < 5; j++) {
+
+		unsigned int top = 1 + j, topNext = 1 + (j + 1) % 5;
+		unsigned int bottom = 6 + j, bottomNext = 6 + (j + 1) % 5;
+
+		unsigned int faces[] = {
+			0, topNext, top,
+			top, topNext, bottom,
+			topNext, bottomNext, bottom,
+			bottom, bottomNext, 11
+		};
+
+		triangles.insert(triangles.end(), faces, faces + 12);
+	}
+
+	// every level splits each triangle into 4, the midpoints are shared through the edge map:
+	for (int level = 0; level < subdivisions; level++) {
+
+		std::vector<unsigned int> subdivided;
+		subdivided.reserve(triangles.size() * 4);
+
+		std::map<std::pair<unsigned int, unsigned int>, unsigned int> midpoints;
+
+		auto midpoint = [&](unsigned int a, unsigned int b) {
+
+			std::pair<unsigned int, unsigned int> edge(std::min(a, b), std::max(a, b));
+			auto found = midpoints.find(edge);
+
+			if (found != midpoints.end()) {
+				return found->second;
+			}
+
+			points.push_back(glm::normalize(points[edge.first] + points[edge.second]));
+			unsigned int index = (unsigned int)points.size() - 1;
+			midpoints[edge] = index;
+
+			return index;
+		};
+
+		for (std::size_t t = 0; t < triangles.size(); t += 3) {
+
+			unsigned int a = triangles[t], b = triangles[t + 1], c = triangles[t + 2];
+			unsigned int ab = midpoint(a, b), bc = midpoint(b, c), ca = midpoint(c, a);
+
+			unsigned int faces[] = {
+				a, ab, ca,
+				ab, b, bc,
+				ca, bc, c,
+				ab, bc, ca
+			};
+
+			subdivided.insert(subdivided.end(), faces, faces + 12);
+		}
+
+		triangles.swap(subdivided);
+	}
+}
+
+glm::vec3 Sphere::getCubeFacePoint(int face, float u, float v) {
+
+	// each face spans the grid (u, v) in [-1, 1], mapped onto the cube by an origin & 2 axes:
+	static const glm::vec3 faces[6][3] = {
+		{ glm::vec3( 1, 0, 0), glm::vec3( 0, 0,-1), glm::vec3(0, 1, 0) },
+		{ glm::vec3(-1, 0, 0), glm::vec3( 0, 0, 1), glm::vec3(0, 1, 0) },
+		{ glm::vec3( 0, 1, 0), glm::vec3( 1, 0, 0), glm::vec3(0, 0,-1) },
+		{ glm::vec3( 0,-1, 0), glm::vec3( 1, 0, 0), glm::vec3(0, 0, 1) },
+		{ glm::vec3( 0, 0, 1), glm::vec3( 1, 0, 0), glm::vec3(0, 1, 0) },
+		{ glm::vec3( 0, 0,-1), glm::vec3(-1, 0, 0), glm::vec3(0, 1, 0) },
+	};
+
+	return faces[face][0] + u * faces[face][1] + v * faces[face][2];
+}
+
+glm::vec3 Sphere::spherifyCubePoint(const glm::vec3& c) {
+
+	// spreads the points more evenly than a plain normalize (no bunching at the face centers):
+	return glm::vec3(c.x * sqrtf(1.0f - c.y * c.y / 2 - c.z * c.z / 2 + c.y * c.y * c.z * c.z / 3),
+					 c.y * sqrtf(1.0f - c.z * c.z / 2 - c.x * c.x / 2 + c.z * c.z * c.x * c.x / 3),
+					 c.z * sqrtf(1.0f - c.x * c.x / 2 - c.y * c.y / 2 + c.x * c.x * c.y * c.y / 3));
+}
+
+void Sphere::buildCube(std::vector<glm::vec3>& points, std::vector<unsigned int>& triangles) const {
+
+	int n = subdivisions;
+
+	// the edges of the faces end up on exactly the same points (same grid values), they are welded
+	// so the mesh is closed like the icosphere:
+	std::map<std::pair<float, std::pair<float, float>>, unsigned int> welded;
+	std::vector<unsigned int> grid((std::size_t)(n + 1) * (n + 1));
+
+	points.clear();
+	triangles.resize((std::size_t)6 * n * n * 6);
+
+	unsigned int* index = triangles.data();
+
+	for (int f = 0; f < 6; f++) {
+
+		for (int i = 0; i <= n; i++) {
+			for (int j = 0; j <= n; j++) {
+
+				float u = 2.0f * j / n - 1.0f;
+				float v = 2.0f * i / n - 1.0f;
+
+				glm::vec3 c = getCubeFacePoint(f, u, v);
+				glm::vec3 point = spherifyCubePoint(c);
+
+				auto inserted = welded.insert(std::make_pair(std::make_pair(c.x, std::make_pair(c.y, c.z)), (unsigned int)points.size()));
+
+				if (inserted.second) {
+					points.push_back(point);
+				}
+
+				grid[i * (n + 1) + j] = inserted.first->second;
+			}
+		}
+
+		for (int i = 0; i < n; i++) {
+			for (int j = 0; j < n; j++) {
+
+				unsigned int k1 = i * (n + 1) + j;
+				unsigned int k2 = k1 + n + 1;
+
+				// the same winding as the uv sphere:
+				*index++ = grid[k1];
+				*index++ = grid[k2];
+				*index++ = grid[k1 + 1];
+
+				*index++ = grid[k1 + 1];
+				*index++ = grid[k2];
+				*index++ = grid[k2 + 1];
+			}
+		}
+	}
+}
+
+void Sphere::buildFromUnitPoints(const std::vector<glm::vec3>& points, const std::vector<unsigned int>& triangles) {
+
+	const float PI = acos(-1);
+	const float POLE_EPSILON = 1e-6f;
+
+	// the same mapping as the uv sphere: theta = 2 pi s around the y axis, t = 0 at the bottom pole
+	std::vector<glm::vec2> texCoords(points.size());
+	std::vector<char> isPole(points.size());
+
+	for (std::size_t p = 0; p < points.size(); p++) {
+
+		const glm::vec3& point = points[p];
+
+		float s = atan2f(point.z, -point.x) / (2 * PI);
+		texCoords[p] = glm::vec2(s < 0.0f ? s + 1.0f : s, acosf(glm::clamp(-point.y, -1.0f, 1.0f)) / PI);
+		isPole[p] = fabsf(point.x) < POLE_EPSILON && fabsf(point.z) < POLE_EPSILON;
+	}
+
+	// triangles crossing the seam get copies of their vertices with s + 1,
+	// pole vertices get a copy per triangle with the s of the triangle:
+	std::vector<glm::vec3> outPoints(points);
+	std::vector<glm::vec2> outTexCoords(texCoords);
+	std::vector<unsigned int> wrapped(points.size(), 0xFFFFFFFF);
+
+	std::size_t oldIndexCapacity = indices.capacity();
+	std::size_t oldLineIndexCapacity = lineIndices.capacity();
+
+	indices.resize(triangles.size());
+	lineIndices.clear();
+
+	for (std::size_t t = 0; t < triangles.size(); t += 3) {
+
+		unsigned int corner[3] = { triangles[t], triangles[t + 1], triangles[t + 2] };
+
+		float minS = 1.0f, maxS = 0.0f;
+
+		for (int k = 0; k < 3; k++) {
+			if (!isPole[corner[k]]) {
+				minS = std::min(minS, texCoords[corner[k]].x);
+				maxS = std::max(maxS, texCoords[corner[k]].x);
+			}
+		}
+
+		bool crossesSeam = maxS - minS > 0.5f;
+		float sumS = 0.0f;
+		int sumCount = 0;
+
+		for (int k = 0; k < 3; k++) {
+
+			unsigned int v = corner[k];
+
+			if (crossesSeam && !isPole[v] && texCoords[v].x < 0.5f) {
+
+				if (wrapped[v] == 0xFFFFFFFF) {
+					wrapped[v] = (unsigned int)outPoints.size();
+					outPoints.push_back(points[v]);
+					outTexCoords.push_back(glm::vec2(texCoords[v].x + 1.0f, texCoords[v].y));
+				}
+
+				v = wrapped[v];
+			}
+
+			if (!isPole[corner[k]]) {
+				sumS += outTexCoords[v].x;
+				sumCount++;
+			}
+
+			indices[t + k] = v;
+		}
+
+		for (int k = 0; k < 3; k++) {
+			if (isPole[corner[k]]) {
+				indices[t + k] = (unsigned int)outPoints.size();
+				outPoints.push_back(points[corner[k]]);
+				outTexCoords.push_back(glm::vec2(sumCount > 0 ? sumS / sumCount : 0.0f, texCoords[corner[k]].y));
+			}
+		}
+
+		// every edge is shared by 2 triangles, the one going from the lower to the higher point draws it:
+		for (int k = 0; k < 3; k++) {
+			if (corner[k] < corner[(k + 1) % 3]) {
+				lineIndices.push_back(indices[t + k]);
+				lineIndices.push_back(indices[t + (k + 1) % 3]);
+			}
+		}
+	}
+
+	std::size_t oldVertexCapacity = interleavedVertices.capacity();
+	interleavedVertices.resize(outPoints.size() * 8);
+
+	if (interleavedVertices.capacity() != oldVertexCapacity) buildAllocations++;
+	if (indices.capacity() != oldIndexCapacity) buildAllocations++;
+	if (lineIndices.capacity() != oldLineIndexCapacity) buildAllocations++;
+
+	float* vertex = interleavedVertices.data();
+
+	for (std::size_t p = 0; p < outPoints.size(); p++, vertex += 8) {
+
+		// vertex positions:
+		vertex[0] = outPoints[p].x * radius;
+		vertex[1] = outPoints[p].y * radius;
+		vertex[2] = outPoints[p].z * radius;
+
+		// normalized normals:
+		vertex[3] = outPoints[p].x;
+		vertex[4] = outPoints[p].y;
+		vertex[5] = outPoints[p].z;
+
+		// vertex texture coordintes:
+		vertex[6] = outTexCoords[p].x;
+		vertex[7] = outTexCoords[p].y;
+	}
+}
 
 void Sphere::setProperties(float radius, int sectorCount, int stackCount) {
 	this->radius = abs(radius);
@@ -196,15 +777,6 @@ void Sphere::setProperties(float radius, int sectorCount, int stackCount) {
 	buildVerticesSmooth();
 }
 
-void Sphere::clearArrays(){
-
-	std::vector<float>().swap(vertices);
-	std::vector<float>().swap(normals);
-	std::vector<float>().swap(texCoords);
-	std::vector<unsigned int>().swap(indices);
-	std::vector<unsigned int>().swap(lineIndices);
-}
-
 glm::vec3 Sphere::computeFaceNormal(float x1, float y1, float z1,  // v1
 									float x2, float y2, float z2,  // v2
 									float x3, float y3, float z3)  // v3
@@ -245,38 +817,19 @@ glm::vec3 Sphere::computeFaceNormal(float x1, float y1, float z1,  // v1
 // Load texture:
 unsigned int Sphere::loadTexture(const char* path, bool wrap) {
 
-	unsigned int texture;
-	glGenTextures(1, &texture);
-	glBindTexture(GL_TEXTURE_2D, texture);
+	unsigned int texture = createTexture(wrap);
 
-	// set the options:
-	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
-	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
-	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR_MIPMAP_LINEAR);
-	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+	TextureImage image;
 
-	glTexEnvf(GL_TEXTURE_ENV, GL_TEXTURE_ENV_MODE, GL_MODULATE);
-
-	glTexParameterf(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR_MIPMAP_LINEAR);
-	glTexParameterf(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
-	//glTexParameteri(GL_TEXTURE_2D, GL_GENERATE_MIPMAP, GL_TRUE);
-
-
-	int width, height, nrOfChannels;
-	stbi_set_flip_vertically_on_load(true);
-
-	unsigned char* data = stbi_load(path, &width, &height, &nrOfChannels, 0);
-
-	if (data) {
-		glTexImage2D(GL_TEXTURE_2D, 0, GL_RGB, width, height, 0, GL_RGB, GL_UNSIGNED_BYTE, data);
-		glGenerateMipmap(GL_TEXTURE_2D);
+	if (decodeTextureImage(path, image)) {
+		generateTextureMipmaps(image, MIP_FILTER_KAISER, wrap);
+		uploadTextureImage(texture, image);
 	}
 	else {
 		std::cout << "FAILED TO LOAD TEXTURE\n";
 	}
 
-	stbi_image_free(data);
+	freeTextureImage(image);
 
 	return texture;
-	
-}
\ No newline at end of file
+}
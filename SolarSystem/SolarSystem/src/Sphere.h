@@ -4,6 +4,8 @@
 #include <GLFW/glfw3.h>
 
 #include <vector>
+#include <map>
+#include <algorithm>
 #include <cmath>
 #include <string>
 #include <fstream>
@@ -14,6 +16,24 @@
 #include <glm/gtc/matrix_transform.hpp>
 #include <glm/gtc/type_ptr.hpp>
 
+#include "IndexFormat.h"
+
+
+// kernels for the vertex generation, KERNEL_AUTO picks the widest one the cpu supports:
+enum Sphere_Kernel {
+	KERNEL_AUTO,
+	KERNEL_SCALAR,
+	KERNEL_SSE,	// 4 vertices per iteration
+	KERNEL_AVX	// 8 vertices per iteration
+};
+
+// how the sphere is split into triangles:
+enum Sphere_Tessellation {
+	TESSELLATION_UV,		// sectors & stacks, dense at the poles
+	TESSELLATION_ICOSPHERE,	// subdivided icosahedron, 20 * 4^subdivisions triangles
+	TESSELLATION_CUBE		// cube with subdivisions x subdivisions quads per face pushed onto the sphere, 12 * subdivisions^2 triangles
+};
+
 
 class Sphere{
 
@@ -24,6 +44,11 @@ public:
 	// for debugging:
 	void printInfo();
 
+	// reorders the triangles for the post-transform vertex cache and the vertices in the order they are used,
+	// until the next build (see MeshOptimizer.h)
+	void optimizeVertexCache();
+	bool isVertexCacheOptimized() const { return !vertexRemap.empty(); }
+
 	// getters & setters:
 	float getRadius() const { return radius; }
 	int getSectorCount() const { return sectorCount; }
@@ -34,21 +59,39 @@ public:
 	void setSectorCount(int sectorCount);
 	void setStackCount(int stackCount);
 
+	// rebuilds the sphere, the sector & stack count are only used by TESSELLATION_UV
+	void setTessellation(Sphere_Tessellation tessellation, int subdivisions);
+	Sphere_Tessellation getTessellation() const { return tessellation; }
+	int getSubdivisions() const { return subdivisions; }
+
+	// used from the next build on:
+	void setKernel(Sphere_Kernel kernel) { this->kernel = kernel; }
+	Sphere_Kernel getKernel() const { return kernel; }
+	static Sphere_Kernel getBestKernel();
+
+	// nr of threads building the stacks, 1 = on the calling thread only, 0 = one per hardware thread
+	// (the result is the same for every thread count)
+	void setThreadCount(unsigned int threadCount) { this->threadCount = threadCount; }
+	unsigned int getThreadCount() const { return threadCount; }
+
 	// general infos:
-	unsigned int getVertexCount() const { return (unsigned int)vertices.size() / 3; }
-	unsigned int getNormalCount() const { return (unsigned int)normals.size() / 3; }
-	unsigned int getTexCoordCount() const { return (unsigned int)texCoords.size() / 2; }
+	unsigned int getVertexCount() const { return (unsigned int)interleavedVertices.size() / 8; }
+	unsigned int getNormalCount() const { return getVertexCount(); }
+	unsigned int getTexCoordCount() const { return getVertexCount(); }
 	unsigned int getIndexCount() const { return (unsigned int)indices.size(); }
 	unsigned int getLineIndexCount() const { return (unsigned int)lineIndices.size(); }
 	unsigned int getTriangleCount() const { return getIndexCount() / 3; }
 
 	// sizes for strides and memory
-	unsigned int getVertexSize() const { return (unsigned int)vertices.size() * sizeof(float); }
-	unsigned int getNormalSize() const { return (unsigned int)normals.size() * sizeof(float); }
-	unsigned int getTexCoordSize() const { return (unsigned int)texCoords.size() * sizeof(float); }
+	unsigned int getVertexSize() const { return getVertexCount() * 3 * sizeof(float); }
+	unsigned int getNormalSize() const { return getNormalCount() * 3 * sizeof(float); }
+	unsigned int getTexCoordSize() const { return getTexCoordCount() * 2 * sizeof(float); }
 	unsigned int getIndexSize() const { return (unsigned int)indices.size() * sizeof(unsigned int); }
 	unsigned int getLineIndexSize() const { return (unsigned int)lineIndices.size() * sizeof(unsigned int); }
 
+	// nr of buffer (re)allocations done by the last build, 0 when the capacity could be reused
+	unsigned int getBuildAllocations() const { return buildAllocations; }
+
 
 	// geters for the final verticies with all the 
 	unsigned int getInterleavedVertexCount() const { return getVertexCount(); }    // # of vertices
@@ -57,37 +100,65 @@ public:
 	const float* getInterleavedVertices() const { return interleavedVertices.data(); }
 
 	// getters for the drawcalls
-	const float* getVertices() const { return vertices.data(); }
-	const float* getNormals() const { return normals.data(); }
-	const float* getTexCoords() const { return texCoords.data(); }
 	const unsigned int* getIndices() const { return indices.data(); }
 	const unsigned int* getLineIndices() const { return lineIndices.data(); }
 
+	// one triangle strip per stack instead of the triangle list of getIndices(), the strips are
+	// separated by PRIMITIVE_RESTART_INDEX (the extra triangles at the poles have zero area)
+	// only TESSELLATION_UV has stacks, the other tessellations give no strips
+	void buildStripIndices(std::vector<unsigned int>& stripIndices) const;
+
+	// the point (u, v) in [-1, 1] of cube face 0..5 (+x, -x, +y, -y, +z, -z) and its projection on the unit sphere,
+	// the same mapping TESSELLATION_CUBE uses:
+	static glm::vec3 getCubeFacePoint(int face, float u, float v);
+	static glm::vec3 spherifyCubePoint(const glm::vec3& c);
+
 	// textures:
 
-	unsigned int loadTexture(const char* path, bool wrap);
+	static unsigned int loadTexture(const char* path, bool wrap);
 
 private:
 	float radius;
 	int sectorCount; // nr of partitions in each layer (top and bottom ones are triangles)
 	int stackCount; // nr of layers of a sphere
 
-	std::vector<float> vertices;
+	Sphere_Tessellation tessellation;
+	int subdivisions;
+
 	std::vector<unsigned int> indices;
 	std::vector<unsigned int> lineIndices;
-	std::vector<float> normals;
-	std::vector<float> texCoords;
 
-	// final vertices:
+	// final vertices (position, normal, texCoord per vertex):
 	std::vector<float> interleavedVertices;
 	int interleavedStride;
+
+	unsigned int buildAllocations;
+
+	// cos & sin of the sector angles, the same for every stack:
+	std::vector<float> sectorCos;
+	std::vector<float> sectorSin;
+
+	Sphere_Kernel kernel;
+	unsigned int threadCount;
+
+	// grid vertex -> vertex after optimizeVertexCache(), empty when not optimized:
+	std::vector<unsigned int> vertexRemap;
 	
 	// builds:
 	void buildVerticesSmooth();
-	void buildInterleavedVertices();
-
-	// clear
-	void clearArrays();
+	void buildSectorRing();
+	void buildStacks(int firstStack, int lastStack); // [firstStack, lastStack) of the stackCount + 1 vertex stacks
+
+	// icosphere & cube sphere, from unit points and triangles:
+	void buildVerticesGeodesic();
+	void buildIcosahedron(std::vector<glm::vec3>& points, std::vector<unsigned int>& triangles) const;
+	void buildCube(std::vector<glm::vec3>& points, std::vector<unsigned int>& triangles) const;
+	void buildFromUnitPoints(const std::vector<glm::vec3>& points, const std::vector<unsigned int>& triangles);
+
+	// exact sizes of the arrays for the current sector & stack count:
+	std::size_t computeVertexCount() const;
+	std::size_t computeIndexCount() const;
+	std::size_t computeLineIndexCount() const;
 
 	// computing normals:
 	glm::vec3 computeFaceNormal(float x1, float y1, float z1,
@@ -0,0 +1,123 @@
+#include "SphereMeshCache.h"
+
+
+SphereMeshCache::~SphereMeshCache() {
+	clear();
+}
+
+const SphereMesh& SphereMeshCache::get(int sectorCount, int stackCount, Vertex_Format format, Index_Topology topology) {
+
+	SphereMeshKey key = { TESSELLATION_UV, sectorCount, stackCount, format, topology };
+	return get(key);
+}
+
+const SphereMesh& SphereMeshCache::getTessellated(Sphere_Tessellation tessellation, int subdivisions, Vertex_Format format) {
+
+	if (tessellation == TESSELLATION_UV) {
+		std::cout << "ERROR::SPHERE_MESH_CACHE::UV_SPHERES_NEED_SECTORS_AND_STACKS\n";
+	}
+
+	SphereMeshKey key = { tessellation, subdivisions, 0, format, TOPOLOGY_TRIANGLES };
+	return get(key);
+}
+
+const SphereMesh& SphereMeshCache::get(const SphereMeshKey& key) {
+
+	Vertex_Format format = key.format;
+	Index_Topology topology = key.topology;
+
+	std::unique_ptr<SphereMesh>& mesh = meshes[key];
+
+	if (!mesh) {
+		mesh.reset(new SphereMesh(key));
+
+		if (key.tessellation != TESSELLATION_UV) {
+			mesh->sphere.setTessellation(key.tessellation, key.sectorCount);
+		}
+
+		// the strips are already in cache friendly order, the triangle list isn't:
+		if (topology == TOPOLOGY_TRIANGLES) {
+			mesh->sphere.optimizeVertexCache();
+		}
+
+		if (format == VERTEX_FORMAT_COMPACT) {
+			mesh->compactVertices.resize(mesh->sphere.getVertexCount());
+			packCompactVertices(mesh->sphere.getInterleavedVertices(), mesh->compactVertices.size(), 1.0f, mesh->compactVertices.data());
+		}
+
+		const Sphere& sphere = mesh->sphere;
+
+		if (topology == TOPOLOGY_TRIANGLE_STRIP) {
+			std::vector<unsigned int> stripIndices;
+			sphere.buildStripIndices(stripIndices);
+			packIndices(stripIndices.data(), stripIndices.size(), sphere.getVertexCount(), topology, mesh->indices);
+		}
+		else {
+			packIndices(sphere.getIndices(), sphere.getIndexCount(), sphere.getVertexCount(), topology, mesh->indices);
+		}
+
+		upload(*mesh);
+	}
+
+	return *mesh;
+}
+
+std::size_t SphereMeshCache::getGpuMemorySize() const {
+
+	std::size_t size = 0;
+
+	for (const auto& entry : meshes) {
+		size += entry.second->getVertexSize() + entry.second->indices.getSize();
+	}
+
+	return size;
+}
+
+std::size_t SphereMeshCache::getCpuMemorySize() const {
+
+	std::size_t size = 0;
+
+	for (const auto& entry : meshes) {
+		const SphereMesh& mesh = *entry.second;
+		size += mesh.sphere.getInterleavedVertexSize() + mesh.sphere.getIndexSize() + mesh.sphere.getLineIndexSize();
+		size += mesh.compactVertices.size() * sizeof(CompactVertex) + mesh.indices.getSize();
+	}
+
+	return size;
+}
+
+void SphereMeshCache::clear() {
+
+	for (auto& entry : meshes) {
+		glDeleteVertexArrays(1, &entry.second->VAO);
+		glDeleteBuffers(1, &entry.second->VBO);
+		glDeleteBuffers(1, &entry.second->EBO);
+	}
+
+	meshes.clear();
+}
+
+void SphereMeshCache::upload(SphereMesh& mesh) {
+
+	const Sphere& sphere = mesh.sphere;
+
+	glGenVertexArrays(1, &mesh.VAO);
+	glBindVertexArray(mesh.VAO);
+
+	const void* vertices = mesh.format == VERTEX_FORMAT_COMPACT ? (const void*)mesh.compactVertices.data() : (const void*)sphere.getInterleavedVertices();
+
+	glGenBuffers(1, &mesh.VBO);
+	glBindBuffer(GL_ARRAY_BUFFER, mesh.VBO);
+	glBufferData(GL_ARRAY_BUFFER, mesh.getVertexSize(), vertices, GL_STATIC_DRAW);
+
+	setupVertexAttributes(mesh.format);
+
+	// the element buffer binding is stored in the VAO:
+	glGenBuffers(1, &mesh.EBO);
+	glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, mesh.EBO);
+	glBufferData(GL_ELEMENT_ARRAY_BUFFER, mesh.indices.getSize(), mesh.indices.data.data(), GL_STATIC_DRAW);
+
+	glBindVertexArray(0);
+	glBindBuffer(GL_ARRAY_BUFFER, 0);
+	glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, 0);
+}
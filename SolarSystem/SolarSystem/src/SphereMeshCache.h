@@ -0,0 +1,84 @@
+#pragma once
+
+#include "Sphere.h"
+#include "VertexFormat.h"
+#include "IndexFormat.h"
+
+#include <map>
+#include <memory>
+
+
+// what a cached mesh is built & uploaded with:
+struct SphereMeshKey {
+
+	Sphere_Tessellation tessellation;
+	int sectorCount;	// the subdivisions for TESSELLATION_ICOSPHERE & TESSELLATION_CUBE
+	int stackCount;		// 0 for TESSELLATION_ICOSPHERE & TESSELLATION_CUBE
+	Vertex_Format format;
+	Index_Topology topology;
+
+	bool operator<(const SphereMeshKey& other) const {
+		if (tessellation != other.tessellation) return tessellation < other.tessellation;
+		if (sectorCount != other.sectorCount) return sectorCount < other.sectorCount;
+		if (stackCount != other.stackCount) return stackCount < other.stackCount;
+		if (format != other.format) return format < other.format;
+		return topology < other.topology;
+	}
+};
+
+
+// one tessellation of the unit sphere on the cpu & gpu, shared by every body drawn with that resolution
+// (the radius of the body goes into its model matrix)
+struct SphereMesh {
+
+	SphereMesh(const SphereMeshKey& key) : sphere(1.0f, key.sectorCount, key.stackCount), format(key.format), VAO(0), VBO(0), EBO(0) {}
+
+	Sphere sphere; // vertex cache optimized for TOPOLOGY_TRIANGLES
+
+	Vertex_Format format;
+	std::vector<CompactVertex> compactVertices; // only for VERTEX_FORMAT_COMPACT
+
+	MeshIndices indices; // what is in the EBO, draw with drawIndices()
+
+	unsigned int VAO;
+	unsigned int VBO;
+	unsigned int EBO;
+
+	// # of bytes of the vertex data uploaded:
+	unsigned int getVertexSize() const { return sphere.getVertexCount() * getVertexFormatStride(format); }
+};
+
+
+// builds and uploads every tessellation only once
+// needs a current OpenGL context
+class SphereMeshCache {
+
+public:
+
+	SphereMeshCache() {}
+	~SphereMeshCache();
+
+	SphereMeshCache(const SphereMeshCache&) = delete;
+	SphereMeshCache& operator=(const SphereMeshCache&) = delete;
+
+	// builds and uploads the mesh on the first request:
+	const SphereMesh& get(int sectorCount, int stackCount, Vertex_Format format = VERTEX_FORMAT_FLOAT, Index_Topology topology = TOPOLOGY_TRIANGLES);
+
+	// icosphere & cube sphere meshes, always triangle lists:
+	const SphereMesh& getTessellated(Sphere_Tessellation tessellation, int subdivisions, Vertex_Format format = VERTEX_FORMAT_FLOAT);
+
+	// for debugging:
+	unsigned int getMeshCount() const { return (unsigned int)meshes.size(); }
+	std::size_t getGpuMemorySize() const; // # of bytes in the vertex & index buffers
+	std::size_t getCpuMemorySize() const; // # of bytes the meshes keep: the float sphere & its indices, the compact copy, the packed indices
+
+	// deletes the gpu buffers too:
+	void clear();
+
+private:
+
+	std::map<SphereMeshKey, std::unique_ptr<SphereMesh>> meshes;
+
+	const SphereMesh& get(const SphereMeshKey& key);
+	void upload(SphereMesh& mesh);
+};
@@ -0,0 +1,322 @@
+#include "Texture.h"
+
+#define STB_IMAGE_IMPLEMENTATION
+#include "stb_image.h"
+
+
+bool decodeTextureImage(const std::string& path, TextureImage& image) {
+
+	// the flag is per thread, the workers decode at the same time:
+	stbi_set_flip_vertically_on_load_thread(true);
+
+	image.pixels = stbi_load(path.c_str(), &image.width, &image.height, &image.channels, 0);
+
+	image.srgb = false;
+	image.mipmaps.clear();
+
+	if (!image.pixels) {
+		image.width = 0;
+		image.height = 0;
+		image.channels = 0;
+		return false;
+	}
+
+	packTextureImage(image);
+
+	return true;
+}
+
+void freeTextureImage(TextureImage& image) {
+	stbi_image_free(image.pixels);
+	image.pixels = NULL;
+
+	// the memory too, not only the size:
+	std::vector<unsigned char>().swap(image.mipmaps);
+}
+
+bool packTextureImage(TextureImage& image) {
+
+	std::size_t pixelCount = (std::size_t)image.width * image.height;
+	int channels = image.channels;
+
+	if (!image.pixels || channels == 1)
+		return false;
+
+	bool hasColor = channels == 2;	// grey & alpha already
+	bool hasAlpha = channels == 4 || channels == 2;
+
+	unsigned char* p = image.pixels;
+
+	// alpha is opaque everywhere:
+	if (hasAlpha) {
+		hasAlpha = false;
+		for (std::size_t i = 0; i < pixelCount && !hasAlpha; i++)
+			hasAlpha = p[i * channels + channels - 1] != 255;
+	}
+
+	// r == g == b everywhere:
+	if (channels >= 3) {
+		for (std::size_t i = 0; i < pixelCount && !hasColor; i++)
+			hasColor = p[i * channels] != p[i * channels + 1] || p[i * channels] != p[i * channels + 2];
+	}
+
+	int packed = (hasColor ? 3 : 1) + (hasAlpha ? 1 : 0);
+
+	if (channels == 2)
+		packed = hasAlpha ? 2 : 1;
+
+	if (packed == channels)
+		return false;
+
+	// in place, the packed pixels are never behind the ones still to read:
+	for (std::size_t i = 0; i < pixelCount; i++) {
+
+		const unsigned char* source = p + i * channels;
+		unsigned char* destination = p + i * packed;
+
+		unsigned char alpha = source[channels - 1];
+
+		if (packed >= 3) {
+			destination[0] = source[0];
+			destination[1] = source[1];
+			destination[2] = source[2];
+		}
+		else {
+			destination[0] = source[0];
+		}
+
+		if (hasAlpha)
+			destination[packed - 1] = alpha;
+	}
+
+	image.channels = packed;
+
+	return true;
+}
+
+static void expandPixels(const unsigned char* source, std::size_t pixelCount, int channels, unsigned char* destination, int expanded) {
+
+	bool grey = channels < 3;
+	bool alpha = channels == 2 || channels == 4;
+
+	for (std::size_t i = 0; i < pixelCount; i++, source += channels, destination += expanded) {
+
+		destination[0] = source[0];
+		destination[1] = grey ? source[0] : source[1];
+		destination[2] = grey ? source[0] : source[2];
+
+		if (expanded == 4)
+			destination[3] = alpha ? source[channels - 1] : 255;
+	}
+}
+
+bool expandTextureImage(TextureImage& image, int channels) {
+
+	if (!image.pixels || image.channels == channels)
+		return false;
+
+	unsigned char* pixels = allocateTexturePixels((std::size_t)image.width * image.height * channels);
+	expandPixels(image.pixels, (std::size_t)image.width * image.height, image.channels, pixels, channels);
+
+	std::vector<unsigned char> mipmaps;
+
+	if (!image.mipmaps.empty()) {
+
+		mipmaps.resize(getTextureMemorySize(image.width, image.height, channels) - (std::size_t)image.width * image.height * channels);
+
+		const unsigned char* source = image.mipmaps.data();
+		unsigned char* destination = mipmaps.data();
+		int width = image.width, height = image.height;
+
+		for (int level = 1; level < getMipLevelCount(image.width, image.height); level++) {
+
+			width = width > 1 ? width / 2 : 1;
+			height = height > 1 ? height / 2 : 1;
+
+			expandPixels(source, (std::size_t)width * height, image.channels, destination, channels);
+
+			source += (std::size_t)width * height * image.channels;
+			destination += (std::size_t)width * height * channels;
+		}
+	}
+
+	freeTextureImage(image);
+
+	image.pixels = pixels;
+	image.mipmaps.swap(mipmaps);
+	image.channels = channels;
+
+	return true;
+}
+
+unsigned char* allocateTexturePixels(std::size_t size) {
+	// stbi_image_free() is free():
+	return (unsigned char*)malloc(size);
+}
+
+unsigned int createTexture(bool wrap) {
+
+	unsigned int texture;
+	glGenTextures(1, &texture);
+	glBindTexture(GL_TEXTURE_2D, texture);
+
+	// set the options:
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, wrap ? GL_REPEAT : GL_CLAMP_TO_EDGE);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR_MIPMAP_LINEAR);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+
+	glTexEnvf(GL_TEXTURE_ENV, GL_TEXTURE_ENV_MODE, GL_MODULATE);
+
+	return texture;
+}
+
+GLenum getTextureImageFormat(const TextureImage& image) {
+
+	switch (image.channels) {
+	case 1: return GL_RED;
+	case 2: return GL_RG;
+	case 4: return GL_RGBA;
+	default: return GL_RGB;
+	}
+}
+
+GLenum getTextureInternalFormat(int channels, bool srgb) {
+
+	switch (channels) {
+	case 1: return GL_R8;
+	case 2: return GL_RG8;
+	case 4: return srgb ? GL_SRGB8_ALPHA8 : GL_RGBA8;
+	default: return srgb ? GL_SRGB8 : GL_RGB8;
+	}
+}
+
+GLenum getTextureInternalFormat(const TextureImage& image) {
+	return getTextureInternalFormat(image.channels, image.srgb);
+}
+
+const char* getTextureFormatName(GLenum internalFormat) {
+
+	switch (internalFormat) {
+	case GL_R8: return "r8";
+	case GL_RG8: return "rg8";
+	case GL_RGB8: return "rgb8";
+	case GL_RGBA8: return "rgba8";
+	case GL_SRGB8: return "srgb8";
+	case GL_SRGB8_ALPHA8: return "srgba8";
+	default: return "?";
+	}
+}
+
+// the shaders read grey textures from rgb & the alpha from a:
+static void setTextureSwizzle(int channels) {
+
+	GLint swizzle[4] = { GL_RED, GL_GREEN, GL_BLUE, GL_ALPHA };
+
+	if (channels == 1) {
+		swizzle[1] = GL_RED;
+		swizzle[2] = GL_RED;
+		swizzle[3] = GL_ONE;
+	}
+	else if (channels == 2) {
+		swizzle[1] = GL_RED;
+		swizzle[2] = GL_RED;
+		swizzle[3] = GL_GREEN;
+	}
+
+	glTexParameteriv(GL_TEXTURE_2D, GL_TEXTURE_SWIZZLE_RGBA, swizzle);
+}
+
+int getMipLevelCount(int width, int height) {
+
+	int levels = 1;
+
+	while (width > 1 || height > 1) {
+		width = width > 1 ? width / 2 : 1;
+		height = height > 1 ? height / 2 : 1;
+		levels++;
+	}
+
+	return levels;
+}
+
+std::size_t getTextureMemorySize(int width, int height, int channels) {
+
+	std::size_t size = 0;
+
+	for (int level = getMipLevelCount(width, height); level > 0; level--) {
+		size += (std::size_t)width * height * channels;
+		width = width > 1 ? width / 2 : 1;
+		height = height > 1 ? height / 2 : 1;
+	}
+
+	return size;
+}
+
+const unsigned char* getTextureImageLevel(const TextureImage& image, int level) {
+
+	if (level == 0)
+		return image.pixels;
+
+	std::size_t offset = 0;
+	int width = image.width, height = image.height;
+
+	for (int l = 1; l < level; l++) {
+		width = width > 1 ? width / 2 : 1;
+		height = height > 1 ? height / 2 : 1;
+		offset += (std::size_t)width * height * image.channels;
+	}
+
+	return image.mipmaps.data() + offset;
+}
+
+void uploadTextureImage(unsigned int texture, const TextureImage& image) {
+
+	glBindTexture(GL_TEXTURE_2D, texture);
+	setTextureSwizzle(image.channels);
+
+	// grey & rgb rows aren't 4 byte aligned for every width:
+	glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
+	glTexImage2D(GL_TEXTURE_2D, 0, getTextureInternalFormat(image), image.width, image.height, 0, getTextureImageFormat(image), GL_UNSIGNED_BYTE, image.pixels);
+	glPixelStorei(GL_UNPACK_ALIGNMENT, 4);
+
+	if (image.mipmaps.empty())
+		glGenerateMipmap(GL_TEXTURE_2D);
+	else
+		uploadTextureMipmaps(texture, image);
+}
+
+void uploadTextureMipmaps(unsigned int texture, const TextureImage& image) {
+
+	GLenum internalFormat = getTextureInternalFormat(image);
+	GLenum format = getTextureImageFormat(image);
+
+	glBindTexture(GL_TEXTURE_2D, texture);
+	glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
+
+	int width = image.width, height = image.height;
+
+	for (int level = 1; level < getMipLevelCount(image.width, image.height); level++) {
+		width = width > 1 ? width / 2 : 1;
+		height = height > 1 ? height / 2 : 1;
+		glTexImage2D(GL_TEXTURE_2D, level, internalFormat, width, height, 0, format, GL_UNSIGNED_BYTE, getTextureImageLevel(image, level));
+	}
+
+	glPixelStorei(GL_UNPACK_ALIGNMENT, 4);
+}
+
+void allocateTextureImage(unsigned int texture, const TextureImage& image) {
+
+	glBindTexture(GL_TEXTURE_2D, texture);
+	setTextureSwizzle(image.channels);
+
+	glTexImage2D(GL_TEXTURE_2D, 0, getTextureInternalFormat(image), image.width, image.height, 0, getTextureImageFormat(image), GL_UNSIGNED_BYTE, NULL);
+}
+
+void uploadPlaceholderImage(unsigned int texture, int level, GLenum internalFormat) {
+
+	const unsigned char grey[4] = { 128, 128, 128, 255 };
+
+	glBindTexture(GL_TEXTURE_2D, texture);
+	glTexImage2D(GL_TEXTURE_2D, level, internalFormat, 1, 1, 0, GL_RGBA, GL_UNSIGNED_BYTE, grey);
+}
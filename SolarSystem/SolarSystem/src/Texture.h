@@ -0,0 +1,70 @@
+#pragma once
+
+#include <GL/glew.h>
+
+#include <string>
+#include <cstddef>
+#include <vector>
+
+
+// a decoded image, the rows go from the bottom up like OpenGL expects them:
+struct TextureImage {
+	int width;
+	int height;
+	int channels;	// 1 grey, 2 grey & alpha, 3 rgb, 4 rgba
+	bool srgb;	// colors stored in sRGB, sampled as linear (false after decoding, the shaders light in gamma space)
+	unsigned char* pixels;	// from stb_image, free with freeTextureImage()
+	std::vector<unsigned char> mipmaps;	// levels 1.. back to back from generateTextureMipmaps(), empty: the driver builds them
+};
+
+// decodes a jpg / png file, safe on any thread, false if it failed
+// grey rgb images & opaque alpha channels are dropped (lossless), so the image has the fewest channels it needs:
+bool decodeTextureImage(const std::string& path, TextureImage& image);
+void freeTextureImage(TextureImage& image);
+
+// drops the channels the image doesn't need, returns true if it got smaller:
+bool packTextureImage(TextureImage& image);
+
+// the other way, to rgb or rgba with the mipmaps: grey is spread over rgb, alpha is opaque if the image had none
+// and dropped for rgb, returns true if the image changed:
+bool expandTextureImage(TextureImage& image, int channels);
+
+// pixels freeTextureImage() can free, for images that don't come from stb_image:
+unsigned char* allocateTexturePixels(std::size_t size);
+
+// texture with the sampling options of the planets (mipmapped) and no image yet
+// wrap repeats around the sphere (s), the poles (t) are always clamped:
+unsigned int createTexture(bool wrap);
+
+// the format glTexImage2D reads the pixels of the image with (GL_RED, GL_RG, GL_RGB or GL_RGBA):
+GLenum getTextureImageFormat(const TextureImage& image);
+
+// the tightest internal format for the channels: GL_R8, GL_RG8, GL_RGB8 or GL_RGBA8 (GL_SRGB8 / GL_SRGB8_ALPHA8 for
+// srgb images, grey ones stay linear, OpenGL has no sRGB red / rg formats):
+GLenum getTextureInternalFormat(int channels, bool srgb);
+GLenum getTextureInternalFormat(const TextureImage& image);
+
+// short name of the internal formats above for the tables ("r8", "rgba8", "srgb8", ...):
+const char* getTextureFormatName(GLenum internalFormat);
+
+// # of mipmap levels down to 1x1:
+int getMipLevelCount(int width, int height);
+
+// # of bytes of all levels of a raw texture:
+std::size_t getTextureMemorySize(int width, int height, int channels);
+
+// pixels of a level of the image, level 0 or one of its mipmaps:
+const unsigned char* getTextureImageLevel(const TextureImage& image, int level);
+
+// puts the image & its mipmaps into the texture (glGenerateMipmap if it has none), needs the OpenGL context:
+void uploadTextureImage(unsigned int texture, const TextureImage& image);
+
+// levels 1.. of the image, after level 0 is in (the image needs its mipmaps):
+void uploadTextureMipmaps(unsigned int texture, const TextureImage& image);
+
+// level 0 of the texture with the size of the image but no pixels yet (no pixel unpack buffer may be bound):
+void allocateTextureImage(unsigned int texture, const TextureImage& image);
+
+// 1x1 grey texture image the bodies show until their real texture is there, at a level of a texture it has to
+// have the internal format of the other levels:
+void uploadPlaceholderImage(unsigned int texture, int level = 0, GLenum internalFormat = GL_RGB8);
@@ -0,0 +1,329 @@
+#include "TextureArchive.h"
+
+#include <fstream>
+#include <iostream>
+#include <cstring>
+#include <cstdio>
+
+#ifdef _WIN32
+#define WIN32_LEAN_AND_MEAN
+#define NOMINMAX
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#endif
+
+#include <sys/types.h>
+#include <sys/stat.h>
+
+
+const char* const SHIPPED_TEXTURES[] = {
+	"res/textures/earth.jpg",
+	"res/textures/earth_clouds.jpg",
+	"res/textures/earth_daymap.jpg",
+	"res/textures/earth_nightmap.jpg",
+	"res/textures/jupiter.jpg",
+	"res/textures/mars.jpg",
+	"res/textures/mercury.jpg",
+	"res/textures/moon.jpg",
+	"res/textures/neptune.jpg",
+	"res/textures/saturn.jpg",
+	"res/textures/saturn_ring_alpha.png",
+	"res/textures/stars.jpg",
+	"res/textures/stars_milky_way.jpg",
+	"res/textures/sun.jpg",
+	"res/textures/uranus.jpg",
+	"res/textures/venus_atmosphere.jpg",
+	"res/textures/venus_surface.jpg",
+};
+
+const int SHIPPED_TEXTURE_COUNT = sizeof(SHIPPED_TEXTURES) / sizeof(SHIPPED_TEXTURES[0]);
+
+const uint32_t TEXTURE_ARCHIVE_VERSION = 2;
+const std::size_t ARCHIVE_PAGE_SIZE = 4096;
+
+
+bool getSourceStamp(const std::string& path, uint64_t& size, int64_t& time) {
+
+#ifdef _WIN32
+	struct _stat64 info;
+	if (_stat64(path.c_str(), &info) != 0)
+		return false;
+#else
+	struct stat info;
+	if (stat(path.c_str(), &info) != 0)
+		return false;
+#endif
+
+	size = (uint64_t)info.st_size;
+	time = (int64_t)info.st_mtime;
+	return true;
+}
+
+bool MappedFile::open(const std::string& path) {
+
+	close();
+
+#ifdef _WIN32
+	HANDLE fileHandle = CreateFileA(path.c_str(), GENERIC_READ, FILE_SHARE_READ, NULL, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, NULL);
+
+	if (fileHandle == INVALID_HANDLE_VALUE)
+		return false;
+
+	LARGE_INTEGER fileSize;
+
+	if (!GetFileSizeEx(fileHandle, &fileSize) || fileSize.QuadPart == 0) {
+		CloseHandle(fileHandle);
+		return false;
+	}
+
+	HANDLE mappingHandle = CreateFileMappingA(fileHandle, NULL, PAGE_READONLY, 0, 0, NULL);
+	void* view = mappingHandle ? MapViewOfFile(mappingHandle, FILE_MAP_READ, 0, 0, 0) : NULL;
+
+	if (!view) {
+		if (mappingHandle)
+			CloseHandle(mappingHandle);
+		CloseHandle(fileHandle);
+		return false;
+	}
+
+	file = fileHandle;
+	mapping = mappingHandle;
+	data = (const unsigned char*)view;
+	size = (std::size_t)fileSize.QuadPart;
+#else
+	int descriptor = ::open(path.c_str(), O_RDONLY);
+
+	if (descriptor < 0)
+		return false;
+
+	struct stat info;
+
+	if (fstat(descriptor, &info) != 0 || info.st_size == 0) {
+		::close(descriptor);
+		return false;
+	}
+
+	void* view = mmap(NULL, (std::size_t)info.st_size, PROT_READ, MAP_SHARED, descriptor, 0);
+
+	// the mapping stays valid without the descriptor:
+	::close(descriptor);
+
+	if (view == MAP_FAILED)
+		return false;
+
+	data = (const unsigned char*)view;
+	size = (std::size_t)info.st_size;
+#endif
+
+	return true;
+}
+
+void MappedFile::close() {
+
+	if (!data)
+		return;
+
+#ifdef _WIN32
+	UnmapViewOfFile(data);
+	CloseHandle((HANDLE)mapping);
+	CloseHandle((HANDLE)file);
+	file = NULL;
+	mapping = NULL;
+#else
+	munmap((void*)data, size);
+#endif
+
+	data = NULL;
+	size = 0;
+}
+
+bool TextureArchive::open(const std::string& path) {
+
+	close();
+
+	if (!file.open(path))
+		return false;
+
+	const TextureArchiveHeader* fileHeader = (const TextureArchiveHeader*)file.getData();
+
+	bool valid = file.getSize() >= sizeof(TextureArchiveHeader)
+		&& memcmp(fileHeader->magic, "STXA", 4) == 0
+		&& fileHeader->version == TEXTURE_ARCHIVE_VERSION
+		&& fileHeader->entryOffset + (std::size_t)fileHeader->entryCount * sizeof(TextureArchiveEntry) <= file.getSize();
+
+	if (!valid) {
+		std::cout << "ERROR::TEXTURE_ARCHIVE::NOT_AN_ARCHIVE: " << path << "\n";
+		file.close();
+		return false;
+	}
+
+	const TextureArchiveEntry* fileEntries = (const TextureArchiveEntry*)(file.getData() + fileHeader->entryOffset);
+
+	// a half written or truncated archive would fault in the uploads, they read straight from the mapping:
+	for (unsigned int e = 0; e < fileHeader->entryCount; e++) {
+		if (!isEntryValid(fileEntries[e])) {
+			std::cout << "ERROR::TEXTURE_ARCHIVE::TRUNCATED: " << path << "\n";
+			file.close();
+			return false;
+		}
+	}
+
+	header = fileHeader;
+	entries = fileEntries;
+
+	return true;
+}
+
+bool TextureArchive::isEntryValid(const TextureArchiveEntry& entry) const {
+
+	if (memchr(entry.path, '\0', sizeof(entry.path)) == NULL)
+		return false;
+
+	if (entry.levelCount == 0 || entry.levelCount > (uint32_t)ARCHIVE_MAX_LEVELS)
+		return false;
+
+	for (uint32_t level = 0; level < entry.levelCount; level++) {
+		if (entry.levelOffsets[level] > file.getSize() || entry.levelSizes[level] > file.getSize() - entry.levelOffsets[level])
+			return false;
+	}
+
+	return true;
+}
+
+void TextureArchive::close() {
+	file.close();
+	header = NULL;
+	entries = NULL;
+}
+
+const TextureArchiveEntry* TextureArchive::find(const std::string& sourcePath) const {
+
+	for (unsigned int e = 0; e < getEntryCount(); e++) {
+
+		const TextureArchiveEntry& entry = entries[e];
+
+		if (sourcePath != entry.path)
+			continue;
+
+		uint64_t size;
+		int64_t time;
+
+		// a source that is gone is fine, the cooked one is all we need:
+		if (getSourceStamp(sourcePath, size, time) && (size != entry.sourceSize || time != entry.sourceTime))
+			return NULL;
+
+		return &entry;
+	}
+
+	return NULL;
+}
+
+bool TextureArchive::build(const std::string& path, const std::vector<std::string>& sources, const TextureCache& cache) {
+
+	std::vector<TextureArchiveEntry> archiveEntries;
+	std::vector<CompressedTexture> textures;
+
+	for (const std::string& source : sources) {
+
+		TextureArchiveEntry entry;
+		memset(&entry, 0, sizeof(entry));
+
+		CompressedTexture texture;
+
+		if (source.size() >= sizeof(entry.path) || !getSourceStamp(source, entry.sourceSize, entry.sourceTime) || !cache.load(source, texture)) {
+			std::cout << "ERROR::TEXTURE_ARCHIVE::FAILED_TO_COOK: " << source << "\n";
+			continue;
+		}
+
+		if (texture.getLevelCount() > ARCHIVE_MAX_LEVELS) {
+			std::cout << "ERROR::TEXTURE_ARCHIVE::TOO_MANY_LEVELS: " << source << "\n";
+			continue;
+		}
+
+		strcpy(entry.path, source.c_str());
+		entry.format = texture.format;
+		entry.width = texture.width;
+		entry.height = texture.height;
+		entry.levelCount = texture.getLevelCount();
+
+		archiveEntries.push_back(entry);
+		textures.push_back(std::move(texture));
+	}
+
+	// the data goes after the entries, each level on its own pages:
+	TextureArchiveHeader archiveHeader;
+	memcpy(archiveHeader.magic, "STXA", 4);
+	archiveHeader.version = TEXTURE_ARCHIVE_VERSION;
+	archiveHeader.entryCount = (uint32_t)archiveEntries.size();
+	archiveHeader.entryOffset = sizeof(TextureArchiveHeader);
+
+	std::size_t offset = sizeof(TextureArchiveHeader) + archiveEntries.size() * sizeof(TextureArchiveEntry);
+
+	for (std::size_t e = 0; e < archiveEntries.size(); e++) {
+		for (uint32_t level = 0; level < archiveEntries[e].levelCount; level++) {
+
+			offset = (offset + ARCHIVE_PAGE_SIZE - 1) / ARCHIVE_PAGE_SIZE * ARCHIVE_PAGE_SIZE;
+
+			archiveEntries[e].levelOffsets[level] = offset;
+			archiveEntries[e].levelSizes[level] = textures[e].levelSizes[level];
+
+			offset += textures[e].levelSizes[level];
+		}
+	}
+
+	std::string temporaryPath = path + ".tmp";
+	std::ofstream out(temporaryPath, std::ios::binary);
+
+	if (!out) {
+		std::cout << "ERROR::TEXTURE_ARCHIVE::FAILED_TO_WRITE: " << path << "\n";
+		return false;
+	}
+
+	out.write((const char*)&archiveHeader, sizeof(archiveHeader));
+	out.write((const char*)archiveEntries.data(), archiveEntries.size() * sizeof(TextureArchiveEntry));
+
+	for (std::size_t e = 0; e < archiveEntries.size(); e++) {
+		for (uint32_t level = 0; level < archiveEntries[e].levelCount; level++) {
+
+			// padding up to the level:
+			std::size_t position = (std::size_t)out.tellp();
+			std::vector<char> padding(archiveEntries[e].levelOffsets[level] - position, 0);
+			out.write(padding.data(), padding.size());
+
+			out.write((const char*)textures[e].data.data() + textures[e].levelOffsets[level], textures[e].levelSizes[level]);
+		}
+	}
+
+	out.close();
+
+	std::remove(path.c_str());
+
+	if (!out || std::rename(temporaryPath.c_str(), path.c_str()) != 0) {
+		std::cout << "ERROR::TEXTURE_ARCHIVE::FAILED_TO_WRITE: " << path << "\n";
+		std::remove(temporaryPath.c_str());
+		return false;
+	}
+
+	return true;
+}
+
+void uploadArchiveTexture(unsigned int texture, const TextureArchive& archive, const TextureArchiveEntry& entry, int firstLevel) {
+
+	GLenum format = getCompressedGLFormat((Compressed_Format)entry.format);
+
+	glBindTexture(GL_TEXTURE_2D, texture);
+
+	for (int level = firstLevel; level < (int)entry.levelCount; level++) {
+
+		int width = std::max((int)entry.width >> level, 1);
+		int height = std::max((int)entry.height >> level, 1);
+
+		glCompressedTexImage2D(GL_TEXTURE_2D, level, format, width, height, 0, (GLsizei)entry.levelSizes[level], archive.getLevelData(entry, level));
+	}
+
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_BASE_LEVEL, firstLevel);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAX_LEVEL, entry.levelCount - 1);
+}
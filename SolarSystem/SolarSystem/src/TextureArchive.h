@@ -0,0 +1,106 @@
+#pragma once
+
+#include "TextureCache.h"
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+
+// the archive --cook-textures writes and the application maps:
+const char* const TEXTURE_ARCHIVE_PATH = "res/cache/textures.pack";
+
+// everything in res/textures:
+extern const char* const SHIPPED_TEXTURES[];
+extern const int SHIPPED_TEXTURE_COUNT;
+
+const int ARCHIVE_MAX_LEVELS = 16;
+
+// size & modification time of a file without reading it, to tell if what was cooked from it is stale:
+bool getSourceStamp(const std::string& path, uint64_t& size, int64_t& time);
+
+
+// the layout of the file: header, entries, then the level data (every level starts on its own page)
+struct TextureArchiveHeader {
+	char magic[4];			// "STXA"
+	uint32_t version;
+	uint32_t entryCount;
+	uint32_t entryOffset;
+};
+
+struct TextureArchiveEntry {
+	char path[128];			// the source, as it was given to build()
+	uint64_t sourceSize;	// the source when it was cooked, a different one means it's stale
+	int64_t sourceTime;
+	uint32_t format;		// Compressed_Format
+	uint32_t width;
+	uint32_t height;
+	uint32_t levelCount;
+	uint64_t levelOffsets[ARCHIVE_MAX_LEVELS];	// from the start of the file
+	uint64_t levelSizes[ARCHIVE_MAX_LEVELS];
+};
+
+
+// a read only file mapped into memory, the pages are read by the os when they are first touched
+class MappedFile {
+
+public:
+
+	MappedFile() : data(NULL), size(0), file(NULL), mapping(NULL) {}
+	~MappedFile() { close(); }
+
+	MappedFile(const MappedFile&) = delete;
+	MappedFile& operator=(const MappedFile&) = delete;
+
+	bool open(const std::string& path);
+	void close();
+
+	const unsigned char* getData() const { return data; }
+	std::size_t getSize() const { return size; }
+
+private:
+
+	const unsigned char* data;
+	std::size_t size;
+
+	void* file;		// windows handles
+	void* mapping;
+};
+
+
+// all cooked textures in one mapped file, the uploads read straight from the mapping
+class TextureArchive {
+
+public:
+
+	TextureArchive() : header(NULL), entries(NULL) {}
+
+	// false if the file is missing or isn't an archive of this version:
+	bool open(const std::string& path);
+	void close();
+
+	bool isOpen() const { return header != NULL; }
+	unsigned int getEntryCount() const { return header ? header->entryCount : 0; }
+
+	// the entry of the source, NULL when it's not in the archive or the source changed since it was built:
+	const TextureArchiveEntry* find(const std::string& sourcePath) const;
+
+	const unsigned char* getLevelData(const TextureArchiveEntry& entry, int level) const { return file.getData() + entry.levelOffsets[level]; }
+
+	// writes the archive from the cooked textures of the cache (cooking the missing ones), no OpenGL needed
+	// the archive can't be open while it's rebuilt
+	static bool build(const std::string& path, const std::vector<std::string>& sources, const TextureCache& cache);
+
+private:
+
+	MappedFile file;
+	const TextureArchiveHeader* header;
+	const TextureArchiveEntry* entries;
+
+	// the levels are in the file & the path is terminated:
+	bool isEntryValid(const TextureArchiveEntry& entry) const;
+};
+
+// glCompressedTexImage2D of the levels from firstLevel on (GL_TEXTURE_BASE_LEVEL becomes firstLevel),
+// only the pages of those levels are read:
+void uploadArchiveTexture(unsigned int texture, const TextureArchive& archive, const TextureArchiveEntry& entry, int firstLevel = 0);
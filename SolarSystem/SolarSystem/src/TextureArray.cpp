@@ -0,0 +1,216 @@
+#include "TextureArray.h"
+#include "TextureMipmaps.h"
+#include "ThreadPool.h"
+
+#include "stb_image.h"
+
+#include <algorithm>
+#include <iostream>
+#include <cstdlib>
+
+
+static int nearestPowerOfTwo(int value) {
+
+	int power = 1;
+
+	while (power * 2 <= value)
+		power *= 2;
+
+	return value - power > 2 * power - value ? 2 * power : power;
+}
+
+TextureArray::TextureArray(int maxWidth) : maxWidth(maxWidth), layerCount(0), uploadedCount(0), decoding(0) {
+}
+
+TextureArray::~TextureArray() {
+	clear();
+}
+
+TextureArrayLayer TextureArray::add(const std::string& path) {
+
+	TextureArrayLayer result;
+	result.tier = -1;
+	result.layer = -1;
+
+	int width, height, fileChannels;
+
+	if (!stbi_info(path.c_str(), &width, &height, &fileChannels)) {
+		std::cout << "FAILED TO LOAD TEXTURE: " << path << "\n";
+		return result;
+	}
+
+	// the nearest power of two & the level of it with the size of the tier:
+	int fullWidth = nearestPowerOfTwo(width);
+	int fullHeight = nearestPowerOfTwo(height);
+	int firstLevel = 0;
+
+	while ((fullWidth >> firstLevel) > maxWidth)
+		firstLevel++;
+
+	int tierWidth = std::max(fullWidth >> firstLevel, 1);
+	int tierHeight = std::max(fullHeight >> firstLevel, 1);
+
+	for (unsigned int t = 0; t < tiers.size(); t++) {
+		if (tiers[t].width == tierWidth && tiers[t].height == tierHeight)
+			result.tier = t;
+	}
+
+	if (result.tier < 0) {
+
+		Tier tier;
+		tier.width = tierWidth;
+		tier.height = tierHeight;
+		tier.texture = 0;
+
+		result.tier = (int)tiers.size();
+		tiers.push_back(tier);
+	}
+
+	Tier& tier = tiers[result.tier];
+
+	if (tier.texture) {
+		std::cout << "ERROR::TEXTURE_ARRAY::TIER_ALREADY_CREATED: " << path << "\n";
+		result.tier = -1;
+		return result;
+	}
+
+	result.layer = (int)tier.paths.size();
+	tier.paths.push_back(path);
+	layerCount++;
+
+	{
+		std::lock_guard<std::mutex> lock(decodedMutex);
+		decoding++;
+	}
+
+	ThreadPool::getShared().enqueue([this, result, path, fullWidth, fullHeight, firstLevel]() {
+
+		DecodedLayer layer;
+		layer.layer = result;
+		layer.firstLevel = firstLevel;
+
+		if (decodeTextureImage(path, layer.image)) {
+			// the layers are all rgb, whatever the file has:
+			expandTextureImage(layer.image, 3);
+			resampleTextureImage(layer.image, fullWidth, fullHeight, true);
+			generateTextureMipmaps(layer.image, MIP_FILTER_KAISER, true);
+		}
+
+		std::lock_guard<std::mutex> lock(decodedMutex);
+		decoded.push_back(std::move(layer));
+		decoding--;
+		decodedCondition.notify_all();
+	});
+
+	return result;
+}
+
+void TextureArray::createTierTexture(Tier& tier) {
+
+	glGenTextures(1, &tier.texture);
+	glBindTexture(GL_TEXTURE_2D_ARRAY, tier.texture);
+
+	// like createTexture(true), the planets wrap around:
+	glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_WRAP_S, GL_REPEAT);
+	glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+	glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_MIN_FILTER, GL_LINEAR_MIPMAP_LINEAR);
+	glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+
+	int levelCount = getMipLevelCount(tier.width, tier.height);
+
+	for (int level = 0; level < levelCount; level++) {
+		glTexImage3D(GL_TEXTURE_2D_ARRAY, level, GL_RGB8, std::max(tier.width >> level, 1), std::max(tier.height >> level, 1),
+					 (GLsizei)tier.paths.size(), 0, GL_RGB, GL_UNSIGNED_BYTE, NULL);
+	}
+}
+
+void TextureArray::update(unsigned int layersPerFrame) {
+
+	for (unsigned int i = 0; i < layersPerFrame; i++) {
+
+		DecodedLayer layer;
+
+		{
+			std::lock_guard<std::mutex> lock(decodedMutex);
+
+			if (decoded.empty())
+				break;
+
+			layer = std::move(decoded.front());
+			decoded.pop_front();
+		}
+
+		Tier& tier = tiers[layer.layer.tier];
+		uploadedCount++;
+
+		if (!layer.image.pixels) {
+			std::cout << "FAILED TO LOAD TEXTURE: " << tier.paths[layer.layer.layer] << "\n";
+			continue;
+		}
+
+		if (!tier.texture)
+			createTierTexture(tier);
+
+		glBindTexture(GL_TEXTURE_2D_ARRAY, tier.texture);
+		glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
+
+		// the levels of the image from the one with the size of the tier:
+		int levelCount = getMipLevelCount(tier.width, tier.height);
+
+		for (int level = 0; level < levelCount; level++) {
+			glTexSubImage3D(GL_TEXTURE_2D_ARRAY, level, 0, 0, layer.layer.layer, std::max(tier.width >> level, 1), std::max(tier.height >> level, 1), 1,
+							GL_RGB, GL_UNSIGNED_BYTE, getTextureImageLevel(layer.image, layer.firstLevel + level));
+		}
+
+		glPixelStorei(GL_UNPACK_ALIGNMENT, 4);
+
+		freeTextureImage(layer.image);
+	}
+
+	glBindTexture(GL_TEXTURE_2D_ARRAY, 0);
+}
+
+void TextureArray::bind(int tier, int unit) const {
+	glActiveTexture(GL_TEXTURE0 + unit);
+	glBindTexture(GL_TEXTURE_2D_ARRAY, tiers[tier].texture);
+	glActiveTexture(GL_TEXTURE0);
+}
+
+std::size_t TextureArray::getMemorySize() const {
+
+	std::size_t size = 0;
+
+	for (const Tier& tier : tiers) {
+		if (tier.texture)
+			size += getTextureMemorySize(tier.width, tier.height, 3) * tier.paths.size();
+	}
+
+	return size;
+}
+
+void TextureArray::waitForWorkers() {
+
+	std::unique_lock<std::mutex> lock(decodedMutex);
+	decodedCondition.wait(lock, [this] { return decoding == 0; });
+}
+
+void TextureArray::clear() {
+
+	waitForWorkers();
+
+	for (DecodedLayer& layer : decoded) {
+		freeTextureImage(layer.image);
+	}
+
+	decoded.clear();
+
+	for (Tier& tier : tiers) {
+		if (tier.texture)
+			glDeleteTextures(1, &tier.texture);
+	}
+
+	tiers.clear();
+
+	layerCount = 0;
+	uploadedCount = 0;
+}
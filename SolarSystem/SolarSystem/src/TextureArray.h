@@ -0,0 +1,87 @@
+#pragma once
+
+#include "Texture.h"
+
+#include <string>
+#include <vector>
+#include <deque>
+#include <mutex>
+#include <condition_variable>
+
+
+// where a texture went in a TextureArray, tier -1 if it couldn't be added:
+struct TextureArrayLayer {
+	int tier;
+	int layer;
+};
+
+// packs the planet textures into GL_TEXTURE_2D_ARRAYs, one per size (tier), so the bodies that share a mesh & a tier
+// are drawn without binding a texture each: the shaders pick the layer from the body (BodyUniforms::params.x)
+// the sides are rounded to the nearest power of two & halved down to maxWidth, the layers are rgb8 with all
+// their mipmap levels (grey textures are expanded, alpha is dropped, the rings don't go in)
+// the textures are decoded on the shared ThreadPool, update() uploads them, needs a current OpenGL context
+class TextureArray {
+
+public:
+
+	explicit TextureArray(int maxWidth = 2048);
+	~TextureArray();
+
+	TextureArray(const TextureArray&) = delete;
+	TextureArray& operator=(const TextureArray&) = delete;
+
+	// reads the size from the header of the file & queues the texture, all of them before the first update()
+	// (a tier's array is created with the layers it has then):
+	TextureArrayLayer add(const std::string& path);
+
+	// uploads at most layersPerFrame of the decoded textures, once per frame:
+	void update(unsigned int layersPerFrame = 1);
+
+	// every layer is uploaded, until then the layers have no defined texels:
+	bool isReady() const { return uploadedCount == layerCount; }
+
+	// the array of the tier to the texture unit:
+	void bind(int tier, int unit) const;
+
+	int getTierCount() const { return (int)tiers.size(); }
+	int getTierWidth(int tier) const { return tiers[tier].width; }
+	int getTierHeight(int tier) const { return tiers[tier].height; }
+	int getLayerCount(int tier) const { return (int)tiers[tier].paths.size(); }
+	const std::string& getPath(const TextureArrayLayer& layer) const { return tiers[layer.tier].paths[layer.layer]; }
+	unsigned int getPendingCount() const { return layerCount - uploadedCount; }
+	std::size_t getMemorySize() const; // # of bytes of the arrays created so far
+
+	// waits for the workers & deletes the arrays, before the context goes:
+	void clear();
+
+private:
+
+	struct Tier {
+		int width;
+		int height;
+		unsigned int texture;	// 0 until the first upload
+		std::vector<std::string> paths;	// per layer
+	};
+
+	// a texture decoded by a worker, waiting for the render thread:
+	struct DecodedLayer {
+		TextureArrayLayer layer;
+		int firstLevel;	// of the image that has the size of the tier
+		TextureImage image;
+	};
+
+	int maxWidth;
+	std::vector<Tier> tiers;
+
+	unsigned int layerCount;
+	unsigned int uploadedCount;
+
+	// shared with the workers:
+	std::deque<DecodedLayer> decoded;
+	unsigned int decoding;
+	std::mutex decodedMutex;
+	std::condition_variable decodedCondition;
+
+	void createTierTexture(Tier& tier);
+	void waitForWorkers();
+};
@@ -0,0 +1,234 @@
+#include "TextureCache.h"
+#include "TextureMipmaps.h"
+
+#include <fstream>
+#include <iostream>
+#include <sstream>
+#include <iomanip>
+#include <thread>
+#include <cstdio>
+#include <cstring>
+
+#ifdef _WIN32
+#include <direct.h>
+#else
+#include <sys/stat.h>
+#endif
+
+
+// the parts of the DDS header the cache writes & reads:
+const uint32_t DDS_MAGIC = 0x20534444;				// "DDS "
+const uint32_t DDS_HEADER_SIZE = 124;
+const uint32_t DDS_PIXEL_FORMAT_SIZE = 32;
+const uint32_t DDSD_CAPS = 0x1, DDSD_HEIGHT = 0x2, DDSD_WIDTH = 0x4, DDSD_PIXELFORMAT = 0x1000, DDSD_MIPMAPCOUNT = 0x20000, DDSD_LINEARSIZE = 0x80000;
+const uint32_t DDPF_FOURCC = 0x4;
+const uint32_t DDSCAPS_COMPLEX = 0x8, DDSCAPS_TEXTURE = 0x1000, DDSCAPS_MIPMAP = 0x400000;
+const uint32_t FOURCC_DXT1 = 0x31545844;				// "DXT1"
+const uint32_t FOURCC_DXT5 = 0x35545844;				// "DXT5"
+
+
+uint64_t hashTextureSource(const std::string& path) {
+
+	std::ifstream file(path, std::ios::binary);
+
+	if (!file)
+		return 0;
+
+	uint64_t hash = 14695981039346656037ULL;
+
+	char buffer[65536];
+
+	while (file) {
+
+		file.read(buffer, sizeof(buffer));
+
+		for (std::streamsize i = 0; i < file.gcount(); i++) {
+			hash ^= (unsigned char)buffer[i];
+			hash *= 1099511628211ULL;
+		}
+	}
+
+	for (int k = 0; k < 4; k++) {
+		hash ^= (TEXTURE_COOKER_VERSION >> (8 * k)) & 0xFF;
+		hash *= 1099511628211ULL;
+	}
+
+	return hash;
+}
+
+void cookTexture(TextureImage& image, CompressedTexture& texture) {
+
+	if (image.mipmaps.empty())
+		generateTextureMipmaps(image, MIP_FILTER_KAISER, true);
+
+	texture.format = image.channels == 2 || image.channels == 4 ? COMPRESSED_BC3 : COMPRESSED_BC1;
+	texture.width = image.width;
+	texture.height = image.height;
+	texture.levelOffsets.clear();
+	texture.levelSizes.clear();
+	texture.data.clear();
+
+	// the compressor reads rgba:
+	expandTextureImage(image, 4);
+
+	int width = image.width, height = image.height;
+	int levelCount = getMipLevelCount(width, height);
+
+	std::vector<unsigned char> blocks;
+
+	for (int level = 0; level < levelCount; level++) {
+
+		compressImage(getTextureImageLevel(image, level), width, height, texture.format, blocks);
+
+		texture.levelOffsets.push_back(texture.data.size());
+		texture.levelSizes.push_back(blocks.size());
+		texture.data.insert(texture.data.end(), blocks.begin(), blocks.end());
+
+		width = std::max(width / 2, 1);
+		height = std::max(height / 2, 1);
+	}
+}
+
+bool writeDDS(const std::string& path, const CompressedTexture& texture) {
+
+	std::ofstream file(path, std::ios::binary);
+
+	if (!file)
+		return false;
+
+	uint32_t header[1 + DDS_HEADER_SIZE / 4] = {};
+
+	header[0] = DDS_MAGIC;
+	header[1] = DDS_HEADER_SIZE;
+	header[2] = DDSD_CAPS | DDSD_HEIGHT | DDSD_WIDTH | DDSD_PIXELFORMAT | DDSD_MIPMAPCOUNT | DDSD_LINEARSIZE;
+	header[3] = texture.height;
+	header[4] = texture.width;
+	header[5] = (uint32_t)texture.levelSizes[0];
+	header[7] = texture.getLevelCount();
+
+	// the pixel format starts at dword 19:
+	header[19] = DDS_PIXEL_FORMAT_SIZE;
+	header[20] = DDPF_FOURCC;
+	header[21] = texture.format == COMPRESSED_BC1 ? FOURCC_DXT1 : FOURCC_DXT5;
+
+	header[27] = DDSCAPS_COMPLEX | DDSCAPS_TEXTURE | DDSCAPS_MIPMAP;
+
+	file.write((const char*)header, sizeof(header));
+	file.write((const char*)texture.data.data(), texture.data.size());
+
+	return (bool)file;
+}
+
+bool readDDS(const std::string& path, CompressedTexture& texture) {
+
+	std::ifstream file(path, std::ios::binary);
+
+	if (!file)
+		return false;
+
+	uint32_t header[1 + DDS_HEADER_SIZE / 4];
+
+	if (!file.read((char*)header, sizeof(header)) || header[0] != DDS_MAGIC || header[1] != DDS_HEADER_SIZE || !(header[20] & DDPF_FOURCC))
+		return false;
+
+	if (header[21] == FOURCC_DXT1)
+		texture.format = COMPRESSED_BC1;
+	else if (header[21] == FOURCC_DXT5)
+		texture.format = COMPRESSED_BC3;
+	else
+		return false;
+
+	texture.height = header[3];
+	texture.width = header[4];
+
+	int levelCount = (header[2] & DDSD_MIPMAPCOUNT) && header[7] > 0 ? header[7] : 1;
+
+	texture.levelOffsets.clear();
+	texture.levelSizes.clear();
+
+	std::size_t size = 0;
+
+	for (int level = 0; level < levelCount; level++) {
+		texture.levelOffsets.push_back(size);
+		texture.levelSizes.push_back(getCompressedSize(texture.format, texture.getLevelWidth(level), texture.getLevelHeight(level)));
+		size += texture.levelSizes.back();
+	}
+
+	texture.data.resize(size);
+
+	return (bool)file.read((char*)texture.data.data(), size);
+}
+
+void uploadCompressedTexture(unsigned int texture, const CompressedTexture& compressed) {
+
+	GLenum format = getCompressedGLFormat(compressed.format);
+
+	glBindTexture(GL_TEXTURE_2D, texture);
+
+	for (int level = 0; level < compressed.getLevelCount(); level++) {
+		glCompressedTexImage2D(GL_TEXTURE_2D, level, format, compressed.getLevelWidth(level), compressed.getLevelHeight(level), 0,
+							   (GLsizei)compressed.levelSizes[level], compressed.data.data() + compressed.levelOffsets[level]);
+	}
+
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_BASE_LEVEL, 0);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAX_LEVEL, compressed.getLevelCount() - 1);
+}
+
+std::string TextureCache::getCookedPath(const std::string& sourcePath) const {
+
+	uint64_t hash = hashTextureSource(sourcePath);
+
+	if (hash == 0)
+		return "";
+
+	std::ostringstream path;
+	path << directory << "/" << std::hex << std::setw(16) << std::setfill('0') << hash << ".dds";
+
+	return path.str();
+}
+
+bool TextureCache::load(const std::string& sourcePath, CompressedTexture& texture, bool* cooked) const {
+
+	if (cooked)
+		*cooked = false;
+
+	std::string cookedPath = getCookedPath(sourcePath);
+
+	if (cookedPath.empty())
+		return false;
+
+	if (readDDS(cookedPath, texture))
+		return true;
+
+	TextureImage image;
+
+	if (!decodeTextureImage(sourcePath, image))
+		return false;
+
+	cookTexture(image, texture);
+	freeTextureImage(image);
+
+	if (cooked)
+		*cooked = true;
+
+#ifdef _WIN32
+	_mkdir(directory.c_str());
+#else
+	mkdir(directory.c_str(), 0755);
+#endif
+
+	// written under a name of its own first, so no one reads half a file:
+	std::ostringstream temporaryPath;
+	temporaryPath << cookedPath << "." << std::hash<std::thread::id>()(std::this_thread::get_id()) << ".tmp";
+
+	if (!writeDDS(temporaryPath.str(), texture) || std::rename(temporaryPath.str().c_str(), cookedPath.c_str()) != 0) {
+		std::cout << "ERROR::TEXTURE_CACHE::FAILED_TO_WRITE: " << cookedPath << "\n";
+		std::remove(temporaryPath.str().c_str());
+	}
+
+	return true;
+}
+
+bool TextureCache::isSupported() {
+	return GLEW_EXT_texture_compression_s3tc != 0;
+}
@@ -0,0 +1,68 @@
+#pragma once
+
+#include "Texture.h"
+#include "TextureCompressor.h"
+
+#include <algorithm>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+
+// a mipmapped, block compressed texture as the cache stores it (rows bottom up like TextureImage):
+struct CompressedTexture {
+
+	Compressed_Format format;
+	int width;
+	int height;
+	std::vector<std::size_t> levelOffsets;	// into data, level 0 first
+	std::vector<std::size_t> levelSizes;
+	std::vector<unsigned char> data;
+
+	int getLevelCount() const { return (int)levelSizes.size(); }
+	int getLevelWidth(int level) const { return std::max(width >> level, 1); }
+	int getLevelHeight(int level) const { return std::max(height >> level, 1); }
+};
+
+// part of the key, so files from an older cooker aren't used:
+const unsigned int TEXTURE_COOKER_VERSION = 3;
+
+// 64 bit FNV-1a of the file and the cooker version, 0 if the file can't be read:
+uint64_t hashTextureSource(const std::string& path);
+
+// compresses the image and all its mipmaps, BC3 when it has alpha, otherwise BC1 (no OpenGL needed)
+// the mipmaps are built into the image first if it has none, it is rgba afterwards:
+void cookTexture(TextureImage& image, CompressedTexture& texture);
+
+// DDS files with a DXT1 / DXT5 pixel format:
+bool writeDDS(const std::string& path, const CompressedTexture& texture);
+bool readDDS(const std::string& path, CompressedTexture& texture);
+
+// all levels with glCompressedTexImage2D:
+void uploadCompressedTexture(unsigned int texture, const CompressedTexture& compressed);
+
+
+// cooked textures in a directory, named by the hash of their source file so changed sources are cooked again
+// only the upload needs OpenGL, the textures can be cooked on machines without a gpu
+class TextureCache {
+
+public:
+
+	TextureCache(const std::string& directory = "res/cache") : directory(directory) {}
+
+	const std::string& getDirectory() const { return directory; }
+
+	// where the cooked file of the source goes, empty if the source can't be read:
+	std::string getCookedPath(const std::string& sourcePath) const;
+
+	// reads the cooked texture, cooks and writes it first when it isn't there yet
+	// safe on any thread, cooked tells if it had to be cooked
+	bool load(const std::string& sourcePath, CompressedTexture& texture, bool* cooked = NULL) const;
+
+	// the driver has to know the S3TC formats:
+	static bool isSupported();
+
+private:
+
+	std::string directory;
+};
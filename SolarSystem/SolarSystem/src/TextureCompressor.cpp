@@ -0,0 +1,355 @@
+#include "TextureCompressor.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+
+
+int getCompressedBlockSize(Compressed_Format format) {
+	return format == COMPRESSED_BC1 ? 8 : 16;
+}
+
+GLenum getCompressedGLFormat(Compressed_Format format) {
+	return format == COMPRESSED_BC1 ? GL_COMPRESSED_RGB_S3TC_DXT1_EXT : GL_COMPRESSED_RGBA_S3TC_DXT5_EXT;
+}
+
+std::size_t getCompressedSize(Compressed_Format format, int width, int height) {
+	return (std::size_t)((width + 3) / 4) * ((height + 3) / 4) * getCompressedBlockSize(format);
+}
+
+// 5:6:5 colors & back, the expanded values are what the gpu interpolates:
+static unsigned short packColor565(const float* color) {
+
+	int r = (int)(std::min(std::max(color[0], 0.0f), 255.0f) * 31.0f / 255.0f + 0.5f);
+	int g = (int)(std::min(std::max(color[1], 0.0f), 255.0f) * 63.0f / 255.0f + 0.5f);
+	int b = (int)(std::min(std::max(color[2], 0.0f), 255.0f) * 31.0f / 255.0f + 0.5f);
+
+	return (unsigned short)((r << 11) | (g << 5) | b);
+}
+
+static void unpackColor565(unsigned short color, int* out) {
+
+	int r = (color >> 11) & 31;
+	int g = (color >> 5) & 63;
+	int b = color & 31;
+
+	out[0] = (r << 3) | (r >> 2);
+	out[1] = (g << 2) | (g >> 4);
+	out[2] = (b << 3) | (b >> 2);
+}
+
+// the 4 colors of a block in 4 color mode, index 2 & 3 are at 1/3 & 2/3 from color0 to color1:
+static void buildPaletteBC1(unsigned short c0, unsigned short c1, int palette[4][3]) {
+
+	unpackColor565(c0, palette[0]);
+	unpackColor565(c1, palette[1]);
+
+	for (int k = 0; k < 3; k++) {
+		palette[2][k] = (2 * palette[0][k] + palette[1][k]) / 3;
+		palette[3][k] = (palette[0][k] + 2 * palette[1][k]) / 3;
+	}
+}
+
+// the closest palette entry for every pixel, returns the squared error of the block:
+static int fitIndicesBC1(const unsigned char* pixels, unsigned short c0, unsigned short c1, uint32_t& indices) {
+
+	int palette[4][3];
+	buildPaletteBC1(c0, c1, palette);
+
+	indices = 0;
+	int error = 0;
+
+	for (int i = 0; i < 16; i++) {
+
+		const unsigned char* p = pixels + 4 * i;
+
+		int best = 0, bestDistance = 0x7FFFFFFF;
+
+		for (int e = 0; e < 4; e++) {
+
+			int dr = p[0] - palette[e][0];
+			int dg = p[1] - palette[e][1];
+			int db = p[2] - palette[e][2];
+			int distance = dr * dr + dg * dg + db * db;
+
+			if (distance < bestDistance) {
+				bestDistance = distance;
+				best = e;
+			}
+		}
+
+		indices |= (uint32_t)best << (2 * i);
+		error += bestDistance;
+	}
+
+	return error;
+}
+
+void compressBlockBC1(const unsigned char* pixels, unsigned char* out) {
+
+	// the endpoints go on the principal axis of the colors:
+	float mean[3] = { 0.0f, 0.0f, 0.0f };
+
+	for (int i = 0; i < 16; i++)
+		for (int k = 0; k < 3; k++)
+			mean[k] += pixels[4 * i + k] / 16.0f;
+
+	float covariance[3][3] = {};
+
+	for (int i = 0; i < 16; i++) {
+
+		float d[3] = { pixels[4 * i] - mean[0], pixels[4 * i + 1] - mean[1], pixels[4 * i + 2] - mean[2] };
+
+		for (int a = 0; a < 3; a++)
+			for (int b = 0; b < 3; b++)
+				covariance[a][b] += d[a] * d[b];
+	}
+
+	// power iteration:
+	float axis[3] = { 1.0f, 1.0f, 1.0f };
+
+	for (int iteration = 0; iteration < 8; iteration++) {
+
+		float next[3];
+
+		for (int a = 0; a < 3; a++)
+			next[a] = covariance[a][0] * axis[0] + covariance[a][1] * axis[1] + covariance[a][2] * axis[2];
+
+		float length = sqrtf(next[0] * next[0] + next[1] * next[1] + next[2] * next[2]);
+
+		// a flat block, any axis will do:
+		if (length < 1e-6f)
+			break;
+
+		for (int a = 0; a < 3; a++)
+			axis[a] = next[a] / length;
+	}
+
+	float minT = 0.0f, maxT = 0.0f;
+
+	for (int i = 0; i < 16; i++) {
+
+		float t = (pixels[4 * i] - mean[0]) * axis[0] + (pixels[4 * i + 1] - mean[1]) * axis[1] + (pixels[4 * i + 2] - mean[2]) * axis[2];
+
+		minT = std::min(minT, t);
+		maxT = std::max(maxT, t);
+	}
+
+	float end0[3], end1[3];
+
+	for (int k = 0; k < 3; k++) {
+		end0[k] = mean[k] + maxT * axis[k];
+		end1[k] = mean[k] + minT * axis[k];
+	}
+
+	unsigned short c0 = packColor565(end0);
+	unsigned short c1 = packColor565(end1);
+
+	uint32_t indices;
+	int error = fitIndicesBC1(pixels, c0, c1, indices);
+
+	// one least squares pass for the endpoints with the indices found:
+	const float weights[4] = { 1.0f, 0.0f, 2.0f / 3.0f, 1.0f / 3.0f };
+
+	float alpha2 = 0.0f, beta2 = 0.0f, alphaBeta = 0.0f;
+	float alphaX[3] = {}, betaX[3] = {};
+
+	for (int i = 0; i < 16; i++) {
+
+		float a = weights[(indices >> (2 * i)) & 3];
+		float b = 1.0f - a;
+
+		alpha2 += a * a;
+		beta2 += b * b;
+		alphaBeta += a * b;
+
+		for (int k = 0; k < 3; k++) {
+			alphaX[k] += a * pixels[4 * i + k];
+			betaX[k] += b * pixels[4 * i + k];
+		}
+	}
+
+	float determinant = alpha2 * beta2 - alphaBeta * alphaBeta;
+
+	if (fabsf(determinant) > 1e-6f) {
+
+		for (int k = 0; k < 3; k++) {
+			end0[k] = (alphaX[k] * beta2 - betaX[k] * alphaBeta) / determinant;
+			end1[k] = (betaX[k] * alpha2 - alphaX[k] * alphaBeta) / determinant;
+		}
+
+		unsigned short refined0 = packColor565(end0);
+		unsigned short refined1 = packColor565(end1);
+
+		uint32_t refinedIndices;
+		int refinedError = fitIndicesBC1(pixels, refined0, refined1, refinedIndices);
+
+		if (refinedError < error) {
+			c0 = refined0;
+			c1 = refined1;
+			indices = refinedIndices;
+		}
+	}
+
+	// color0 > color1 means 4 colors, swapping the endpoints swaps index 0 with 1 and 2 with 3:
+	if (c0 < c1) {
+		std::swap(c0, c1);
+		indices ^= 0x55555555;
+	}
+	// with equal endpoints index 3 would be black:
+	else if (c0 == c1) {
+		indices = 0;
+	}
+
+	out[0] = c0 & 0xFF;
+	out[1] = c0 >> 8;
+	out[2] = c1 & 0xFF;
+	out[3] = c1 >> 8;
+
+	for (int k = 0; k < 4; k++)
+		out[4 + k] = (indices >> (8 * k)) & 0xFF;
+}
+
+// the alpha half of a BC3 block, 8 interpolated values between the largest & smallest alpha:
+static void compressAlphaBlock(const unsigned char* pixels, unsigned char* out) {
+
+	int a0 = 0, a1 = 255;
+
+	for (int i = 0; i < 16; i++) {
+		a0 = std::max(a0, (int)pixels[4 * i + 3]);
+		a1 = std::min(a1, (int)pixels[4 * i + 3]);
+	}
+
+	int palette[8] = { a0, a1 };
+
+	for (int k = 2; k < 8; k++)
+		palette[k] = ((8 - k) * a0 + (k - 1) * a1) / 7;
+
+	uint64_t indices = 0;
+
+	for (int i = 0; i < 16 && a0 != a1; i++) {
+
+		int best = 0, bestDistance = 256;
+
+		for (int e = 0; e < 8; e++) {
+
+			int distance = abs(pixels[4 * i + 3] - palette[e]);
+
+			if (distance < bestDistance) {
+				bestDistance = distance;
+				best = e;
+			}
+		}
+
+		indices |= (uint64_t)best << (3 * i);
+	}
+
+	out[0] = (unsigned char)a0;
+	out[1] = (unsigned char)a1;
+
+	for (int k = 0; k < 6; k++)
+		out[2 + k] = (indices >> (8 * k)) & 0xFF;
+}
+
+void compressBlockBC3(const unsigned char* pixels, unsigned char* out) {
+	compressAlphaBlock(pixels, out);
+	compressBlockBC1(pixels, out + 8);
+}
+
+void compressImage(const unsigned char* rgba, int width, int height, Compressed_Format format, std::vector<unsigned char>& out) {
+
+	int blockSize = getCompressedBlockSize(format);
+
+	out.resize(getCompressedSize(format, width, height));
+
+	unsigned char* block = out.data();
+	unsigned char pixels[64];
+
+	for (int by = 0; by < height; by += 4) {
+		for (int bx = 0; bx < width; bx += 4) {
+
+			for (int y = 0; y < 4; y++) {
+				for (int x = 0; x < 4; x++) {
+
+					const unsigned char* source = rgba + 4 * ((std::size_t)std::min(by + y, height - 1) * width + std::min(bx + x, width - 1));
+
+					for (int k = 0; k < 4; k++)
+						pixels[4 * (4 * y + x) + k] = source[k];
+				}
+			}
+
+			if (format == COMPRESSED_BC1)
+				compressBlockBC1(pixels, block);
+			else
+				compressBlockBC3(pixels, block);
+
+			block += blockSize;
+		}
+	}
+}
+
+void decompressImage(const unsigned char* blocks, int width, int height, Compressed_Format format, std::vector<unsigned char>& rgba) {
+
+	int blockSize = getCompressedBlockSize(format);
+
+	rgba.resize((std::size_t)width * height * 4);
+
+	for (int by = 0; by < height; by += 4) {
+		for (int bx = 0; bx < width; bx += 4, blocks += blockSize) {
+
+			const unsigned char* color = format == COMPRESSED_BC1 ? blocks : blocks + 8;
+
+			unsigned short c0 = color[0] | (color[1] << 8);
+			unsigned short c1 = color[2] | (color[3] << 8);
+			uint32_t indices = color[4] | (color[5] << 8) | (color[6] << 16) | ((uint32_t)color[7] << 24);
+
+			int palette[4][3];
+			buildPaletteBC1(c0, c1, palette);
+
+			// 3 colors & black:
+			bool threeColors = format == COMPRESSED_BC1 && c0 <= c1;
+
+			if (threeColors) {
+				for (int k = 0; k < 3; k++) {
+					palette[2][k] = (palette[0][k] + palette[1][k]) / 2;
+					palette[3][k] = 0;
+				}
+			}
+
+			int alphas[8] = { 255, 255, 255, 255, 255, 255, 255, 255 };
+			uint64_t alphaIndices = 0;
+
+			if (format == COMPRESSED_BC3) {
+
+				alphas[0] = blocks[0];
+				alphas[1] = blocks[1];
+
+				for (int k = 2; k < 8; k++) {
+					if (alphas[0] > alphas[1])
+						alphas[k] = ((8 - k) * alphas[0] + (k - 1) * alphas[1]) / 7;
+					else
+						alphas[k] = k == 6 ? 0 : k == 7 ? 255 : ((6 - k) * alphas[0] + (k - 1) * alphas[1]) / 5;
+				}
+
+				for (int k = 0; k < 6; k++)
+					alphaIndices |= (uint64_t)blocks[2 + k] << (8 * k);
+			}
+
+			for (int i = 0; i < 16; i++) {
+
+				int x = bx + i % 4, y = by + i / 4;
+
+				if (x >= width || y >= height)
+					continue;
+
+				int index = (indices >> (2 * i)) & 3;
+				unsigned char* pixel = &rgba[4 * ((std::size_t)y * width + x)];
+
+				pixel[0] = (unsigned char)palette[index][0];
+				pixel[1] = (unsigned char)palette[index][1];
+				pixel[2] = (unsigned char)palette[index][2];
+				pixel[3] = (unsigned char)(threeColors && index == 3 ? 0 : alphas[(alphaIndices >> (3 * i)) & 7]);
+			}
+		}
+	}
+}
@@ -0,0 +1,30 @@
+#pragma once
+
+#include <GL/glew.h>
+
+#include <cstddef>
+#include <vector>
+
+
+// block compressed formats the cooked textures use:
+enum Compressed_Format {
+	COMPRESSED_BC1,		// rgb, 8 bytes per 4x4 block (GL_COMPRESSED_RGB_S3TC_DXT1_EXT)
+	COMPRESSED_BC3		// rgba, 16 bytes per 4x4 block (GL_COMPRESSED_RGBA_S3TC_DXT5_EXT)
+};
+
+int getCompressedBlockSize(Compressed_Format format);
+GLenum getCompressedGLFormat(Compressed_Format format);
+
+// # of bytes of a width x height image in the format (the edges are padded to whole blocks):
+std::size_t getCompressedSize(Compressed_Format format, int width, int height);
+
+// cpu encoders, no OpenGL needed
+// the 16 pixels are rgba, row by row:
+void compressBlockBC1(const unsigned char* pixels, unsigned char* out);
+void compressBlockBC3(const unsigned char* pixels, unsigned char* out);
+
+// compresses a whole rgba image, the blocks over the edges repeat the last row / column:
+void compressImage(const unsigned char* rgba, int width, int height, Compressed_Format format, std::vector<unsigned char>& out);
+
+// back to rgba, to measure the quality of the encoder:
+void decompressImage(const unsigned char* blocks, int width, int height, Compressed_Format format, std::vector<unsigned char>& rgba);
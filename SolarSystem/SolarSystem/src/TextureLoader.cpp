@@ -0,0 +1,340 @@
+#include "TextureLoader.h"
+#include "ThreadPool.h"
+#include "TextureMipmaps.h"
+
+#include <chrono>
+#include <iostream>
+#include <iomanip>
+#include <algorithm>
+
+
+// uploads per frame without the streamer, each one is a glTexImage2D of every level of a whole image:
+const unsigned int MAX_TEXTURE_UPLOADS = 2;
+
+
+static double elapsedMs(std::chrono::high_resolution_clock::time_point start) {
+	return std::chrono::duration<double, std::milli>(std::chrono::high_resolution_clock::now() - start).count();
+}
+
+TextureLoader::TextureLoader(std::size_t uploadBudget) : cache(NULL), archive(NULL), keepLevels(false), streaming(uploadBudget > 0), streamer(uploadBudget > 0 ? uploadBudget : 1), decoding(0) {
+}
+
+TextureLoader::~TextureLoader() {
+	clear();
+}
+
+unsigned int TextureLoader::load(const std::string& path, bool wrap) {
+
+	auto found = byPath.find(path);
+
+	if (found != byPath.end())
+		return textures[found->second].ID;
+
+	TextureInfo info;
+	info.path = path;
+	info.ID = createTexture(wrap);
+	info.wrap = wrap;
+	info.loaded = false;
+	info.failed = false;
+	info.width = 0;
+	info.height = 0;
+	info.channels = 0;
+	info.compressed = false;
+	info.gpuSize = 0;
+	info.decodeMs = 0.0;
+	info.uploadMs = 0.0;
+
+	const TextureArchiveEntry* entry = archive ? archive->find(path) : NULL;
+
+	// already cooked & mapped, only the driver copies:
+	if (entry) {
+
+		auto start = std::chrono::high_resolution_clock::now();
+		uploadArchiveTexture(info.ID, *archive, *entry);
+		info.uploadMs = elapsedMs(start);
+
+		info.width = entry->width;
+		info.height = entry->height;
+		info.channels = entry->format == COMPRESSED_BC3 ? 4 : 3;
+		info.compressed = true;
+		info.loaded = true;
+
+		for (uint32_t level = 0; level < entry->levelCount; level++)
+			info.gpuSize += entry->levelSizes[level];
+
+		byPath[path] = (unsigned int)textures.size();
+		textures.push_back(info);
+		levels.push_back(TextureLevels());
+		levels.back().entry = entry;
+		levels.back().image.pixels = NULL;
+
+		return info.ID;
+	}
+
+	uploadPlaceholderImage(info.ID);
+
+	unsigned int index = (unsigned int)textures.size();
+	textures.push_back(info);
+	levels.push_back(TextureLevels());
+	levels.back().entry = NULL;
+	levels.back().image.pixels = NULL;
+	byPath[path] = index;
+
+	{
+		std::lock_guard<std::mutex> lock(decodedMutex);
+		decoding++;
+	}
+
+	const TextureCache* cache = this->cache;
+
+	ThreadPool::getShared().enqueue([this, index, path, wrap, cache]() {
+
+		DecodedImage result;
+		result.index = index;
+		result.image.pixels = NULL;
+		result.isCompressed = false;
+
+		auto start = std::chrono::high_resolution_clock::now();
+
+		// the first time the cache cooks it here too:
+		if (cache)
+			result.isCompressed = cache->load(path, result.compressed);
+		else if (decodeTextureImage(path, result.image))
+			generateTextureMipmaps(result.image, MIP_FILTER_KAISER, wrap);
+
+		result.decodeMs = elapsedMs(start);
+
+		std::lock_guard<std::mutex> lock(decodedMutex);
+		decoded.push_back(std::move(result));
+		decoding--;
+		decodedCondition.notify_all();
+	});
+
+	return info.ID;
+}
+
+void TextureLoader::update() {
+
+	// the streamer keeps to its byte budget, everything decoded can go to it:
+	for (unsigned int i = 0; streaming || i < MAX_TEXTURE_UPLOADS; i++) {
+
+		DecodedImage result;
+
+		{
+			std::lock_guard<std::mutex> lock(decodedMutex);
+
+			if (decoded.empty())
+				break;
+
+			result = std::move(decoded.front());
+			decoded.pop_front();
+		}
+
+		TextureInfo& info = textures[result.index];
+		info.decodeMs = result.decodeMs;
+
+		if (result.isCompressed) {
+
+			auto start = std::chrono::high_resolution_clock::now();
+			uploadCompressedTexture(info.ID, result.compressed);
+			info.uploadMs = elapsedMs(start);
+
+			info.width = result.compressed.width;
+			info.height = result.compressed.height;
+			info.channels = result.compressed.format == COMPRESSED_BC3 ? 4 : 3;
+			info.compressed = true;
+			info.gpuSize = result.compressed.data.size();
+			info.loaded = true;
+
+			if (keepLevels)
+				levels[result.index].compressed = std::move(result.compressed);
+
+			continue;
+		}
+
+		if (!result.image.pixels) {
+			info.failed = true;
+			std::cout << "FAILED TO LOAD TEXTURE: " << info.path << "\n";
+			continue;
+		}
+
+		info.width = result.image.width;
+		info.height = result.image.height;
+		info.channels = result.image.channels;
+		info.gpuSize = getTextureMemorySize(info.width, info.height, info.channels);
+
+		if (streaming) {
+
+			unsigned int index = result.index;
+
+			bool keep = keepLevels;
+
+			streamer.stream(info.ID, std::move(result.image), [this, index, keep](double uploadMs, TextureImage& image) {
+				textures[index].uploadMs = uploadMs;
+				textures[index].loaded = true;
+
+				if (keep) {
+					levels[index].image = std::move(image);
+					image.pixels = NULL;
+				}
+			});
+
+			continue;
+		}
+
+		auto start = std::chrono::high_resolution_clock::now();
+		uploadTextureImage(info.ID, result.image);
+		info.uploadMs = elapsedMs(start);
+		info.loaded = true;
+
+		if (keepLevels)
+			levels[result.index].image = std::move(result.image);
+		else
+			freeTextureImage(result.image);
+	}
+
+	if (streaming) {
+		streamer.update();
+	}
+
+	glBindTexture(GL_TEXTURE_2D, 0);
+}
+
+void TextureLoader::waitAll() {
+
+	while (getPendingCount() > 0) {
+
+		// the streamer still has work without new images:
+		if (streamer.getQueuedCount() == 0) {
+			std::unique_lock<std::mutex> lock(decodedMutex);
+			decodedCondition.wait(lock, [this] { return !decoded.empty() || decoding == 0; });
+		}
+
+		update();
+	}
+}
+
+unsigned int TextureLoader::getPendingCount() const {
+
+	unsigned int pending = 0;
+
+	for (const TextureInfo& info : textures) {
+		if (!info.loaded && !info.failed)
+			pending++;
+	}
+
+	return pending;
+}
+
+void TextureLoader::printInfo() const {
+
+	std::cout << "===== Textures =====\n"
+		<< std::left << std::setw(40) << "path" << std::right
+		<< std::setw(12) << "size" << std::setw(10) << "channels" << std::setw(8) << "format" << std::setw(10) << "KB"
+		<< std::setw(13) << "decode ms" << std::setw(13) << "upload ms" << "\n";
+
+	double decodeTotal = 0.0, uploadTotal = 0.0;
+	std::size_t sizeTotal = 0;
+
+	for (const TextureInfo& info : textures) {
+
+		std::string size = info.failed ? "failed" : std::to_string(info.width) + "x" + std::to_string(info.height);
+
+		std::cout << std::left << std::setw(40) << info.path << std::right
+			<< std::setw(12) << size << std::setw(10) << info.channels
+			<< std::setw(8) << (info.compressed ? (info.channels == 4 ? "bc3" : "bc1") : getTextureFormatName(getTextureInternalFormat(info.channels, false))) << std::setw(10) << info.gpuSize / 1024
+			<< std::setw(13) << std::fixed << std::setprecision(2) << info.decodeMs
+			<< std::setw(13) << info.uploadMs << "\n";
+
+		decodeTotal += info.decodeMs;
+		uploadTotal += info.uploadMs;
+		sizeTotal += info.gpuSize;
+	}
+
+	std::cout << std::left << std::setw(70) << "total" << std::right << std::setw(10) << sizeTotal / 1024
+		<< std::setw(13) << decodeTotal << std::setw(13) << uploadTotal << "\n" << std::endl;
+}
+
+std::size_t TextureLoader::getLevelSize(unsigned int index, int level) const {
+
+	const TextureInfo& info = textures[index];
+
+	int width = std::max(info.width >> level, 1);
+	int height = std::max(info.height >> level, 1);
+
+	if (info.compressed)
+		return getCompressedSize(info.channels == 4 ? COMPRESSED_BC3 : COMPRESSED_BC1, width, height);
+
+	return (std::size_t)width * height * info.channels;
+}
+
+bool TextureLoader::uploadLevel(unsigned int index, int level) const {
+
+	const TextureInfo& info = textures[index];
+	const TextureLevels& kept = levels[index];
+
+	int width = std::max(info.width >> level, 1);
+	int height = std::max(info.height >> level, 1);
+
+	glBindTexture(GL_TEXTURE_2D, info.ID);
+
+	if (kept.entry) {
+		glCompressedTexImage2D(GL_TEXTURE_2D, level, getCompressedGLFormat((Compressed_Format)kept.entry->format), width, height, 0,
+							   (GLsizei)kept.entry->levelSizes[level], archive->getLevelData(*kept.entry, level));
+		return true;
+	}
+
+	if (!kept.compressed.data.empty()) {
+		glCompressedTexImage2D(GL_TEXTURE_2D, level, getCompressedGLFormat(kept.compressed.format), width, height, 0,
+							   (GLsizei)kept.compressed.levelSizes[level], kept.compressed.data.data() + kept.compressed.levelOffsets[level]);
+		return true;
+	}
+
+	if (!kept.image.pixels || (level > 0 && kept.image.mipmaps.empty()))
+		return false;
+
+	glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
+	glTexImage2D(GL_TEXTURE_2D, level, getTextureInternalFormat(kept.image), width, height, 0, getTextureImageFormat(kept.image),
+				 GL_UNSIGNED_BYTE, getTextureImageLevel(kept.image, level));
+	glPixelStorei(GL_UNPACK_ALIGNMENT, 4);
+
+	return true;
+}
+
+bool TextureLoader::canUploadLevels(unsigned int index) const {
+
+	const TextureLevels& kept = levels[index];
+
+	return kept.entry || !kept.compressed.data.empty() || (kept.image.pixels && !kept.image.mipmaps.empty());
+}
+
+void TextureLoader::clear() {
+
+	waitForWorkers();
+
+	streamer.clear();
+
+	for (DecodedImage& result : decoded) {
+		freeTextureImage(result.image);
+	}
+
+	decoded.clear();
+
+	for (TextureInfo& info : textures) {
+		glDeleteTextures(1, &info.ID);
+	}
+
+	for (TextureLevels& kept : levels) {
+		freeTextureImage(kept.image);
+	}
+
+	textures.clear();
+	levels.clear();
+	byPath.clear();
+}
+
+void TextureLoader::waitForWorkers() {
+
+	std::unique_lock<std::mutex> lock(decodedMutex);
+	decodedCondition.wait(lock, [this] { return decoding == 0; });
+}
@@ -0,0 +1,124 @@
+#pragma once
+
+#include "Texture.h"
+#include "TextureStreamer.h"
+#include "TextureCache.h"
+#include "TextureArchive.h"
+
+#include <string>
+#include <vector>
+#include <deque>
+#include <map>
+#include <mutex>
+#include <condition_variable>
+
+
+// what the loader knows about one of its textures:
+struct TextureInfo {
+	std::string path;
+	unsigned int ID;	// usable from the start, shows the placeholder until the image is uploaded
+	bool wrap;
+	bool loaded;
+	bool failed;
+	int width;
+	int height;
+	int channels;
+	bool compressed;	// from the TextureCache
+	std::size_t gpuSize;	// # of bytes of all levels
+	double decodeMs;	// on the worker, with the mipmaps (reading the cooked file for compressed textures)
+	double uploadMs;	// on the render thread (the time to submit, the driver may still be copying)
+};
+
+// the levels of a loaded texture in system memory, to upload them again after they were dropped from VRAM
+// (at most one of them is set):
+struct TextureLevels {
+	const TextureArchiveEntry* entry;	// mapped from the archive, always there
+	CompressedTexture compressed;	// from the cache, only with setKeepLevels()
+	TextureImage image;	// decoded with its mipmaps, only with setKeepLevels()
+};
+
+
+// loads textures in the background: the files are decoded & their mipmaps built on ThreadPool::getShared() and
+// update() uploads the finished images on the render thread, through the TextureStreamer within
+// uploadBudget bytes per frame, or a few whole images per frame when the budget is 0
+// needs a current OpenGL context
+class TextureLoader {
+
+public:
+
+	TextureLoader(std::size_t uploadBudget = 4 * 1024 * 1024);
+	~TextureLoader();
+
+	TextureLoader(const TextureLoader&) = delete;
+	TextureLoader& operator=(const TextureLoader&) = delete;
+
+	// compressed textures from the cache instead of decoding the files, before the first load()
+	// (NULL to go back to decoding):
+	void setCache(const TextureCache* cache) { this->cache = cache; }
+
+	// textures found in the archive are uploaded straight from its mapping in load(), no worker needed:
+	void setArchive(const TextureArchive* archive) { this->archive = archive; }
+
+	// keeps the levels of the textures loaded from now on in system memory, so uploadLevel() works for them too
+	// (the archived ones don't need it):
+	void setKeepLevels(bool keep) { keepLevels = keep; }
+
+	// starts loading the file and returns its texture right away, the same path gives the same texture:
+	unsigned int load(const std::string& path, bool wrap);
+
+	// uploads the images decoded since the last call, once per frame:
+	void update();
+
+	const TextureStreamer& getStreamer() const { return streamer; }
+
+	// blocks until every texture requested so far is uploaded (or failed):
+	void waitAll();
+
+	// # of textures still decoding or waiting for the upload:
+	unsigned int getPendingCount() const;
+
+	const std::vector<TextureInfo>& getTextures() const { return textures; }
+
+	// # of bytes of a level of a loaded texture:
+	std::size_t getLevelSize(unsigned int index, int level) const;
+
+	// puts a level of a loaded texture back into it, false if the loader has no copy of it:
+	bool uploadLevel(unsigned int index, int level) const;
+	bool canUploadLevels(unsigned int index) const;
+
+	// decode & upload time of every texture:
+	void printInfo() const;
+
+	// deletes the textures (waits for the workers first):
+	void clear();
+
+private:
+
+	// an image decoded by a worker, waiting for the render thread:
+	struct DecodedImage {
+		unsigned int index;
+		TextureImage image;
+		bool isCompressed;
+		CompressedTexture compressed;
+		double decodeMs;
+	};
+
+	std::vector<TextureInfo> textures;
+	std::vector<TextureLevels> levels;	// same index as textures
+	std::map<std::string, unsigned int> byPath; // path -> index in textures
+
+	const TextureCache* cache;
+	const TextureArchive* archive;
+
+	bool keepLevels;
+	bool streaming;
+	TextureStreamer streamer;
+
+	// shared with the workers:
+	std::deque<DecodedImage> decoded;
+	unsigned int decoding;
+	std::mutex decodedMutex;
+	std::condition_variable decodedCondition;
+
+	void waitForWorkers();
+};
@@ -0,0 +1,445 @@
+#include "TextureMipmaps.h"
+
+#include <algorithm>
+#include <cstdlib>
+#include <cmath>
+#include <vector>
+
+#if defined(_M_X64) || defined(__x86_64__) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2) || defined(__SSE2__)
+#define MIP_SSE
+#include <immintrin.h>
+#endif
+
+#if defined(_MSC_VER)
+#include <intrin.h>
+#define MIP_TARGET_AVX2
+#else
+#define MIP_TARGET_AVX2 __attribute__((target("avx2")))
+#endif
+
+
+const int MAX_MIP_TAPS = 8;
+
+// samples left & right of a row the horizontal pass may read:
+const int MIP_ROW_PADDING = 8;
+
+const double KAISER_ALPHA = 4.0;
+const double KAISER_HALF_WIDTH = 4.0;
+
+// 1D filter: output texel x is the sum of weights[k] * input[2x + first + k]
+struct MipTaps {
+	int count;
+	int first;
+	float weights[MAX_MIP_TAPS];
+};
+
+// modified Bessel function of order 0, the series converges quickly for the alpha we use:
+static double besselI0(double x) {
+
+	double sum = 1.0, term = 1.0;
+
+	for (int k = 1; k < 32; k++) {
+		term *= (x / (2.0 * k)) * (x / (2.0 * k));
+		sum += term;
+	}
+
+	return sum;
+}
+
+static MipTaps getMipTaps(Mip_Filter filter) {
+
+	MipTaps taps;
+
+	if (filter == MIP_FILTER_BOX) {
+		taps.count = 2;
+		taps.first = 0;
+		taps.weights[0] = 0.5f;
+		taps.weights[1] = 0.5f;
+		return taps;
+	}
+
+	// sinc at half the frequency, windowed over 4 input texels on each side of the output center (2x + 0.5):
+	const double PI = acos(-1.0);
+
+	taps.count = MAX_MIP_TAPS;
+	taps.first = 1 - MAX_MIP_TAPS / 2;
+
+	double weights[MAX_MIP_TAPS], sum = 0.0;
+
+	for (int k = 0; k < taps.count; k++) {
+
+		double d = taps.first + k - 0.5;
+		double t = d / KAISER_HALF_WIDTH;
+
+		double sinc = sin(PI * d / 2.0) / (PI * d / 2.0);
+		double window = besselI0(KAISER_ALPHA * sqrt(std::max(1.0 - t * t, 0.0))) / besselI0(KAISER_ALPHA);
+
+		weights[k] = sinc * window;
+		sum += weights[k];
+	}
+
+	for (int k = 0; k < taps.count; k++)
+		taps.weights[k] = (float)(weights[k] / sum);
+
+	return taps;
+}
+
+// sRGB <-> linear, 8 bit in & 12 bit steps back, enough to round to the nearest 8 bit value:
+const int LINEAR_STEPS = 4096;
+
+struct SrgbTables {
+
+	float toLinear[256];
+	unsigned char toSrgb[LINEAR_STEPS];
+
+	SrgbTables() {
+
+		for (int i = 0; i < 256; i++) {
+			double c = i / 255.0;
+			toLinear[i] = (float)(c <= 0.04045 ? c / 12.92 : pow((c + 0.055) / 1.055, 2.4));
+		}
+
+		for (int i = 0; i < LINEAR_STEPS; i++) {
+			double l = (double)i / (LINEAR_STEPS - 1);
+			double c = l <= 0.0031308 ? l * 12.92 : 1.055 * pow(l, 1.0 / 2.4) - 0.055;
+			toSrgb[i] = (unsigned char)(c * 255.0 + 0.5);
+		}
+	}
+};
+
+static const SrgbTables& getSrgbTables() {
+	static const SrgbTables tables;
+	return tables;
+}
+
+
+// filter passes, each kernel adds the taps in the same order so the results are the same:
+
+
+// out[x] = sum of weights[k] * rows[k][x]:
+static void filterColumnsScalar(const float* const* rows, const MipTaps& taps, int x, int width, float* out) {
+
+	for (; x < width; x++) {
+
+		float sum = 0.0f;
+
+		for (int k = 0; k < taps.count; k++)
+			sum += taps.weights[k] * rows[k][x];
+
+		out[x] = sum;
+	}
+}
+
+// out[x] = sum of weights[k] * row[2x + first + k], the row is padded:
+static void filterRowScalar(const float* row, const MipTaps& taps, int x, int outWidth, float* out) {
+
+	for (; x < outWidth; x++) {
+
+		float sum = 0.0f;
+
+		for (int k = 0; k < taps.count; k++)
+			sum += taps.weights[k] * row[2 * x + taps.first + k];
+
+		out[x] = sum;
+	}
+}
+
+#ifdef MIP_SSE
+
+static void filterColumnsSSE(const float* const* rows, const MipTaps& taps, int width, float* out) {
+
+	int x = 0;
+
+	for (; x + 4 <= width; x += 4) {
+
+		__m128 sum = _mm_setzero_ps();
+
+		for (int k = 0; k < taps.count; k++)
+			sum = _mm_add_ps(sum, _mm_mul_ps(_mm_set1_ps(taps.weights[k]), _mm_loadu_ps(rows[k] + x)));
+
+		_mm_storeu_ps(out + x, sum);
+	}
+
+	filterColumnsScalar(rows, taps, x, width, out);
+}
+
+static void filterRowSSE(const float* row, const MipTaps& taps, int outWidth, float* out) {
+
+	int x = 0;
+
+	for (; x + 4 <= outWidth; x += 4) {
+
+		__m128 sum = _mm_setzero_ps();
+
+		for (int k = 0; k < taps.count; k++) {
+
+			const float* p = row + 2 * x + taps.first + k;
+
+			// every second input texel:
+			__m128 even = _mm_shuffle_ps(_mm_loadu_ps(p), _mm_loadu_ps(p + 4), _MM_SHUFFLE(2, 0, 2, 0));
+
+			sum = _mm_add_ps(sum, _mm_mul_ps(_mm_set1_ps(taps.weights[k]), even));
+		}
+
+		_mm_storeu_ps(out + x, sum);
+	}
+
+	filterRowScalar(row, taps, x, outWidth, out);
+}
+
+MIP_TARGET_AVX2
+static void filterColumnsAVX2(const float* const* rows, const MipTaps& taps, int width, float* out) {
+
+	int x = 0;
+
+	for (; x + 8 <= width; x += 8) {
+
+		__m256 sum = _mm256_setzero_ps();
+
+		for (int k = 0; k < taps.count; k++)
+			sum = _mm256_add_ps(sum, _mm256_mul_ps(_mm256_set1_ps(taps.weights[k]), _mm256_loadu_ps(rows[k] + x)));
+
+		_mm256_storeu_ps(out + x, sum);
+	}
+
+	filterColumnsScalar(rows, taps, x, width, out);
+}
+
+MIP_TARGET_AVX2
+static void filterRowAVX2(const float* row, const MipTaps& taps, int outWidth, float* out) {
+
+	int x = 0;
+
+	for (; x + 8 <= outWidth; x += 8) {
+
+		__m256 sum = _mm256_setzero_ps();
+
+		for (int k = 0; k < taps.count; k++) {
+
+			const float* p = row + 2 * x + taps.first + k;
+
+			// the shuffle works on 128 bit halves (a0 a2 b0 b2 | a4 a6 b4 b6), the permute puts them in order:
+			__m256 even = _mm256_shuffle_ps(_mm256_loadu_ps(p), _mm256_loadu_ps(p + 8), _MM_SHUFFLE(2, 0, 2, 0));
+			even = _mm256_castpd_ps(_mm256_permute4x64_pd(_mm256_castps_pd(even), _MM_SHUFFLE(3, 1, 2, 0)));
+
+			sum = _mm256_add_ps(sum, _mm256_mul_ps(_mm256_set1_ps(taps.weights[k]), even));
+		}
+
+		_mm256_storeu_ps(out + x, sum);
+	}
+
+	filterRowScalar(row, taps, x, outWidth, out);
+}
+
+static bool cpuSupportsAVX2() {
+#if defined(_MSC_VER)
+	int info[4];
+	__cpuid(info, 1);
+	bool osxsave = (info[2] & (1 << 27)) != 0;
+	bool avx = (info[2] & (1 << 28)) != 0;
+
+	if (!osxsave || !avx || (_xgetbv(0) & 6) != 6)
+		return false;
+
+	__cpuidex(info, 7, 0);
+	return (info[1] & (1 << 5)) != 0;
+#else
+	return __builtin_cpu_supports("avx2");
+#endif
+}
+
+#endif
+
+Mip_Kernel getBestMipKernel() {
+#ifdef MIP_SSE
+	static const Mip_Kernel best = cpuSupportsAVX2() ? MIP_KERNEL_AVX2 : MIP_KERNEL_SSE;
+	return best;
+#else
+	return MIP_KERNEL_SCALAR;
+#endif
+}
+
+static void filterColumns(const float* const* rows, const MipTaps& taps, int width, float* out, Mip_Kernel kernel) {
+#ifdef MIP_SSE
+	if (kernel == MIP_KERNEL_AVX2)
+		return filterColumnsAVX2(rows, taps, width, out);
+	if (kernel == MIP_KERNEL_SSE)
+		return filterColumnsSSE(rows, taps, width, out);
+#endif
+	filterColumnsScalar(rows, taps, 0, width, out);
+}
+
+static void filterRow(const float* row, const MipTaps& taps, int outWidth, float* out, Mip_Kernel kernel) {
+#ifdef MIP_SSE
+	if (kernel == MIP_KERNEL_AVX2)
+		return filterRowAVX2(row, taps, outWidth, out);
+	if (kernel == MIP_KERNEL_SSE)
+		return filterRowSSE(row, taps, outWidth, out);
+#endif
+	filterRowScalar(row, taps, 0, outWidth, out);
+}
+
+// half the size of one channel, the rows first & then the columns of each row:
+static void downsamplePlane(const float* source, int width, int height, const MipTaps& taps, bool wrap, Mip_Kernel kernel,
+	std::vector<float>& columns, std::vector<float>& padded, std::vector<float>& out) {
+
+	int outWidth = std::max(width / 2, 1);
+	int outHeight = std::max(height / 2, 1);
+
+	columns.resize((std::size_t)width * outHeight);
+	padded.resize((std::size_t)width + 2 * MIP_ROW_PADDING);
+	out.resize((std::size_t)outWidth * outHeight);
+
+	const float* rows[MAX_MIP_TAPS];
+
+	for (int y = 0; y < outHeight; y++) {
+
+		for (int k = 0; k < taps.count; k++) {
+			int row = std::min(std::max(2 * y + taps.first + k, 0), height - 1);
+			rows[k] = source + (std::size_t)row * width;
+		}
+
+		filterColumns(rows, taps, width, &columns[(std::size_t)y * width], kernel);
+	}
+
+	for (int y = 0; y < outHeight; y++) {
+
+		const float* row = &columns[(std::size_t)y * width];
+
+		std::copy(row, row + width, &padded[MIP_ROW_PADDING]);
+
+		for (int x = 0; x < MIP_ROW_PADDING; x++) {
+			padded[MIP_ROW_PADDING - 1 - x] = row[wrap ? width - 1 - x % width : 0];
+			padded[MIP_ROW_PADDING + width + x] = row[wrap ? x % width : width - 1];
+		}
+
+		filterRow(&padded[MIP_ROW_PADDING], taps, outWidth, &out[(std::size_t)y * outWidth], kernel);
+	}
+}
+
+void generateTextureMipmaps(TextureImage& image, Mip_Filter filter, bool wrap, Mip_Kernel kernel) {
+
+	// a kernel the cpu can't run falls back to the best one it can:
+	if (kernel == MIP_KERNEL_AUTO || kernel > getBestMipKernel())
+		kernel = getBestMipKernel();
+
+	int channels = image.channels;
+	int levelCount = getMipLevelCount(image.width, image.height);
+
+	// levels 1.. back to back:
+	std::size_t size = getTextureMemorySize(image.width, image.height, channels) - (std::size_t)image.width * image.height * channels;
+
+	image.mipmaps.resize(size);
+
+	if (levelCount < 2)
+		return;
+
+	const SrgbTables& tables = getSrgbTables();
+	const MipTaps taps = getMipTaps(filter);
+
+	std::vector<float> level, smaller, columns, padded;
+
+	// one channel at a time keeps a single float copy of level 0:
+	for (int k = 0; k < channels; k++) {
+
+		bool alpha = (channels == 2 || channels == 4) && k == channels - 1;
+
+		int width = image.width, height = image.height;
+		std::size_t pixelCount = (std::size_t)width * height;
+
+		level.resize(pixelCount);
+
+		for (std::size_t p = 0; p < pixelCount; p++) {
+			unsigned char value = image.pixels[p * channels + k];
+			level[p] = alpha ? value / 255.0f : tables.toLinear[value];
+		}
+
+		unsigned char* destination = image.mipmaps.data();
+
+		for (int l = 1; l < levelCount; l++) {
+
+			downsamplePlane(level.data(), width, height, taps, wrap, kernel, columns, padded, smaller);
+			level.swap(smaller);
+
+			width = std::max(width / 2, 1);
+			height = std::max(height / 2, 1);
+			pixelCount = (std::size_t)width * height;
+
+			// back to 8 bits, the Kaiser lobes can go a little past 0 & 1:
+			for (std::size_t p = 0; p < pixelCount; p++) {
+
+				float value = std::min(std::max(level[p], 0.0f), 1.0f);
+
+				destination[p * channels + k] = alpha ? (unsigned char)(value * 255.0f + 0.5f)
+					: tables.toSrgb[(int)(value * (LINEAR_STEPS - 1) + 0.5f)];
+			}
+
+			destination += pixelCount * channels;
+		}
+	}
+}
+
+void resampleTextureImage(TextureImage& image, int width, int height, bool wrap) {
+
+	if (image.width == width && image.height == height)
+		return;
+
+	const SrgbTables& tables = getSrgbTables();
+	int channels = image.channels;
+
+	unsigned char* pixels = allocateTexturePixels((std::size_t)width * height * channels);
+
+	float scaleX = (float)image.width / width;
+	float scaleY = (float)image.height / height;
+
+	for (int y = 0; y < height; y++) {
+
+		float sourceY = (y + 0.5f) * scaleY - 0.5f;
+		int y0 = (int)floor(sourceY);
+		float fy = sourceY - y0;
+
+		const unsigned char* row0 = image.pixels + (std::size_t)std::min(std::max(y0, 0), image.height - 1) * image.width * channels;
+		const unsigned char* row1 = image.pixels + (std::size_t)std::min(std::max(y0 + 1, 0), image.height - 1) * image.width * channels;
+
+		for (int x = 0; x < width; x++) {
+
+			float sourceX = (x + 0.5f) * scaleX - 0.5f;
+			int x0 = (int)floor(sourceX);
+			float fx = sourceX - x0;
+
+			int x1 = x0 + 1;
+
+			if (wrap) {
+				x0 = (x0 + image.width) % image.width;
+				x1 = x1 % image.width;
+			}
+			else {
+				x0 = std::max(x0, 0);
+				x1 = std::min(x1, image.width - 1);
+			}
+
+			for (int k = 0; k < channels; k++) {
+
+				bool alpha = (channels == 2 || channels == 4) && k == channels - 1;
+
+				const unsigned char texels[4] = { row0[x0 * channels + k], row0[x1 * channels + k], row1[x0 * channels + k], row1[x1 * channels + k] };
+				float values[4];
+
+				for (int t = 0; t < 4; t++)
+					values[t] = alpha ? texels[t] / 255.0f : tables.toLinear[texels[t]];
+
+				float value = (values[0] * (1.0f - fx) + values[1] * fx) * (1.0f - fy) + (values[2] * (1.0f - fx) + values[3] * fx) * fy;
+				value = std::min(std::max(value, 0.0f), 1.0f);
+
+				pixels[((std::size_t)y * width + x) * channels + k] = alpha ? (unsigned char)(value * 255.0f + 0.5f)
+					: tables.toSrgb[(int)(value * (LINEAR_STEPS - 1) + 0.5f)];
+			}
+		}
+	}
+
+	freeTextureImage(image);
+
+	image.pixels = pixels;
+	image.width = width;
+	image.height = height;
+}
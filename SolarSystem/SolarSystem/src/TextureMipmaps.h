@@ -0,0 +1,30 @@
+#pragma once
+
+#include "Texture.h"
+
+
+// filters for the mipmap levels, both work in linear space (the color channels of the files are sRGB):
+enum Mip_Filter {
+	MIP_FILTER_BOX,		// 2x2 average, what glGenerateMipmap does on most drivers
+	MIP_FILTER_KAISER	// 8 tap Kaiser windowed sinc, keeps the detail the box blurs without aliasing
+};
+
+// kernels of the filter passes, MIP_KERNEL_AUTO picks the widest one the cpu supports
+// (they all give the same results):
+enum Mip_Kernel {
+	MIP_KERNEL_AUTO,
+	MIP_KERNEL_SCALAR,
+	MIP_KERNEL_SSE,		// 4 texels per iteration (SSE2)
+	MIP_KERNEL_AVX2		// 8 texels per iteration
+};
+
+Mip_Kernel getBestMipKernel();
+
+// builds levels 1.. of the image into image.mipmaps, safe on any thread (the texture workers call it after decoding)
+// wrap: the columns wrap around like on the spheres, otherwise the edges are clamped (rows are always clamped):
+void generateTextureMipmaps(TextureImage& image, Mip_Filter filter = MIP_FILTER_KAISER, bool wrap = true,
+	Mip_Kernel kernel = MIP_KERNEL_AUTO);
+
+// scales level 0 of the image to width x height with a bilinear filter in linear space & drops its mipmaps, safe on any
+// thread (meant for sizes within a factor of two, further down the mipmap levels are the better filter):
+void resampleTextureImage(TextureImage& image, int width, int height, bool wrap = true);
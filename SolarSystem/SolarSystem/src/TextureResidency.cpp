@@ -0,0 +1,232 @@
+#include "TextureResidency.h"
+
+#include <algorithm>
+#include <cmath>
+
+
+TextureResidency::TextureResidency(TextureLoader& loader, std::size_t budget, std::size_t uploadBudget)
+	: loader(loader), budget(budget), uploadBudget(uploadBudget), externalSize(0), frame(0), residentSize(0), fullSize(0), lastFrameDrops(0), lastFrameUploadSize(0) {
+}
+
+void TextureResidency::request(unsigned int texture, float texelWidth) {
+
+	// the largest request of the frame wins:
+	auto found = requests.find(texture);
+
+	if (found == requests.end() || found->second < texelWidth)
+		requests[texture] = texelWidth;
+}
+
+int TextureResidency::getNeededLevel(int width, int levelCount, float texelWidth) {
+
+	if (texelWidth <= 0.0f)
+		return levelCount - 1;
+
+	int level = (int)floor(log2(width / texelWidth));
+
+	return std::min(std::max(level, 0), levelCount - 1);
+}
+
+float TextureResidency::getSphereTexelWidth(float projectedRadius) {
+	// at the center of the disk a pixel covers 1 / (2 pi r) of the equator:
+	return 2.0f * 3.14159265f * projectedRadius;
+}
+
+unsigned int TextureResidency::getDroppedLevelCount() const {
+
+	unsigned int count = 0;
+
+	for (const ResidentTexture& resident : residents)
+		count += resident.firstLevel;
+
+	return count;
+}
+
+void TextureResidency::update() {
+
+	frame++;
+	lastFrameDrops = 0;
+	lastFrameUploadSize = 0;
+
+	registerTextures();
+
+	// mark the levels the bodies need this frame:
+	for (const auto& request : requests) {
+
+		auto found = byID.find(request.first);
+
+		if (found == byID.end())
+			continue;
+
+		ResidentTexture& resident = residents[found->second];
+
+		if (!resident.managed)
+			continue;
+
+		resident.neededLevel = getNeededLevel(loader.getTextures()[found->second].width, resident.levelCount, request.second);
+
+		for (int level = resident.neededLevel; level < resident.levelCount; level++)
+			resident.levelUsed[level] = frame;
+	}
+
+	requests.clear();
+
+	// the needed levels that were dropped go back in first:
+	std::size_t uploaded = 0;
+
+	for (unsigned int i = 0; i < residents.size(); i++) {
+
+		ResidentTexture& resident = residents[i];
+
+		if (resident.managed && resident.firstLevel > resident.neededLevel && resident.levelUsed[resident.neededLevel] == frame)
+			restore(i, resident, uploaded);
+	}
+
+	lastFrameUploadSize = uploaded;
+
+	// the levels finer than needed that weren't asked for in a while:
+	for (unsigned int i = 0; i < residents.size(); i++) {
+
+		ResidentTexture& resident = residents[i];
+
+		while (resident.managed && resident.firstLevel < resident.neededLevel && resident.firstLevel <= resident.lastDroppable
+			&& resident.levelUsed[resident.firstLevel] + RESIDENCY_UNUSED_FRAMES < frame) {
+			dropFinestLevel(i, resident);
+			lastFrameDrops++;
+		}
+	}
+
+	// then the least recently used levels make room, the ones needed this frame stay even over budget:
+	while (residentSize + externalSize > budget && dropLeastRecentlyUsed())
+		lastFrameDrops++;
+
+	glBindTexture(GL_TEXTURE_2D, 0);
+}
+
+void TextureResidency::registerTextures() {
+
+	const std::vector<TextureInfo>& textures = loader.getTextures();
+
+	while (residents.size() < textures.size()) {
+
+		ResidentTexture resident;
+		resident.managed = false;
+		resident.levelCount = 0;
+		resident.firstLevel = 0;
+		resident.lastDroppable = -1;
+		resident.neededLevel = 0;
+
+		byID[textures[residents.size()].ID] = (unsigned int)residents.size();
+		residents.push_back(resident);
+	}
+
+	for (unsigned int i = 0; i < residents.size(); i++) {
+
+		ResidentTexture& resident = residents[i];
+		const TextureInfo& info = textures[i];
+
+		if (resident.levelCount > 0 || !info.loaded)
+			continue;
+
+		// the loader uploaded all levels:
+		resident.levelCount = getMipLevelCount(info.width, info.height);
+		resident.neededLevel = resident.levelCount - 1;
+		resident.levelSizes.resize(resident.levelCount);
+		resident.levelUsed.assign(resident.levelCount, 0);
+
+		for (int level = 0; level < resident.levelCount; level++) {
+
+			resident.levelSizes[level] = loader.getLevelSize(i, level);
+			residentSize += resident.levelSizes[level];
+			fullSize += resident.levelSizes[level];
+
+			if (std::max(info.width >> level, 1) > RESIDENCY_MIN_LEVEL_WIDTH)
+				resident.lastDroppable = level;
+		}
+
+		resident.lastDroppable = std::min(resident.lastDroppable, resident.levelCount - 2);
+		resident.managed = loader.canUploadLevels(i);
+	}
+}
+
+void TextureResidency::restore(unsigned int index, ResidentTexture& resident, std::size_t& uploaded) {
+
+	// coarse to fine, a level at least each frame even if it's bigger than the budget:
+	while (resident.firstLevel > resident.neededLevel && (uploaded == 0 || uploaded + resident.levelSizes[resident.firstLevel - 1] <= uploadBudget)) {
+
+		int level = resident.firstLevel - 1;
+
+		if (!loader.uploadLevel(index, level)) {
+			resident.managed = false;
+			break;
+		}
+
+		uploaded += resident.levelSizes[level];
+		residentSize += resident.levelSizes[level];
+		resident.firstLevel = level;
+	}
+
+	glBindTexture(GL_TEXTURE_2D, loader.getTextures()[index].ID);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_BASE_LEVEL, resident.firstLevel);
+}
+
+bool TextureResidency::dropLeastRecentlyUsed() {
+
+	int best = -1;
+
+	for (unsigned int i = 0; i < residents.size(); i++) {
+
+		const ResidentTexture& resident = residents[i];
+
+		if (!resident.managed || resident.firstLevel > resident.lastDroppable)
+			continue;
+
+		if (best < 0) {
+			best = i;
+			continue;
+		}
+
+		const ResidentTexture& other = residents[best];
+
+		unsigned long long used = resident.levelUsed[resident.firstLevel];
+		unsigned long long otherUsed = other.levelUsed[other.firstLevel];
+
+		// on a tie the bigger level goes first:
+		if (used < otherUsed || (used == otherUsed && resident.levelSizes[resident.firstLevel] > other.levelSizes[other.firstLevel]))
+			best = i;
+	}
+
+	if (best < 0)
+		return false;
+
+	ResidentTexture& resident = residents[best];
+
+	if (resident.levelUsed[resident.firstLevel] == frame)
+		return false;
+
+	dropFinestLevel(best, resident);
+
+	return true;
+}
+
+void TextureResidency::dropFinestLevel(unsigned int index, ResidentTexture& resident) {
+
+	// a level below GL_TEXTURE_BASE_LEVEL doesn't count for completeness, an empty image frees its memory:
+	glBindTexture(GL_TEXTURE_2D, loader.getTextures()[index].ID);
+	glTexImage2D(GL_TEXTURE_2D, resident.firstLevel, GL_RGBA8, 0, 0, 0, GL_RGBA, GL_UNSIGNED_BYTE, NULL);
+
+	residentSize -= resident.levelSizes[resident.firstLevel];
+	resident.firstLevel++;
+
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_BASE_LEVEL, resident.firstLevel);
+}
+
+void TextureResidency::clear() {
+
+	residents.clear();
+	byID.clear();
+	requests.clear();
+
+	residentSize = 0;
+	fullSize = 0;
+}
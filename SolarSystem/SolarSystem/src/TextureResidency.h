@@ -0,0 +1,89 @@
+#pragma once
+
+#include "TextureLoader.h"
+
+#include <map>
+#include <vector>
+
+
+// levels at most this wide always stay in VRAM, so every texture has something to show:
+const int RESIDENCY_MIN_LEVEL_WIDTH = 64;
+
+// levels finer than the bodies need are dropped after this many frames without a request, even under budget:
+const unsigned long long RESIDENCY_UNUSED_FRAMES = 120;
+
+// keeps only the levels of a TextureLoader's textures the bodies need, within a VRAM budget: the bodies ask for the
+// levels their screen size needs each frame, finer levels nobody asked for in RESIDENCY_UNUSED_FRAMES are dropped
+// (the finest first, GL_TEXTURE_BASE_LEVEL moves past them), over budget the least recently used levels go right away,
+// and they are uploaded again from the loader when they are needed
+// textures the loader has no copy of (not archived & loaded before setKeepLevels()) are never dropped
+// needs a current OpenGL context
+class TextureResidency {
+
+public:
+
+	// uploadBudget: # of bytes uploaded again per frame at most (one level is always let through):
+	TextureResidency(TextureLoader& loader, std::size_t budget, std::size_t uploadBudget = 4 * 1024 * 1024);
+
+	void setBudget(std::size_t budget) { this->budget = budget; }
+	std::size_t getBudget() const { return budget; }
+
+	// VRAM of textures this doesn't manage (the texture arrays), it counts against the budget too:
+	void setExternalSize(std::size_t size) { externalSize = size; }
+	std::size_t getExternalSize() const { return externalSize; }
+
+	// the texture is drawn this frame and needs texelWidth texels across its level 0 width to be sharp:
+	void request(unsigned int texture, float texelWidth);
+
+	// drops & uploads levels for the requests since the last call, once per frame after TextureLoader::update():
+	void update();
+
+	// the finest level that still has texelWidth texels across:
+	static int getNeededLevel(int width, int levelCount, float texelWidth);
+
+	// texels across a sphere texture for a body projectedRadius pixels big (the equator goes around the width once):
+	static float getSphereTexelWidth(float projectedRadius);
+
+	std::size_t getResidentSize() const { return residentSize; }
+	std::size_t getFullSize() const { return fullSize; } // of the same textures with all their levels
+	unsigned int getTextureCount() const { return (unsigned int)residents.size(); }
+	unsigned int getDroppedLevelCount() const;
+	unsigned int getLastFrameDrops() const { return lastFrameDrops; }
+	std::size_t getLastFrameUploadSize() const { return lastFrameUploadSize; }
+
+	// forgets the textures, before the loader clears them:
+	void clear();
+
+private:
+
+	struct ResidentTexture {
+		bool managed;	// loaded & the loader can upload its levels again
+		int levelCount;	// 0 until the texture is loaded
+		int firstLevel;	// the finest level in VRAM, GL_TEXTURE_BASE_LEVEL
+		int lastDroppable;	// the levels after it are at most RESIDENCY_MIN_LEVEL_WIDTH wide
+		int neededLevel;	// from the last request
+		std::vector<std::size_t> levelSizes;
+		std::vector<unsigned long long> levelUsed;	// frame each level was needed last, 0: never
+	};
+
+	TextureLoader& loader;
+
+	std::size_t budget;
+	std::size_t uploadBudget;
+	std::size_t externalSize;
+
+	std::vector<ResidentTexture> residents;	// same index as the loader's textures
+	std::map<unsigned int, unsigned int> byID; // texture -> index
+	std::map<unsigned int, float> requests;	// texture -> texel width, since the last update()
+
+	unsigned long long frame;
+	std::size_t residentSize;
+	std::size_t fullSize;
+	unsigned int lastFrameDrops;
+	std::size_t lastFrameUploadSize;
+
+	void registerTextures();
+	void restore(unsigned int index, ResidentTexture& resident, std::size_t& uploaded);
+	bool dropLeastRecentlyUsed();
+	void dropFinestLevel(unsigned int index, ResidentTexture& resident);
+};
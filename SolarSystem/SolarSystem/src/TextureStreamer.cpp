@@ -0,0 +1,252 @@
+#include "TextureStreamer.h"
+
+#include <chrono>
+#include <cstring>
+
+
+static double elapsedMs(std::chrono::high_resolution_clock::time_point start) {
+	return std::chrono::duration<double, std::milli>(std::chrono::high_resolution_clock::now() - start).count();
+}
+
+TextureStreamer::TextureStreamer(std::size_t frameBudget) {
+	this->frameBudget = frameBudget;
+	this->lastFrameBytes = 0;
+	this->current = 0;
+	this->persistent = false;
+	this->created = false;
+
+	for (unsigned int b = 0; b < STREAM_RING_SIZE; b++) {
+		buffers[b] = 0;
+		fences[b] = 0;
+		mapped[b] = NULL;
+	}
+}
+
+TextureStreamer::~TextureStreamer() {
+	clear();
+}
+
+void TextureStreamer::createBuffers() {
+
+	persistent = GLEW_ARB_buffer_storage != 0;
+
+	glGenBuffers(STREAM_RING_SIZE, buffers);
+
+	for (unsigned int b = 0; b < STREAM_RING_SIZE; b++) {
+
+		glBindBuffer(GL_PIXEL_UNPACK_BUFFER, buffers[b]);
+
+		if (persistent) {
+			// mapped once, the fences keep the writes away from what the gpu still reads:
+			GLbitfield flags = GL_MAP_WRITE_BIT | GL_MAP_PERSISTENT_BIT | GL_MAP_COHERENT_BIT;
+			glBufferStorage(GL_PIXEL_UNPACK_BUFFER, frameBudget, NULL, flags);
+			mapped[b] = (unsigned char*)glMapBufferRange(GL_PIXEL_UNPACK_BUFFER, 0, frameBudget, flags);
+		}
+		else {
+			glBufferData(GL_PIXEL_UNPACK_BUFFER, frameBudget, NULL, GL_STREAM_DRAW);
+		}
+	}
+
+	glBindBuffer(GL_PIXEL_UNPACK_BUFFER, 0);
+
+	created = true;
+}
+
+void TextureStreamer::stream(unsigned int texture, TextureImage image, std::function<void(double uploadMs, TextureImage& image)> done) {
+
+	StreamJob job;
+	job.texture = texture;
+	job.image = std::move(image);
+	job.nextRow = 0;
+	job.direct = false;
+	job.uploadMs = 0.0;
+	job.done = done;
+
+	jobs.push_back(std::move(job));
+}
+
+void TextureStreamer::update() {
+
+	lastFrameBytes = 0;
+
+	if (jobs.empty())
+		return;
+
+	if (!created) {
+		createBuffers();
+	}
+
+	auto start = std::chrono::high_resolution_clock::now();
+
+	unsigned int b = current;
+	current = (current + 1) % STREAM_RING_SIZE;
+
+	// written STREAM_RING_SIZE frames ago, normally long done:
+	if (fences[b]) {
+		glClientWaitSync(fences[b], GL_SYNC_FLUSH_COMMANDS_BIT, 1000000000);
+		glDeleteSync(fences[b]);
+		fences[b] = 0;
+	}
+
+	glBindBuffer(GL_PIXEL_UNPACK_BUFFER, buffers[b]);
+
+	unsigned char* destination = persistent ? mapped[b] :
+		(unsigned char*)glMapBufferRange(GL_PIXEL_UNPACK_BUFFER, 0, frameBudget, GL_MAP_WRITE_BIT | GL_MAP_INVALIDATE_BUFFER_BIT);
+
+	// copy as many rows as fit, front to back:
+	bands.clear();
+	std::size_t used = 0;
+
+	for (std::size_t j = 0; j < jobs.size() && destination; j++) {
+
+		StreamJob& job = jobs[j];
+
+		std::size_t rowSize = (std::size_t)job.image.width * job.image.channels;
+		int rowCount = (int)std::min<std::size_t>(job.image.height - job.nextRow, (frameBudget - used) / rowSize);
+
+		if (rowCount == 0)
+			break;
+
+		Band band = { j, job.nextRow, rowCount, used };
+		bands.push_back(band);
+
+		memcpy(destination + used, job.image.pixels + job.nextRow * rowSize, rowCount * rowSize);
+
+		used += rowCount * rowSize;
+		job.nextRow += rowCount;
+
+		if (job.nextRow < job.image.height)
+			break;
+	}
+
+	if (!persistent && destination) {
+		glUnmapBuffer(GL_PIXEL_UNPACK_BUFFER);
+	}
+
+	double copyMs = elapsedMs(start);
+
+	// the rows are tightly packed in the buffer:
+	glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
+
+	for (const Band& band : bands) {
+
+		auto bandStart = std::chrono::high_resolution_clock::now();
+
+		StreamJob& job = jobs[band.job];
+
+		if (band.firstRow == 0) {
+			glBindBuffer(GL_PIXEL_UNPACK_BUFFER, 0);
+			begin(job);
+			glBindBuffer(GL_PIXEL_UNPACK_BUFFER, buffers[b]);
+		}
+
+		GLenum format = getTextureImageFormat(job.image);
+
+		glBindTexture(GL_TEXTURE_2D, job.texture);
+		glTexSubImage2D(GL_TEXTURE_2D, 0, 0, band.firstRow, job.image.width, band.rowCount, format, GL_UNSIGNED_BYTE, (const void*)band.offset);
+
+		job.uploadMs += elapsedMs(bandStart) + copyMs * (band.rowCount * job.image.width * job.image.channels) / used;
+	}
+
+	glBindBuffer(GL_PIXEL_UNPACK_BUFFER, 0);
+	glPixelStorei(GL_UNPACK_ALIGNMENT, 4);
+
+	if (!bands.empty()) {
+		fences[b] = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+	}
+
+	lastFrameBytes = used;
+
+	// a single row bigger than the budget goes the direct way:
+	if (bands.empty()) {
+
+		StreamJob& job = jobs.front();
+
+		auto directStart = std::chrono::high_resolution_clock::now();
+		uploadTextureImage(job.texture, job.image);
+		job.uploadMs += elapsedMs(directStart);
+
+		job.nextRow = job.image.height;
+		job.direct = true;
+		lastFrameBytes = (std::size_t)job.image.width * job.image.height * job.image.channels;
+	}
+
+	while (!jobs.empty() && jobs.front().nextRow == jobs.front().image.height) {
+		finish(jobs.front());
+		jobs.pop_front();
+	}
+
+	glBindTexture(GL_TEXTURE_2D, 0);
+}
+
+void TextureStreamer::begin(StreamJob& job) {
+
+	allocateTextureImage(job.texture, job.image);
+
+	// until the last band is in, only the 1x1 level (the placeholder) is sampled:
+	int lastLevel = getMipLevelCount(job.image.width, job.image.height) - 1;
+
+	uploadPlaceholderImage(job.texture, lastLevel, getTextureInternalFormat(job.image));
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_BASE_LEVEL, lastLevel);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAX_LEVEL, lastLevel);
+}
+
+void TextureStreamer::finish(StreamJob& job) {
+
+	auto start = std::chrono::high_resolution_clock::now();
+
+	glBindTexture(GL_TEXTURE_2D, job.texture);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_BASE_LEVEL, 0);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAX_LEVEL, 1000);
+
+	// the levels from the workers are small next to level 0, they go in at once:
+	if (!job.direct) {
+		if (job.image.mipmaps.empty())
+			glGenerateMipmap(GL_TEXTURE_2D);
+		else
+			uploadTextureMipmaps(job.texture, job.image);
+	}
+
+	job.uploadMs += elapsedMs(start);
+
+	if (job.done) {
+		job.done(job.uploadMs, job.image);
+	}
+
+	freeTextureImage(job.image);
+}
+
+void TextureStreamer::clear() {
+
+	for (StreamJob& job : jobs) {
+		freeTextureImage(job.image);
+	}
+
+	jobs.clear();
+
+	if (!created)
+		return;
+
+	for (unsigned int b = 0; b < STREAM_RING_SIZE; b++) {
+
+		if (fences[b]) {
+			glDeleteSync(fences[b]);
+			fences[b] = 0;
+		}
+
+		if (persistent) {
+			glBindBuffer(GL_PIXEL_UNPACK_BUFFER, buffers[b]);
+			glUnmapBuffer(GL_PIXEL_UNPACK_BUFFER);
+			mapped[b] = NULL;
+		}
+	}
+
+	glBindBuffer(GL_PIXEL_UNPACK_BUFFER, 0);
+	glDeleteBuffers(STREAM_RING_SIZE, buffers);
+
+	for (unsigned int b = 0; b < STREAM_RING_SIZE; b++) {
+		buffers[b] = 0;
+	}
+
+	created = false;
+}
@@ -0,0 +1,80 @@
+#pragma once
+
+#include "Texture.h"
+
+#include <cstddef>
+#include <deque>
+#include <vector>
+#include <functional>
+
+
+// frames the ring has buffers for, a buffer is only written again when the gpu is done reading it:
+const unsigned int STREAM_RING_SIZE = 3;
+
+
+// uploads images through a ring of pixel buffer objects, frameBudget bytes per frame
+// big images go in bands of rows over several frames and keep showing the placeholder until they are complete
+// the buffers stay mapped when the driver has GL_ARB_buffer_storage, otherwise they are mapped every frame
+// needs a current OpenGL context
+class TextureStreamer {
+
+public:
+
+	TextureStreamer(std::size_t frameBudget = 4 * 1024 * 1024);
+	~TextureStreamer();
+
+	TextureStreamer(const TextureStreamer&) = delete;
+	TextureStreamer& operator=(const TextureStreamer&) = delete;
+
+	// queues the image for level 0 of the texture and takes its pixels over (they are freed once uploaded),
+	// its mipmaps go in after the last band (glGenerateMipmap if it has none),
+	// done gets the time spent on the render thread once all levels are in, and the image to take it over
+	// (set its pixels to NULL after moving them out)
+	void stream(unsigned int texture, TextureImage image, std::function<void(double uploadMs, TextureImage& image)> done);
+
+	// copies the next bands into the ring and issues their uploads, once per frame:
+	void update();
+
+	unsigned int getQueuedCount() const { return (unsigned int)jobs.size(); }
+	std::size_t getFrameBudget() const { return frameBudget; }
+	std::size_t getLastFrameBytes() const { return lastFrameBytes; }
+	bool isPersistent() const { return persistent; }
+
+	// deletes the buffers, the queued images are dropped:
+	void clear();
+
+private:
+
+	struct StreamJob {
+		unsigned int texture;
+		TextureImage image;
+		int nextRow;
+		bool direct;	// uploaded without the ring, the mipmaps are already there
+		double uploadMs;
+		std::function<void(double, TextureImage&)> done;
+	};
+
+	// rows of a job copied into the current buffer:
+	struct Band {
+		std::size_t job;
+		int firstRow;
+		int rowCount;
+		std::size_t offset;
+	};
+
+	std::size_t frameBudget;
+	std::size_t lastFrameBytes;
+	std::deque<StreamJob> jobs;
+	std::vector<Band> bands;
+
+	unsigned int buffers[STREAM_RING_SIZE];
+	GLsync fences[STREAM_RING_SIZE];
+	unsigned char* mapped[STREAM_RING_SIZE];	// only when persistent
+	unsigned int current;
+	bool persistent;
+	bool created;
+
+	void createBuffers();
+	void begin(StreamJob& job);
+	void finish(StreamJob& job);
+};
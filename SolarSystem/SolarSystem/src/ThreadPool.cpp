@@ -0,0 +1,177 @@
+#include "ThreadPool.h"
+
+#include <algorithm>
+
+
+ThreadPool::ThreadPool(unsigned int threadCount) {
+
+	this->stopping = false;
+
+	for (unsigned int i = 0; i < MAX_PARALLEL_JOBS; i++) {
+		parallelJobs[i] = NULL;
+	}
+
+	if (threadCount == 0) {
+		threadCount = getHardwareThreadCount();
+	}
+
+	for (unsigned int i = 0; i < threadCount; i++) {
+		workers.emplace_back(&ThreadPool::workerLoop, this);
+	}
+}
+
+ThreadPool::~ThreadPool() {
+
+	{
+		std::lock_guard<std::mutex> lock(queueMutex);
+		stopping = true;
+	}
+
+	queueCondition.notify_all();
+
+	for (std::thread& worker : workers) {
+		worker.join();
+	}
+}
+
+unsigned int ThreadPool::getHardwareThreadCount() {
+
+	unsigned int count = std::thread::hardware_concurrency();
+	return count > 0 ? count : 1;
+}
+
+ThreadPool& ThreadPool::getShared() {
+
+	static ThreadPool pool;
+	return pool;
+}
+
+void ThreadPool::enqueue(std::function<void()> task) {
+
+	{
+		std::lock_guard<std::mutex> lock(queueMutex);
+		tasks.push(std::move(task));
+	}
+
+	queueCondition.notify_one();
+}
+
+ThreadPool::ParallelJob* ThreadPool::findParallelJob() const {
+
+	for (unsigned int i = 0; i < MAX_PARALLEL_JOBS; i++) {
+		if (parallelJobs[i] && parallelJobs[i]->nextChunk.load() < parallelJobs[i]->chunkCount) {
+			return parallelJobs[i];
+		}
+	}
+
+	return NULL;
+}
+
+void ThreadPool::runChunks(ParallelJob& job) {
+
+	for (unsigned int chunk = job.nextChunk++; chunk < job.chunkCount; chunk = job.nextChunk++) {
+
+		int begin = (int)((long long)job.count * chunk / job.chunkCount);
+		int end = (int)((long long)job.count * (chunk + 1) / job.chunkCount);
+
+		(*job.body)(begin, end);
+	}
+}
+
+void ThreadPool::workerLoop() {
+
+	for (;;) {
+
+		std::function<void()> task;
+
+		{
+			std::unique_lock<std::mutex> lock(queueMutex);
+			queueCondition.wait(lock, [this] { return stopping || !tasks.empty() || findParallelJob(); });
+
+			// a parallelFor() first, a thread waits for it:
+			ParallelJob* job = findParallelJob();
+
+			if (job) {
+				job->helpers++;
+				lock.unlock();
+
+				runChunks(*job);
+
+				lock.lock();
+
+				if (--job->helpers == 0) {
+					helpersCondition.notify_all();
+				}
+
+				continue;
+			}
+
+			// finish the queued work before stopping:
+			if (tasks.empty()) {
+				return;
+			}
+
+			task = std::move(tasks.front());
+			tasks.pop();
+		}
+
+		task();
+	}
+}
+
+void ThreadPool::parallelFor(int count, unsigned int chunkCount, const std::function<void(int, int)>& body) {
+
+	if (count <= 0) {
+		return;
+	}
+
+	if (chunkCount > (unsigned int)count) {
+		chunkCount = (unsigned int)count;
+	}
+
+	if (chunkCount <= 1) {
+		body(0, count);
+		return;
+	}
+
+	ParallelJob job;
+	job.body = &body;
+	job.count = count;
+	job.chunkCount = chunkCount;
+	job.nextChunk = 0;
+	job.helpers = 0;
+
+	unsigned int slot = MAX_PARALLEL_JOBS;
+
+	{
+		std::lock_guard<std::mutex> lock(queueMutex);
+
+		for (unsigned int i = 0; i < MAX_PARALLEL_JOBS && slot == MAX_PARALLEL_JOBS; i++) {
+			if (!parallelJobs[i]) {
+				parallelJobs[i] = &job;
+				slot = i;
+			}
+		}
+	}
+
+	// at most one helper per range this thread doesn't take, the busy workers join when their task is done:
+	if (slot < MAX_PARALLEL_JOBS) {
+
+		unsigned int helpers = std::min(chunkCount - 1, (unsigned int)workers.size());
+
+		for (unsigned int i = 0; i < helpers; i++) {
+			queueCondition.notify_one();
+		}
+	}
+
+	runChunks(job);
+
+	if (slot == MAX_PARALLEL_JOBS) {
+		return;
+	}
+
+	// every range is taken, only the ones the workers still run are waited for:
+	std::unique_lock<std::mutex> lock(queueMutex);
+	parallelJobs[slot] = NULL;
+	helpersCondition.wait(lock, [&job] { return job.helpers == 0; });
+}
@@ -0,0 +1,66 @@
+#pragma once
+
+#include <vector>
+#include <queue>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <functional>
+#include <atomic>
+
+
+// a fixed set of worker threads taking tasks from a shared queue
+class ThreadPool {
+
+public:
+
+	// 0 threads = one per hardware thread
+	ThreadPool(unsigned int threadCount = 0);
+	~ThreadPool();
+
+	ThreadPool(const ThreadPool&) = delete;
+	ThreadPool& operator=(const ThreadPool&) = delete;
+
+	unsigned int getThreadCount() const { return (unsigned int)workers.size(); }
+
+	// runs the task on one of the workers:
+	void enqueue(std::function<void()> task);
+
+	// splits [0, count) into at most chunkCount continuous ranges, runs body(begin, end) for each of them
+	// and returns when all of them are done: the calling thread takes ranges until none is left & the idle workers
+	// help, so it never waits behind the queued tasks (nor for a range no one started), and nothing is allocated
+	void parallelFor(int count, unsigned int chunkCount, const std::function<void(int, int)>& body);
+
+	// the pool shared by the whole application:
+	static ThreadPool& getShared();
+
+	static unsigned int getHardwareThreadCount();
+
+private:
+
+	// a parallelFor() the workers can help with, lives on the stack of the calling thread:
+	struct ParallelJob {
+		const std::function<void(int, int)>* body;
+		int count;
+		unsigned int chunkCount;
+		std::atomic<unsigned int> nextChunk;
+		unsigned int helpers;	// workers in runChunks(), under queueMutex
+	};
+
+	// parallelFor()s at the same time (from different threads), more run on the calling thread alone:
+	static const unsigned int MAX_PARALLEL_JOBS = 8;
+
+	std::vector<std::thread> workers;
+	std::queue<std::function<void()>> tasks;
+
+	std::mutex queueMutex;
+	std::condition_variable queueCondition;
+	bool stopping;
+
+	ParallelJob* parallelJobs[MAX_PARALLEL_JOBS];	// NULL: a free slot
+	std::condition_variable helpersCondition;
+
+	void workerLoop();
+	ParallelJob* findParallelJob() const;	// one with ranges left, under queueMutex
+	static void runChunks(ParallelJob& job);
+};
@@ -0,0 +1,92 @@
+#include "UniformBuffers.h"
+
+#include <algorithm>
+
+
+void FrameUniformBuffer::update(const FrameUniforms& frame) {
+
+	if (!buffer)
+		glGenBuffers(1, &buffer);
+
+	glBindBuffer(GL_UNIFORM_BUFFER, buffer);
+	glBufferData(GL_UNIFORM_BUFFER, sizeof(FrameUniforms), &frame, GL_STREAM_DRAW);
+	glBindBuffer(GL_UNIFORM_BUFFER, 0);
+
+	glBindBufferBase(GL_UNIFORM_BUFFER, FRAME_UNIFORMS_BINDING, buffer);
+}
+
+void FrameUniformBuffer::clear() {
+
+	if (buffer) {
+		glDeleteBuffers(1, &buffer);
+		buffer = 0;
+	}
+}
+
+BodyUniformBuffer::BodyUniformBuffer() : buffer(0), capacity(0), blockStride(0), boundBlock(-1) {
+}
+
+unsigned int BodyUniformBuffer::add(const BodyUniforms& body) {
+	bodies.push_back(body);
+	return (unsigned int)bodies.size() - 1;
+}
+
+void BodyUniformBuffer::upload() {
+
+	if (!buffer) {
+
+		glGenBuffers(1, &buffer);
+
+		// the blocks have to start at multiples of the alignment:
+		int alignment = 256;
+		glGetIntegerv(GL_UNIFORM_BUFFER_OFFSET_ALIGNMENT, &alignment);
+
+		std::size_t blockSize = BODIES_PER_BLOCK * sizeof(BodyUniforms);
+		blockStride = (blockSize + alignment - 1) / alignment * alignment;
+	}
+
+	// a whole block even for the last bodies, the shader may read past them:
+	std::size_t size = std::max(getBlockCount(), 1u) * blockStride;
+
+	glBindBuffer(GL_UNIFORM_BUFFER, buffer);
+
+	// grows to the largest frame, orphaned every frame after that:
+	capacity = std::max(capacity, size);
+	glBufferData(GL_UNIFORM_BUFFER, capacity, NULL, GL_STREAM_DRAW);
+
+	for (unsigned int block = 0; block < getBlockCount(); block++) {
+
+		unsigned int first = block * BODIES_PER_BLOCK;
+		unsigned int count = std::min((unsigned int)bodies.size() - first, (unsigned int)BODIES_PER_BLOCK);
+
+		glBufferSubData(GL_UNIFORM_BUFFER, block * blockStride, count * sizeof(BodyUniforms), &bodies[first]);
+	}
+
+	glBindBuffer(GL_UNIFORM_BUFFER, 0);
+
+	boundBlock = -1;
+}
+
+int BodyUniformBuffer::bind(unsigned int body) {
+
+	int block = (int)(body / BODIES_PER_BLOCK);
+
+	if (block != boundBlock) {
+		glBindBufferRange(GL_UNIFORM_BUFFER, BODY_UNIFORMS_BINDING, buffer, block * blockStride, BODIES_PER_BLOCK * sizeof(BodyUniforms));
+		boundBlock = block;
+	}
+
+	return (int)(body % BODIES_PER_BLOCK);
+}
+
+void BodyUniformBuffer::clear() {
+
+	if (buffer) {
+		glDeleteBuffers(1, &buffer);
+		buffer = 0;
+	}
+
+	bodies.clear();
+	capacity = 0;
+	boundBlock = -1;
+}
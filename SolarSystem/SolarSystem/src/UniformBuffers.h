@@ -0,0 +1,99 @@
+#pragma once
+
+#include <GL/glew.h>
+#include <glm/glm.hpp>
+
+#include <vector>
+#include <cstddef>
+
+
+// the uniform blocks every planet program shares (Shader binds them to these points after linking),
+// std140 with the same layouts as res/shaders/uniforms.glsl:
+const unsigned int FRAME_UNIFORMS_BINDING = 0;
+const unsigned int BODY_UNIFORMS_BINDING = 1;
+
+// bodies in one Bodies block (the array size in uniforms.glsl), 128 * 96 bytes stay under the 16 KB every driver allows:
+const int BODIES_PER_BLOCK = 128;
+
+// the "Frame" block, the same for every draw of a frame:
+struct FrameUniforms {
+	glm::mat4 view;
+	glm::mat4 projection;
+	glm::mat4 viewProjection;
+	glm::vec4 sunPosition;	// w: seconds since the start
+};
+
+// an element of the "Bodies" block:
+struct BodyUniforms {
+	glm::mat4 model;
+	glm::vec4 color;	// rgb & 1
+	glm::vec4 params;	// x: layer in the texture array, yzw: unused
+};
+
+static_assert(sizeof(FrameUniforms) == 208, "FrameUniforms has to match the std140 layout");
+static_assert(sizeof(BodyUniforms) == 96, "BodyUniforms has to match the std140 layout");
+
+// the Frame block, uploaded & bound once per frame, needs a current OpenGL context
+class FrameUniformBuffer {
+
+public:
+
+	FrameUniformBuffer() : buffer(0) {}
+	~FrameUniformBuffer() { clear(); }
+
+	FrameUniformBuffer(const FrameUniformBuffer&) = delete;
+	FrameUniformBuffer& operator=(const FrameUniformBuffer&) = delete;
+
+	void update(const FrameUniforms& frame);
+
+	// deletes the buffer, before the context goes:
+	void clear();
+
+private:
+
+	unsigned int buffer;
+};
+
+// the bodies of a frame in one large buffer, cut into Bodies blocks of BODIES_PER_BLOCK: add() every body, upload()
+// them once, then bind() the block of a body before its draw & give the shader its index in the block
+// (the aBody attribute, or the instance) so the draws need no glUniform* at all
+// no allocations per frame once the buffer fits the bodies, needs a current OpenGL context
+class BodyUniformBuffer {
+
+public:
+
+	BodyUniformBuffer();
+	~BodyUniformBuffer() { clear(); }
+
+	BodyUniformBuffer(const BodyUniformBuffer&) = delete;
+	BodyUniformBuffer& operator=(const BodyUniformBuffer&) = delete;
+
+	// forgets the bodies of the last frame:
+	void reset() { bodies.clear(); }
+
+	// the body's index for bind(), valid until the next reset():
+	unsigned int add(const BodyUniforms& body);
+
+	// puts the bodies into the buffer (a new store each time, the draws of the last frame may still read the old one):
+	void upload();
+
+	// binds the Bodies block with the body to BODY_UNIFORMS_BINDING (only when it's another block than the last one)
+	// and returns its index in the block:
+	int bind(unsigned int body);
+
+	unsigned int getBodyCount() const { return (unsigned int)bodies.size(); }
+	unsigned int getBlockCount() const { return ((unsigned int)bodies.size() + BODIES_PER_BLOCK - 1) / BODIES_PER_BLOCK; }
+	std::size_t getMemorySize() const { return capacity; }
+
+	// deletes the buffer, before the context goes:
+	void clear();
+
+private:
+
+	std::vector<BodyUniforms> bodies;
+
+	unsigned int buffer;
+	std::size_t capacity;	// # of bytes of the buffer's store
+	std::size_t blockStride;	// a block rounded up to GL_UNIFORM_BUFFER_OFFSET_ALIGNMENT
+	int boundBlock;	// -1: none since the last upload()
+};
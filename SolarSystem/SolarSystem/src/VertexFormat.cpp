@@ -0,0 +1,131 @@
+#include "VertexFormat.h"
+
+#include <cmath>
+
+
+static int16_t packSnorm16(float value) {
+
+	if (value > 1.0f) value = 1.0f;
+	if (value < -1.0f) value = -1.0f;
+
+	return (int16_t)std::lround(value * 32767.0f);
+}
+
+static uint16_t packUnorm16(float value) {
+
+	if (value > 1.0f) value = 1.0f;
+	if (value < 0.0f) value = 0.0f;
+
+	return (uint16_t)std::lround(value * 65535.0f);
+}
+
+static float signNotZero(float value) {
+	return value >= 0.0f ? 1.0f : -1.0f;
+}
+
+
+int getVertexFormatStride(Vertex_Format format) {
+
+	switch (format) {
+	case VERTEX_FORMAT_COMPACT:
+		return sizeof(CompactVertex);
+	default:
+		return 8 * sizeof(float);
+	}
+}
+
+void octEncode(float x, float y, float z, float& u, float& v) {
+
+	// project onto the octahedron |x| + |y| + |z| = 1:
+	float l1 = std::fabs(x) + std::fabs(y) + std::fabs(z);
+
+	if (l1 == 0.0f) {
+		u = v = 0.0f;
+		return;
+	}
+
+	u = x / l1;
+	v = y / l1;
+
+	// fold the lower half over the diagonals:
+	if (z < 0.0f) {
+		float foldedU = (1.0f - std::fabs(v)) * signNotZero(u);
+		float foldedV = (1.0f - std::fabs(u)) * signNotZero(v);
+		u = foldedU;
+		v = foldedV;
+	}
+}
+
+void octDecode(float u, float v, float& x, float& y, float& z) {
+
+	x = u;
+	y = v;
+	z = 1.0f - std::fabs(u) - std::fabs(v);
+
+	if (z < 0.0f) {
+		x = (1.0f - std::fabs(v)) * signNotZero(u);
+		y = (1.0f - std::fabs(u)) * signNotZero(v);
+	}
+
+	float lengthInv = 1.0f / std::sqrt(x * x + y * y + z * z);
+	x *= lengthInv;
+	y *= lengthInv;
+	z *= lengthInv;
+}
+
+void packCompactVertices(const float* interleaved, std::size_t count, float positionScale, CompactVertex* out) {
+
+	float u, v;
+
+	for (std::size_t i = 0; i < count; i++, interleaved += 8, out++) {
+
+		// vertex positions:
+		out->position[0] = packSnorm16(interleaved[0] * positionScale);
+		out->position[1] = packSnorm16(interleaved[1] * positionScale);
+		out->position[2] = packSnorm16(interleaved[2] * positionScale);
+		out->position[3] = 0;
+
+		// normals:
+		octEncode(interleaved[3], interleaved[4], interleaved[5], u, v);
+		out->normal[0] = packSnorm16(u);
+		out->normal[1] = packSnorm16(v);
+
+		// texCoords:
+		out->texCoord[0] = packUnorm16(interleaved[6] * COMPACT_TEXCOORD_U_SCALE);
+		out->texCoord[1] = packUnorm16(interleaved[7]);
+	}
+}
+
+void setupVertexAttributes(Vertex_Format format) {
+
+	int stride = getVertexFormatStride(format);
+
+	if (format == VERTEX_FORMAT_COMPACT) {
+
+		// position attribute:
+		glVertexAttribPointer(0, 3, GL_SHORT, GL_TRUE, stride, (void*)offsetof(CompactVertex, position));
+		glEnableVertexAttribArray(0);
+
+		// normal attributes (decoded in the shader):
+		glVertexAttribPointer(1, 2, GL_SHORT, GL_TRUE, stride, (void*)offsetof(CompactVertex, normal));
+		glEnableVertexAttribArray(1);
+
+		// texture coordinates:
+		glVertexAttribPointer(2, 2, GL_UNSIGNED_SHORT, GL_TRUE, stride, (void*)offsetof(CompactVertex, texCoord));
+		glEnableVertexAttribArray(2);
+
+		return;
+	}
+
+	// position attribute:
+	glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, stride, (void*)0);
+	glEnableVertexAttribArray(0);
+
+	// normal attributes:
+	glVertexAttribPointer(1, 3, GL_FLOAT, GL_FALSE, stride, (void*)(3 * sizeof(float)));
+	glEnableVertexAttribArray(1);
+
+	// texture coordinates:
+	glVertexAttribPointer(2, 2, GL_FLOAT, GL_FALSE, stride, (void*)(6 * sizeof(float)));
+	glEnableVertexAttribArray(2);
+}
@@ -0,0 +1,42 @@
+#pragma once
+
+#include <GL/glew.h>
+
+#include <cstdint>
+#include <cstddef>
+#include <vector>
+
+
+// vertex layouts the meshes can be uploaded with:
+enum Vertex_Format {
+	VERTEX_FORMAT_FLOAT,	// position, normal, texCoord as floats, 32 bytes
+	VERTEX_FORMAT_COMPACT	// snorm16 position, octahedral snorm16 normal, unorm16 texCoord, 16 bytes
+};
+
+// the compact u is stored halved, the seam copies of the icosphere & cube sphere go up to u = 2
+// (vertex_shader_compact doubles it back):
+const float COMPACT_TEXCOORD_U_SCALE = 0.5f;
+
+// a vertex in VERTEX_FORMAT_COMPACT
+// the position is stored normalized, so the mesh has to fit in the unit sphere (the scale goes into the model matrix)
+struct CompactVertex {
+	int16_t position[4];	// x, y, z, padding
+	int16_t normal[2];		// octahedral encoded unit normal
+	uint16_t texCoord[2];	// u * COMPACT_TEXCOORD_U_SCALE, v
+};
+
+static_assert(sizeof(CompactVertex) == 16, "CompactVertex has to be 16 bytes");
+
+// bytes per vertex:
+int getVertexFormatStride(Vertex_Format format);
+
+// packs count interleaved float vertices (see Sphere::getInterleavedVertices) into the compact layout,
+// the positions are multiplied with positionScale first to bring them into [-1, 1]
+void packCompactVertices(const float* interleaved, std::size_t count, float positionScale, CompactVertex* out);
+
+// octahedral mapping of a unit vector onto the [-1, 1] square and back (the same as octDecode in the shader):
+void octEncode(float x, float y, float z, float& u, float& v);
+void octDecode(float u, float v, float& x, float& y, float& z);
+
+// glVertexAttribPointer for attributes 0 (position), 1 (normal) and 2 (texCoord) of the bound VAO & VBO:
+void setupVertexAttributes(Vertex_Format format);
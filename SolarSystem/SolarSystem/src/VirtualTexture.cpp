@@ -0,0 +1,708 @@
+#include "VirtualTexture.h"
+#include "ThreadPool.h"
+#include "Texture.h"
+#include "TextureMipmaps.h"
+
+#include <algorithm>
+#include <fstream>
+#include <iostream>
+#include <functional>
+#include <cstring>
+#include <cstdio>
+#include <cmath>
+
+#ifdef _WIN32
+#include <direct.h>
+#else
+#include <sys/stat.h>
+#endif
+
+
+const uint32_t VIRTUAL_TEXTURE_VERSION = 1;
+const std::size_t VIRTUAL_TILE_BYTES = (std::size_t)VIRTUAL_SLOT_SIZE * VIRTUAL_SLOT_SIZE * 4;
+
+// tiles the workers read at the same time, tiles put into the cache per frame:
+const unsigned int MAX_TILE_REQUESTS = 32;
+const unsigned int MAX_TILE_UPLOADS = 8;
+
+// the uniforms of the virtual texture & feedback shaders:
+constexpr UniformName UNIFORM_PHYSICAL_CACHE("PhysicalCache");
+constexpr UniformName UNIFORM_PAGE_TABLE("PageTable");
+constexpr UniformName UNIFORM_VIRTUAL_SIZE("virtualSize");
+constexpr UniformName UNIFORM_LEVEL_COUNT("levelCount");
+constexpr UniformName UNIFORM_TILE_SIZE("tileSize");
+constexpr UniformName UNIFORM_TILE_BORDER("tileBorder");
+constexpr UniformName UNIFORM_CACHE_SIZE("cacheSize");
+constexpr UniformName UNIFORM_LOD_BIAS("lodBias");
+
+static int nextPowerOfTwo(int value) {
+
+	int power = 1;
+
+	while (power < value)
+		power *= 2;
+
+	return power;
+}
+
+VirtualTexture::VirtualTexture() : header(NULL), pageTableWidth(0), pageTableHeight(0), cacheTexture(0), pageTableTexture(0), pageTableDirty(false),
+	feedbackFramebuffer(0), feedbackColor(0), feedbackDepth(0), feedbackWidth(0), feedbackHeight(0), feedbackIndex(0),
+	frame(0), pendingCount(0), lastFrameUploads(0), lastFrameRequests(0), buildPending(false), reading(0), building(false), built(false) {
+
+	feedbackBuffers[0] = feedbackBuffers[1] = 0;
+	feedbackFences[0] = feedbackFences[1] = 0;
+}
+
+VirtualTexture::~VirtualTexture() {
+	close();
+}
+
+bool VirtualTexture::open(const std::string& path, const std::string& sourcePath) {
+
+	close();
+
+	if (!file.open(path))
+		return false;
+
+	const VirtualTextureHeader* fileHeader = (const VirtualTextureHeader*)file.getData();
+
+	bool valid = file.getSize() >= sizeof(VirtualTextureHeader)
+		&& memcmp(fileHeader->magic, "STVT", 4) == 0
+		&& fileHeader->version == VIRTUAL_TEXTURE_VERSION
+		&& fileHeader->tileSize == VIRTUAL_TILE_SIZE
+		&& fileHeader->tileBorder == VIRTUAL_TILE_BORDER
+		&& fileHeader->levelCount > 0 && fileHeader->levelCount <= 32;
+
+	if (!valid) {
+		std::cout << "ERROR::VIRTUAL_TEXTURE::NOT_A_VIRTUAL_TEXTURE: " << path << "\n";
+		file.close();
+		return false;
+	}
+
+	// a source that is gone is fine, the tiles are all we need:
+	uint64_t size;
+	int64_t time;
+
+	if (getSourceStamp(sourcePath, size, time) && (size != fileHeader->sourceSize || time != fileHeader->sourceTime)) {
+		file.close();
+		return false;
+	}
+
+	int tileCount = 0;
+
+	for (uint32_t level = 0; level < fileHeader->levelCount; level++) {
+
+		int width = std::max((int)fileHeader->width >> level, 1);
+		int height = std::max((int)fileHeader->height >> level, 1);
+
+		tilesX.push_back((width + VIRTUAL_TILE_SIZE - 1) / VIRTUAL_TILE_SIZE);
+		tilesY.push_back((height + VIRTUAL_TILE_SIZE - 1) / VIRTUAL_TILE_SIZE);
+		firstTile.push_back(tileCount);
+
+		tileCount += tilesX.back() * tilesY.back();
+	}
+
+	if (fileHeader->tileOffset + tileCount * VIRTUAL_TILE_BYTES > file.getSize()) {
+		std::cout << "ERROR::VIRTUAL_TEXTURE::TRUNCATED: " << path << "\n";
+		file.close();
+		tilesX.clear();
+		tilesY.clear();
+		firstTile.clear();
+		return false;
+	}
+
+	header = fileHeader;
+
+	tileSlots.assign(tileCount, -1);
+	tileSeen.assign(tileCount, 0);
+	tileRequested.assign(tileCount, false);
+	slotTiles.assign(VIRTUAL_CACHE_SLOTS * VIRTUAL_CACHE_SLOTS, -1);
+
+	// the cache, no mipmaps, the tiles are the levels:
+	int cacheSize = VIRTUAL_CACHE_SLOTS * VIRTUAL_SLOT_SIZE;
+
+	glGenTextures(1, &cacheTexture);
+	glBindTexture(GL_TEXTURE_2D, cacheTexture);
+	glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA8, cacheSize, cacheSize, 0, GL_RGBA, GL_UNSIGNED_BYTE, NULL);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAX_LEVEL, 0);
+
+	// the page table, a level per level (the sides are powers of two so a tile's parent is always at x / 2, y / 2):
+	pageTableWidth = nextPowerOfTwo(tilesX[0]);
+	pageTableHeight = nextPowerOfTwo(tilesY[0]);
+
+	glGenTextures(1, &pageTableTexture);
+	glBindTexture(GL_TEXTURE_2D, pageTableTexture);
+
+	for (uint32_t level = 0; level < header->levelCount; level++) {
+
+		int width = std::max(pageTableWidth >> level, 1);
+		int height = std::max(pageTableHeight >> level, 1);
+
+		pageTable.push_back(std::vector<unsigned char>((std::size_t)width * height * 4, 0));
+		glTexImage2D(GL_TEXTURE_2D, level, GL_RGBA8, width, height, 0, GL_RGBA, GL_UNSIGNED_BYTE, NULL);
+	}
+
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST_MIPMAP_NEAREST);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_BASE_LEVEL, 0);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAX_LEVEL, header->levelCount - 1);
+
+	// the coarsest level is a single tile that never leaves, everything falls back to it:
+	TileData coarsest;
+	coarsest.tile = tileCount - 1;
+	coarsest.texels.assign(file.getData() + getTileOffset(coarsest.tile), file.getData() + getTileOffset(coarsest.tile) + VIRTUAL_TILE_BYTES);
+
+	uploadTile(coarsest);
+	updatePageTable();
+
+	glBindTexture(GL_TEXTURE_2D, 0);
+
+	return true;
+}
+
+void VirtualTexture::close() {
+
+	waitForWorkers();
+	loaded.clear();
+
+	if (cacheTexture) {
+		glDeleteTextures(1, &cacheTexture);
+		glDeleteTextures(1, &pageTableTexture);
+		cacheTexture = 0;
+		pageTableTexture = 0;
+	}
+
+	deleteFeedback();
+
+	file.close();
+	header = NULL;
+
+	tilesX.clear();
+	tilesY.clear();
+	firstTile.clear();
+	pageTable.clear();
+	tileSlots.clear();
+	tileSeen.clear();
+	tileRequested.clear();
+	slotTiles.clear();
+
+	pendingCount = 0;
+}
+
+void VirtualTexture::startBuild(const std::string& path, const std::string& sourcePath) {
+
+	if (buildPending)
+		return;
+
+	buildPath = path;
+	buildSourcePath = sourcePath;
+	buildPending = true;
+
+	{
+		std::lock_guard<std::mutex> lock(loadedMutex);
+		building = true;
+	}
+
+	ThreadPool::getShared().enqueue([this, path, sourcePath]() {
+
+		bool result = build(sourcePath, path);
+
+		std::lock_guard<std::mutex> lock(loadedMutex);
+		built = result;
+		building = false;
+		loadedCondition.notify_all();
+	});
+}
+
+bool VirtualTexture::updateBuild() {
+
+	if (!buildPending)
+		return false;
+
+	{
+		std::lock_guard<std::mutex> lock(loadedMutex);
+
+		if (building)
+			return false;
+	}
+
+	buildPending = false;
+
+	return built && open(buildPath, buildSourcePath);
+}
+
+std::size_t VirtualTexture::getTileOffset(int tile) const {
+	return header->tileOffset + (std::size_t)tile * VIRTUAL_TILE_BYTES;
+}
+
+bool VirtualTexture::build(const std::string& sourcePath, const std::string& path) {
+
+	VirtualTextureHeader fileHeader;
+	memset(&fileHeader, 0, sizeof(fileHeader));
+
+	TextureImage image;
+
+	if (!getSourceStamp(sourcePath, fileHeader.sourceSize, fileHeader.sourceTime) || !decodeTextureImage(sourcePath, image)) {
+		std::cout << "ERROR::VIRTUAL_TEXTURE::FAILED_TO_LOAD: " << sourcePath << "\n";
+		return false;
+	}
+
+	if ((image.width & (image.width - 1)) != 0 || (image.height & (image.height - 1)) != 0) {
+		std::cout << "ERROR::VIRTUAL_TEXTURE::NOT_A_POWER_OF_TWO: " << sourcePath << "\n";
+		freeTextureImage(image);
+		return false;
+	}
+
+	// the levels are filtered like every other texture, the planets wrap around:
+	generateTextureMipmaps(image, MIP_FILTER_KAISER, true);
+
+	// the tiles are rgba:
+	expandTextureImage(image, 4);
+
+	memcpy(fileHeader.magic, "STVT", 4);
+	fileHeader.version = VIRTUAL_TEXTURE_VERSION;
+	fileHeader.width = image.width;
+	fileHeader.height = image.height;
+	fileHeader.tileSize = VIRTUAL_TILE_SIZE;
+	fileHeader.tileBorder = VIRTUAL_TILE_BORDER;
+	fileHeader.tileOffset = 4096;
+	fileHeader.levelCount = 1;
+
+	while ((image.width >> (fileHeader.levelCount - 1)) > VIRTUAL_TILE_SIZE || (image.height >> (fileHeader.levelCount - 1)) > VIRTUAL_TILE_SIZE)
+		fileHeader.levelCount++;
+
+#ifdef _WIN32
+	_mkdir(path.substr(0, path.find_last_of('/')).c_str());
+#else
+	mkdir(path.substr(0, path.find_last_of('/')).c_str(), 0755);
+#endif
+
+	std::string temporaryPath = path + ".tmp";
+	std::ofstream out(temporaryPath, std::ios::binary);
+
+	if (!out) {
+		std::cout << "ERROR::VIRTUAL_TEXTURE::FAILED_TO_WRITE: " << path << "\n";
+		freeTextureImage(image);
+		return false;
+	}
+
+	std::vector<char> padding(fileHeader.tileOffset - sizeof(fileHeader), 0);
+	out.write((const char*)&fileHeader, sizeof(fileHeader));
+	out.write(padding.data(), padding.size());
+
+	std::vector<unsigned char> tile(VIRTUAL_TILE_BYTES);
+
+	for (uint32_t level = 0; level < fileHeader.levelCount; level++) {
+
+		int width = std::max(image.width >> level, 1);
+		int height = std::max(image.height >> level, 1);
+		const unsigned char* texels = getTextureImageLevel(image, level);
+
+		for (int ty = 0; ty < (height + VIRTUAL_TILE_SIZE - 1) / VIRTUAL_TILE_SIZE; ty++) {
+			for (int tx = 0; tx < (width + VIRTUAL_TILE_SIZE - 1) / VIRTUAL_TILE_SIZE; tx++) {
+
+				// the border wraps around the sphere (x) and is clamped at the poles (y):
+				for (int y = 0; y < VIRTUAL_SLOT_SIZE; y++) {
+
+					int sourceY = std::min(std::max(ty * VIRTUAL_TILE_SIZE + y - VIRTUAL_TILE_BORDER, 0), height - 1);
+
+					for (int x = 0; x < VIRTUAL_SLOT_SIZE; x++) {
+
+						int sourceX = ((tx * VIRTUAL_TILE_SIZE + x - VIRTUAL_TILE_BORDER) % width + width) % width;
+
+						memcpy(&tile[((std::size_t)y * VIRTUAL_SLOT_SIZE + x) * 4], texels + ((std::size_t)sourceY * width + sourceX) * 4, 4);
+					}
+				}
+
+				out.write((const char*)tile.data(), tile.size());
+			}
+		}
+	}
+
+	out.close();
+	freeTextureImage(image);
+
+	std::remove(path.c_str());
+
+	if (!out || std::rename(temporaryPath.c_str(), path.c_str()) != 0) {
+		std::cout << "ERROR::VIRTUAL_TEXTURE::FAILED_TO_WRITE: " << path << "\n";
+		std::remove(temporaryPath.c_str());
+		return false;
+	}
+
+	return true;
+}
+
+void VirtualTexture::createFeedback(int width, int height) {
+
+	deleteFeedback();
+
+	feedbackWidth = width;
+	feedbackHeight = height;
+
+	// tile x, tile y, level & 1 where something was drawn:
+	glGenTextures(1, &feedbackColor);
+	glBindTexture(GL_TEXTURE_2D, feedbackColor);
+	glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA16UI, width, height, 0, GL_RGBA_INTEGER, GL_UNSIGNED_SHORT, NULL);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+	glBindTexture(GL_TEXTURE_2D, 0);
+
+	glGenRenderbuffers(1, &feedbackDepth);
+	glBindRenderbuffer(GL_RENDERBUFFER, feedbackDepth);
+	glRenderbufferStorage(GL_RENDERBUFFER, GL_DEPTH_COMPONENT24, width, height);
+	glBindRenderbuffer(GL_RENDERBUFFER, 0);
+
+	glGenFramebuffers(1, &feedbackFramebuffer);
+	glBindFramebuffer(GL_FRAMEBUFFER, feedbackFramebuffer);
+	glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D, feedbackColor, 0);
+	glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_DEPTH_ATTACHMENT, GL_RENDERBUFFER, feedbackDepth);
+
+	if (glCheckFramebufferStatus(GL_FRAMEBUFFER) != GL_FRAMEBUFFER_COMPLETE)
+		std::cout << "ERROR::VIRTUAL_TEXTURE::FEEDBACK_FRAMEBUFFER_INCOMPLETE\n";
+
+	glBindFramebuffer(GL_FRAMEBUFFER, 0);
+
+	glGenBuffers(2, feedbackBuffers);
+
+	for (int b = 0; b < 2; b++) {
+		glBindBuffer(GL_PIXEL_PACK_BUFFER, feedbackBuffers[b]);
+		glBufferData(GL_PIXEL_PACK_BUFFER, (GLsizeiptr)width * height * 8, NULL, GL_STREAM_READ);
+	}
+
+	glBindBuffer(GL_PIXEL_PACK_BUFFER, 0);
+
+	feedbackIndex = 0;
+}
+
+void VirtualTexture::deleteFeedback() {
+
+	if (!feedbackFramebuffer)
+		return;
+
+	for (int b = 0; b < 2; b++) {
+		if (feedbackFences[b]) {
+			glDeleteSync(feedbackFences[b]);
+			feedbackFences[b] = 0;
+		}
+	}
+
+	glDeleteBuffers(2, feedbackBuffers);
+	glDeleteFramebuffers(1, &feedbackFramebuffer);
+	glDeleteRenderbuffers(1, &feedbackDepth);
+	glDeleteTextures(1, &feedbackColor);
+
+	feedbackFramebuffer = 0;
+	feedbackDepth = 0;
+	feedbackColor = 0;
+	feedbackBuffers[0] = feedbackBuffers[1] = 0;
+}
+
+void VirtualTexture::beginFeedback(int screenWidth, int screenHeight) {
+
+	int width = std::max(screenWidth / VIRTUAL_FEEDBACK_SCALE, 1);
+	int height = std::max(screenHeight / VIRTUAL_FEEDBACK_SCALE, 1);
+
+	if (!feedbackFramebuffer || width != feedbackWidth || height != feedbackHeight)
+		createFeedback(width, height);
+
+	glBindFramebuffer(GL_FRAMEBUFFER, feedbackFramebuffer);
+	glViewport(0, 0, width, height);
+
+	const GLuint nothing[4] = { 0, 0, 0, 0 };
+	glClearBufferuiv(GL_COLOR, 0, nothing);
+	glClear(GL_DEPTH_BUFFER_BIT);
+}
+
+void VirtualTexture::endFeedback(int screenWidth, int screenHeight) {
+
+	// read back without waiting, update() looks at it next frame:
+	if (feedbackFences[feedbackIndex])
+		glDeleteSync(feedbackFences[feedbackIndex]);
+
+	glBindBuffer(GL_PIXEL_PACK_BUFFER, feedbackBuffers[feedbackIndex]);
+	glReadPixels(0, 0, feedbackWidth, feedbackHeight, GL_RGBA_INTEGER, GL_UNSIGNED_SHORT, (void*)0);
+	glBindBuffer(GL_PIXEL_PACK_BUFFER, 0);
+
+	feedbackFences[feedbackIndex] = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+	feedbackIndex = 1 - feedbackIndex;
+
+	glBindFramebuffer(GL_FRAMEBUFFER, 0);
+	glViewport(0, 0, screenWidth, screenHeight);
+}
+
+float VirtualTexture::getFeedbackLodBias() {
+	return -log2((float)VIRTUAL_FEEDBACK_SCALE);
+}
+
+void VirtualTexture::readFeedback(std::vector<std::pair<int, int> >& requests) {
+
+	// the buffer written the frame before, skipped if the gpu isn't done with it yet:
+	GLsync fence = feedbackFences[feedbackIndex];
+
+	if (!fence)
+		return;
+
+	GLenum status = glClientWaitSync(fence, 0, 0);
+
+	if (status != GL_ALREADY_SIGNALED && status != GL_CONDITION_SATISFIED)
+		return;
+
+	glDeleteSync(fence);
+	feedbackFences[feedbackIndex] = 0;
+
+	std::size_t size = (std::size_t)feedbackWidth * feedbackHeight * 8;
+
+	glBindBuffer(GL_PIXEL_PACK_BUFFER, feedbackBuffers[feedbackIndex]);
+	const uint16_t* texels = (const uint16_t*)glMapBufferRange(GL_PIXEL_PACK_BUFFER, 0, size, GL_MAP_READ_BIT);
+
+	if (texels) {
+
+		uint16_t last[3] = { 0xFFFF, 0xFFFF, 0xFFFF };
+
+		for (int p = 0; p < feedbackWidth * feedbackHeight; p++) {
+
+			const uint16_t* texel = texels + 4 * p;
+
+			// the neighbours mostly want the same tile:
+			if (texel[3] == 0 || (texel[0] == last[0] && texel[1] == last[1] && texel[2] == last[2]))
+				continue;
+
+			last[0] = texel[0];
+			last[1] = texel[1];
+			last[2] = texel[2];
+
+			int level = texel[2];
+
+			if (level < (int)header->levelCount && texel[0] < tilesX[level] && texel[1] < tilesY[level])
+				markSeen(level, texel[0], texel[1], requests);
+		}
+
+		glUnmapBuffer(GL_PIXEL_PACK_BUFFER);
+	}
+
+	glBindBuffer(GL_PIXEL_PACK_BUFFER, 0);
+}
+
+void VirtualTexture::markSeen(int level, int x, int y, std::vector<std::pair<int, int> >& requests) {
+
+	// the tile and its coarser parents, they stand in for it until it is there:
+	for (; level < (int)header->levelCount; level++, x /= 2, y /= 2) {
+
+		int tile = getTileIndex(level, x, y);
+
+		if (tileSeen[tile] == frame)
+			return;
+
+		tileSeen[tile] = frame;
+
+		if (tileSlots[tile] < 0 && !tileRequested[tile])
+			requests.push_back(std::make_pair(level, tile));
+	}
+}
+
+void VirtualTexture::request(int tile) {
+
+	tileRequested[tile] = true;
+	pendingCount++;
+
+	{
+		std::lock_guard<std::mutex> lock(loadedMutex);
+		reading++;
+	}
+
+	std::size_t offset = getTileOffset(tile);
+
+	ThreadPool::getShared().enqueue([this, tile, offset]() {
+
+		TileData data;
+		data.tile = tile;
+
+		// the first touch of the mapped pages is the disk read:
+		const unsigned char* texels = file.getData() + offset;
+		data.texels.assign(texels, texels + VIRTUAL_TILE_BYTES);
+
+		std::lock_guard<std::mutex> lock(loadedMutex);
+		loaded.push_back(std::move(data));
+		reading--;
+		loadedCondition.notify_all();
+	});
+}
+
+bool VirtualTexture::uploadTile(const TileData& data) {
+
+	// a free slot, or the one with the tile seen the longest ago (never the coarsest level or a tile seen this frame):
+	int best = -1;
+	unsigned long long bestSeen = frame;
+
+	for (int slot = 0; slot < (int)slotTiles.size(); slot++) {
+
+		int tile = slotTiles[slot];
+
+		if (tile < 0) {
+			best = slot;
+			break;
+		}
+
+		if (tile >= firstTile[header->levelCount - 1] || tileSeen[tile] >= bestSeen)
+			continue;
+
+		best = slot;
+		bestSeen = tileSeen[tile];
+	}
+
+	if (best < 0)
+		return false;
+
+	if (slotTiles[best] >= 0)
+		tileSlots[slotTiles[best]] = -1;
+
+	glBindTexture(GL_TEXTURE_2D, cacheTexture);
+	glTexSubImage2D(GL_TEXTURE_2D, 0, (best % VIRTUAL_CACHE_SLOTS) * VIRTUAL_SLOT_SIZE, (best / VIRTUAL_CACHE_SLOTS) * VIRTUAL_SLOT_SIZE,
+					VIRTUAL_SLOT_SIZE, VIRTUAL_SLOT_SIZE, GL_RGBA, GL_UNSIGNED_BYTE, data.texels.data());
+
+	slotTiles[best] = data.tile;
+	tileSlots[data.tile] = best;
+	pageTableDirty = true;
+
+	return true;
+}
+
+void VirtualTexture::update() {
+
+	frame++;
+	lastFrameUploads = 0;
+	lastFrameRequests = 0;
+
+	if (!header)
+		return;
+
+	// the tiles in the feedback, coarse ones first, they stand in for the fine ones:
+	std::vector<std::pair<int, int> > requests;
+	readFeedback(requests);
+
+	std::sort(requests.begin(), requests.end(), std::greater<std::pair<int, int> >());
+
+	for (const std::pair<int, int>& tile : requests) {
+
+		if (pendingCount >= MAX_TILE_REQUESTS)
+			break;
+
+		request(tile.second);
+		lastFrameRequests++;
+	}
+
+	// the tiles the workers read:
+	for (unsigned int i = 0; i < MAX_TILE_UPLOADS; i++) {
+
+		TileData data;
+
+		{
+			std::lock_guard<std::mutex> lock(loadedMutex);
+
+			if (loaded.empty())
+				break;
+
+			data = std::move(loaded.front());
+			loaded.pop_front();
+		}
+
+		// no room when every slot was seen this frame, the feedback asks for it again:
+		if (uploadTile(data))
+			lastFrameUploads++;
+
+		tileRequested[data.tile] = false;
+		pendingCount--;
+	}
+
+	if (pageTableDirty)
+		updatePageTable();
+
+	glBindTexture(GL_TEXTURE_2D, 0);
+}
+
+void VirtualTexture::updatePageTable() {
+
+	int levelCount = header->levelCount;
+
+	// coarse to fine, a tile that isn't there takes the entry of its parent:
+	for (int level = levelCount - 1; level >= 0; level--) {
+
+		int width = std::max(pageTableWidth >> level, 1);
+		int parentWidth = std::max(pageTableWidth >> (level + 1), 1);
+
+		for (int y = 0; y < tilesY[level]; y++) {
+			for (int x = 0; x < tilesX[level]; x++) {
+
+				unsigned char* entry = &pageTable[level][4 * ((std::size_t)y * width + x)];
+				int slot = tileSlots[getTileIndex(level, x, y)];
+
+				if (slot >= 0) {
+					entry[0] = (unsigned char)(slot % VIRTUAL_CACHE_SLOTS);
+					entry[1] = (unsigned char)(slot / VIRTUAL_CACHE_SLOTS);
+					entry[2] = (unsigned char)level;
+					entry[3] = 255;
+				}
+				else if (level + 1 < levelCount) {
+					memcpy(entry, &pageTable[level + 1][4 * ((std::size_t)(y / 2) * parentWidth + x / 2)], 4);
+				}
+			}
+		}
+	}
+
+	glBindTexture(GL_TEXTURE_2D, pageTableTexture);
+
+	for (int level = 0; level < levelCount; level++) {
+		glTexSubImage2D(GL_TEXTURE_2D, level, 0, 0, std::max(pageTableWidth >> level, 1), std::max(pageTableHeight >> level, 1),
+						GL_RGBA, GL_UNSIGNED_BYTE, pageTable[level].data());
+	}
+
+	pageTableDirty = false;
+}
+
+void VirtualTexture::bind(const Shader& shader, int cacheUnit, int pageTableUnit, float lodBias) const {
+
+	glActiveTexture(GL_TEXTURE0 + cacheUnit);
+	glBindTexture(GL_TEXTURE_2D, cacheTexture);
+	glActiveTexture(GL_TEXTURE0 + pageTableUnit);
+	glBindTexture(GL_TEXTURE_2D, pageTableTexture);
+	glActiveTexture(GL_TEXTURE0);
+
+	float cacheSize = (float)(VIRTUAL_CACHE_SLOTS * VIRTUAL_SLOT_SIZE);
+
+	shader.setInt(UNIFORM_PHYSICAL_CACHE, cacheUnit);
+	shader.setInt(UNIFORM_PAGE_TABLE, pageTableUnit);
+	shader.setVec2(UNIFORM_VIRTUAL_SIZE, glm::vec2((float)getWidth(), (float)getHeight()));
+	shader.setInt(UNIFORM_LEVEL_COUNT, getLevelCount());
+	shader.setFloat(UNIFORM_TILE_SIZE, (float)VIRTUAL_TILE_SIZE);
+	shader.setFloat(UNIFORM_TILE_BORDER, (float)VIRTUAL_TILE_BORDER);
+	shader.setVec2(UNIFORM_CACHE_SIZE, glm::vec2(cacheSize, cacheSize));
+	shader.setFloat(UNIFORM_LOD_BIAS, lodBias);
+}
+
+unsigned int VirtualTexture::getResidentCount() const {
+	return (unsigned int)std::count_if(slotTiles.begin(), slotTiles.end(), [](int tile) { return tile >= 0; });
+}
+
+std::size_t VirtualTexture::getMemorySize() const {
+
+	if (!header)
+		return 0;
+
+	std::size_t size = VIRTUAL_CACHE_SLOTS * VIRTUAL_SLOT_SIZE * VIRTUAL_CACHE_SLOTS * VIRTUAL_SLOT_SIZE * 4;
+
+	for (const std::vector<unsigned char>& level : pageTable)
+		size += level.size();
+
+	return size;
+}
+
+void VirtualTexture::waitForWorkers() {
+
+	std::unique_lock<std::mutex> lock(loadedMutex);
+	loadedCondition.wait(lock, [this] { return reading == 0 && !building; });
+}
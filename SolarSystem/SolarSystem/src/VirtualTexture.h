@@ -0,0 +1,179 @@
+#pragma once
+
+#include "TextureArchive.h"
+#include "Shader.h"
+
+#include <GL/glew.h>
+
+#include <cstdint>
+#include <string>
+#include <vector>
+#include <utility>
+#include <deque>
+#include <mutex>
+#include <condition_variable>
+
+
+// texels of a tile, the border repeats its neighbours so bilinear filtering doesn't reach into the next slot:
+const int VIRTUAL_TILE_SIZE = 128;
+const int VIRTUAL_TILE_BORDER = 4;
+const int VIRTUAL_SLOT_SIZE = VIRTUAL_TILE_SIZE + 2 * VIRTUAL_TILE_BORDER;
+
+// slots along each side of the physical cache, it takes the same VRAM whatever the size of the source
+// (16 x 16 slots of 136 x 136 rgba8 texels, 18 MB):
+const int VIRTUAL_CACHE_SLOTS = 16;
+
+// the feedback pass renders at 1 / VIRTUAL_FEEDBACK_SCALE of the screen size:
+const int VIRTUAL_FEEDBACK_SCALE = 8;
+
+// the earth map cut into tiles, built on the first start:
+const char* const VIRTUAL_EARTH_PATH = "res/cache/earth_daymap.vt";
+
+
+// the file: the header, then from tileOffset on the tiles of every level (finest first) row by row,
+// each VIRTUAL_SLOT_SIZE x VIRTUAL_SLOT_SIZE rgba8 texels with the border
+struct VirtualTextureHeader {
+	char magic[4];			// "STVT"
+	uint32_t version;
+	uint32_t width;			// of level 0
+	uint32_t height;
+	uint32_t levelCount;	// down to the first level that fits in one tile
+	uint32_t tileSize;
+	uint32_t tileBorder;
+	uint32_t tileOffset;	// from the start of the file
+	uint64_t sourceSize;	// the source when it was built, a different one means it's stale
+	int64_t sourceTime;
+};
+
+
+// a texture that never has to be resident as a whole: its mip pyramid is cut into tiles on disk, a feedback pass
+// finds the tiles the screen needs, the shared ThreadPool reads them from the mapped file and update() puts them
+// into a cache texture of fixed size (least recently seen tiles make room)
+// the page table (a texel per tile, a level per level) points every tile to its slot in the cache, or to the slot
+// of the finest coarser tile that is there, so the bodies are never missing texels while the tiles stream in
+// needs a current OpenGL context, except for build()
+class VirtualTexture {
+
+public:
+
+	VirtualTexture();
+	~VirtualTexture();
+
+	VirtualTexture(const VirtualTexture&) = delete;
+	VirtualTexture& operator=(const VirtualTexture&) = delete;
+
+	// maps the tile file and creates the textures, false if it is missing, not a virtual texture of this version,
+	// or older than the source:
+	bool open(const std::string& path, const std::string& sourcePath);
+	void close();
+
+	bool isOpen() const { return header != NULL; }
+
+	// cuts the source into the tile file, no OpenGL needed (the sides of the source have to be powers of two):
+	static bool build(const std::string& sourcePath, const std::string& path);
+
+	// build() on the shared ThreadPool, updateBuild() opens the file once it's done (close() waits for it):
+	void startBuild(const std::string& path, const std::string& sourcePath);
+	bool isBuilding() const { return buildPending; }
+
+	// once per frame while building, true when the file was built & opened:
+	bool updateBuild();
+
+	// draw the bodies with the feedback shader between the two calls (the size of the screen the normal pass uses):
+	void beginFeedback(int screenWidth, int screenHeight);
+	void endFeedback(int screenWidth, int screenHeight);
+
+	// reads the feedback of the previous frame back, requests the tiles it names and puts the tiles the workers
+	// read into the cache, once per frame:
+	void update();
+
+	// binds the cache & the page table to the texture units and sets the uniforms of the virtual texture shaders
+	// (the program has to be in use):
+	void bind(const Shader& shader, int cacheUnit, int pageTableUnit, float lodBias) const;
+
+	// the bias the feedback pass needs to want the levels of the full size screen:
+	static float getFeedbackLodBias();
+
+	int getWidth() const { return header ? header->width : 0; }
+	int getHeight() const { return header ? header->height : 0; }
+	int getLevelCount() const { return header ? header->levelCount : 0; }
+
+	unsigned int getTileCount() const { return (unsigned int)tileSlots.size(); } // of all levels
+	unsigned int getResidentCount() const;
+	unsigned int getPendingCount() const { return pendingCount; }
+	unsigned int getLastFrameUploads() const { return lastFrameUploads; }
+	unsigned int getLastFrameRequests() const { return lastFrameRequests; }
+	std::size_t getMemorySize() const; // # of bytes of the cache & page table textures
+
+private:
+
+	// a tile read by a worker, waiting for the render thread:
+	struct TileData {
+		int tile;
+		std::vector<unsigned char> texels;
+	};
+
+	MappedFile file;
+	const VirtualTextureHeader* header;
+
+	// per level:
+	std::vector<int> tilesX;
+	std::vector<int> tilesY;
+	std::vector<int> firstTile;	// index of the level's first tile in the arrays below & in the file
+	std::vector<std::vector<unsigned char> > pageTable;	// rgba8 per texel, the sides are powers of two
+	int pageTableWidth;
+	int pageTableHeight;
+
+	// per tile:
+	std::vector<int> tileSlots;	// -1 when it isn't in the cache
+	std::vector<unsigned long long> tileSeen;	// frame it was in the feedback last
+	std::vector<bool> tileRequested;	// read by a worker or waiting for the upload
+
+	// per slot:
+	std::vector<int> slotTiles;	// -1 when free
+
+	unsigned int cacheTexture;
+	unsigned int pageTableTexture;
+	bool pageTableDirty;
+
+	// the feedback pass, read back a frame later through one of the buffers:
+	unsigned int feedbackFramebuffer;
+	unsigned int feedbackColor;
+	unsigned int feedbackDepth;
+	int feedbackWidth;
+	int feedbackHeight;
+	unsigned int feedbackBuffers[2];
+	GLsync feedbackFences[2];
+	int feedbackIndex;
+
+	unsigned long long frame;
+	unsigned int pendingCount;	// requested & not in the cache yet
+	unsigned int lastFrameUploads;
+	unsigned int lastFrameRequests;
+
+	// the build started by startBuild():
+	std::string buildPath;
+	std::string buildSourcePath;
+	bool buildPending;	// not opened (or failed) yet
+
+	// shared with the workers:
+	std::deque<TileData> loaded;
+	unsigned int reading;
+	bool building;
+	bool built;	// the last build succeeded
+	std::mutex loadedMutex;
+	std::condition_variable loadedCondition;
+
+	int getTileIndex(int level, int x, int y) const { return firstTile[level] + y * tilesX[level] + x; }
+	std::size_t getTileOffset(int tile) const;
+
+	void createFeedback(int width, int height);
+	void deleteFeedback();
+
+	void readFeedback(std::vector<std::pair<int, int> >& requests);
+	void markSeen(int level, int x, int y, std::vector<std::pair<int, int> >& requests);
+	void request(int tile);
+	bool uploadTile(const TileData& data);
+	void updatePageTable();
+	void waitForWorkers();
+};